@@ -0,0 +1,150 @@
+#include <cstdlib>
+#include <new>
+
+#include "codecstats.h"
+
+// Replacements of the global allocation functions for the deflate executable, so that --stats can
+// report allocator activity through AllocationCounter. They live in their own translation unit so
+// the compiler never inlines them into code that it would then see pairing operator new with free().
+
+/**
+ * @brief Allocates memory with the given alignment.
+ * @param size The number of bytes.
+ * @param alignment The alignment, a power of two.
+ * @return The memory, or nullptr if there is none.
+ */
+static void* allocateAligned(size_t size, size_t alignment) {
+#ifdef _WIN32
+    return _aligned_malloc(size ? size : 1, alignment);
+#else
+    // aligned_alloc wants a size that is a multiple of the alignment.
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment + (size ? 0 : alignment));
+#endif
+}
+
+/**
+ * @brief Frees memory from allocateAligned.
+ * @param memory The memory, or nullptr.
+ */
+static void releaseAligned(void* memory) {
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+}
+
+/**
+ * @brief Allocates memory and counts the allocation for --stats.
+ * The nothrow forms of the standard library call this one.
+ * @param size The number of bytes.
+ * @return The memory.
+ */
+void* operator new(size_t size) {
+    AllocationCounter::record(size);
+
+    if (void* memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+
+    throw std::bad_alloc();
+}
+
+/**
+ * @brief Allocates an array; see operator new.
+ * @param size The number of bytes.
+ * @return The memory.
+ */
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+/**
+ * @brief Allocates over-aligned memory and counts the allocation for --stats.
+ * @param size The number of bytes.
+ * @param alignment The alignment.
+ * @return The memory.
+ */
+void* operator new(size_t size, std::align_val_t alignment) {
+    AllocationCounter::record(size);
+
+    if (void* memory = allocateAligned(size, static_cast<size_t>(alignment))) {
+        return memory;
+    }
+
+    throw std::bad_alloc();
+}
+
+/**
+ * @brief Allocates an over-aligned array; see the aligned operator new.
+ * @param size The number of bytes.
+ * @param alignment The alignment.
+ * @return The memory.
+ */
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+/**
+ * @brief Frees memory from the counting operator new.
+ * @param memory The memory, or nullptr.
+ */
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+/**
+ * @brief Frees memory from the counting operator new.
+ * @param memory The memory, or nullptr.
+ */
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+/**
+ * @brief Frees an array from the counting operator new.
+ * @param memory The memory, or nullptr.
+ */
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+/**
+ * @brief Frees an array from the counting operator new.
+ * @param memory The memory, or nullptr.
+ */
+void operator delete[](void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+/**
+ * @brief Frees over-aligned memory from the aligned operator new.
+ * @param memory The memory, or nullptr.
+ */
+void operator delete(void* memory, std::align_val_t) noexcept {
+    releaseAligned(memory);
+}
+
+/**
+ * @brief Frees over-aligned memory from the aligned operator new.
+ * @param memory The memory, or nullptr.
+ */
+void operator delete(void* memory, size_t, std::align_val_t) noexcept {
+    releaseAligned(memory);
+}
+
+/**
+ * @brief Frees an over-aligned array from the aligned operator new.
+ * @param memory The memory, or nullptr.
+ */
+void operator delete[](void* memory, std::align_val_t) noexcept {
+    releaseAligned(memory);
+}
+
+/**
+ * @brief Frees an over-aligned array from the aligned operator new.
+ * @param memory The memory, or nullptr.
+ */
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept {
+    releaseAligned(memory);
+}
@@ -0,0 +1,374 @@
+#ifndef ARCHIVEREADER_H
+#define ARCHIVEREADER_H
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "blockcodec.h"
+#include "filemanager.h"
+#include "threadpool.h"
+
+/**
+ * @brief Random access to a compressed file through its block index.
+ *
+ * The index at the end of the file is loaded once and turned into absolute compressed and
+ * uncompressed offsets per chunk. For files made of independent chunks, any byte range is served by
+ * decoding only the chunks that overlap it, and whole files are decoded chunk-parallel. Files whose
+ * chunks share LZ77 history are still readable, but every read decodes from the first chunk.
+ * Files compressed with a preset dictionary need that dictionary to be passed in. Block checksums
+ * are verified as chunks are decoded, and the stream checksum whenever the whole file is.
+ */
+class ArchiveReader {
+public:
+    struct Chunk {
+        uint64_t compressedOffset;
+        uint64_t rawOffset;
+        uint32_t compressedSize;
+        uint32_t rawSize;
+    };
+
+    using ChunkSink = std::function<void(const Chunk& chunk, const char* data, size_t size)>;
+
+private:
+    /**
+     * @brief What a worker hands back for one chunk.
+     */
+    struct DecodedChunk {
+        std::string data;
+        uint32_t checksum;
+        CodecStats stats;
+    };
+
+    InputFile file;
+    const Dictionary* dictionary;
+    CodecStats* stats;
+    uint8_t flags;
+    bool verify;
+    std::vector<Chunk> chunks;
+    uint64_t totalRawSize;
+    uint64_t footerOffset;
+
+    /**
+     * @brief Loads the stream header, the trailer and the block index.
+     */
+    void loadIndex() {
+        uint64_t fileSize = file.size();
+        std::vector<uint8_t> buffer;
+
+        if (fileSize < BlockCodec::STREAM_HEADER_SIZE + 1 + BlockCodec::TRAILER_SIZE) {
+            throw std::runtime_error("Compressed file is too short");
+        }
+
+        flags = BlockCodec::readStreamHeader(file.view(0, BlockCodec::STREAM_HEADER_SIZE, buffer));
+        uint64_t headerSize = BlockCodec::streamHeaderSize(flags);
+
+        if (fileSize < headerSize + 1 + BlockCodec::TRAILER_SIZE) {
+            throw std::runtime_error("Compressed file is too short");
+        }
+
+        BlockCodec::checkDictionary(flags, file.view(0, static_cast<size_t>(headerSize), buffer), dictionary);
+
+        if (!(flags & BlockCodec::FLAG_BLOCK_INDEX)) {
+            throw std::runtime_error("Compressed file has no block index");
+        }
+
+        uint8_t trailer[BlockCodec::TRAILER_SIZE];
+        std::memcpy(trailer, file.view(fileSize - BlockCodec::TRAILER_SIZE, BlockCodec::TRAILER_SIZE, buffer), sizeof(trailer));
+
+        if (std::memcmp(trailer + 4, "DFIX", 4) != 0) {
+            throw std::runtime_error("Block index trailer is missing");
+        }
+
+        uint64_t chunkCount = BlockCodec::readUint32(trailer);
+        uint64_t indexSize = chunkCount * BlockCodec::INDEX_ENTRY_SIZE;
+
+        uint64_t footerSize = (flags & BlockCodec::FLAG_CHECKSUMS) ? BlockCodec::STREAM_FOOTER_SIZE : 0;
+
+        if (indexSize + BlockCodec::TRAILER_SIZE + footerSize + 1 + headerSize > fileSize) {
+            throw std::runtime_error("Block index is larger than the file");
+        }
+
+        uint64_t indexOffset = fileSize - BlockCodec::TRAILER_SIZE - indexSize;
+        const uint8_t* index = file.view(indexOffset, static_cast<size_t>(indexSize), buffer);
+
+        uint64_t compressedOffset = headerSize;
+        totalRawSize = 0;
+        chunks.clear();
+        chunks.reserve(static_cast<size_t>(chunkCount));
+
+        for (size_t i = 0; i < chunkCount; ++i) {
+            Chunk chunk{ compressedOffset, totalRawSize, BlockCodec::readUint32(&index[i * 8 + 4]), BlockCodec::readUint32(&index[i * 8]) };
+            chunks.push_back(chunk);
+
+            if (chunk.rawSize > BlockCodec::MAX_BLOCK_SIZE) {
+                throw std::runtime_error("Block index entry is larger than a chunk can be");
+            }
+
+            compressedOffset += chunk.compressedSize;
+            totalRawSize += chunk.rawSize;
+        }
+
+        footerOffset = compressedOffset + 1;
+
+        if (footerOffset + footerSize != indexOffset) {
+            throw std::runtime_error("Block index does not match the file");
+        }
+
+        // The footer repeats the total, so a damaged index fails here rather than after the output is allocated.
+        if (footerSize && BlockCodec::readFooterSize(file.view(footerOffset, BlockCodec::STREAM_FOOTER_SIZE, buffer)) != totalRawSize) {
+            throw std::runtime_error("Block index does not match the stream footer");
+        }
+    }
+
+    /**
+     * @brief Tells whether decoded data is checked against the file's checksums.
+     * @return true if the file has checksums and verification is on.
+     */
+    bool isVerifying() const {
+        return verify && (flags & BlockCodec::FLAG_CHECKSUMS);
+    }
+
+    /**
+     * @brief Checks the stream footer after every chunk has been decoded.
+     * @param checksum The CRC-32C of the whole decoded file.
+     */
+    void checkFooter(uint32_t checksum) {
+        std::vector<uint8_t> buffer;
+        BlockCodec::checkStreamFooter(file.view(footerOffset, BlockCodec::STREAM_FOOTER_SIZE, buffer), totalRawSize, checksum);
+    }
+
+    /**
+     * @brief Returns the compressed bytes of one chunk, in place if the file is mapped.
+     * @param chunk The chunk to read.
+     * @param buffer Holds the bytes if the file is not mapped.
+     * @return The chunk's blocks, headers included.
+     */
+    const uint8_t* chunkData(const Chunk& chunk, std::vector<uint8_t>& buffer) {
+        return file.view(chunk.compressedOffset, chunk.compressedSize, buffer);
+    }
+
+    /**
+     * @brief Decodes one independent chunk.
+     * @param data The compressed chunk.
+     * @param size The size of the compressed chunk.
+     * @param rawSize The expected decoded size.
+     * @param dictionary The preset dictionary, or nullptr.
+     * @param flags The stream flags.
+     * @param verify Whether block checksums are verified.
+     * @param chunk Receives the decoded bytes, their checksum if verified, and the stats if collect is set.
+     * @param collect Whether to collect stats.
+     */
+    static void decodeIndependentChunk(const uint8_t* data, size_t size, uint32_t rawSize, const Dictionary* dictionary, uint8_t flags, bool verify, DecodedChunk& chunk, bool collect) {
+        thread_local BlockDecoder decoder;
+        decoder.setDictionary(dictionary);
+        decoder.setStats(collect ? &chunk.stats : nullptr);
+        decoder.setStreamFlags(flags);
+        decoder.setVerify(verify);
+        chunk.data.reserve(static_cast<size_t>(rawSize) + 16);
+
+        decoder.decodeChunk(data, size, chunk.data);
+
+        if (chunk.data.size() != rawSize) {
+            throw std::runtime_error("Chunk decodes to the wrong size");
+        }
+
+        chunk.checksum = decoder.getChunkChecksum();
+    }
+
+public:
+    /**
+     * @brief Opens a compressed file and loads its block index.
+     * @param fileName The path of the compressed file.
+     * @param dictionary The dictionary the file was compressed with, if any; it must outlive the reader.
+     */
+    explicit ArchiveReader(const std::string& fileName, const Dictionary* dictionary = nullptr)
+        : file(fileName), dictionary(dictionary), stats(nullptr), flags(0), verify(true), totalRawSize(0), footerOffset(0) {
+        loadIndex();
+    }
+
+    /**
+     * @brief Turns checksum verification on (the default) or off for trusted files.
+     * @param enabled Whether decoded chunks are checked.
+     */
+    void setVerify(bool enabled) {
+        verify = enabled;
+    }
+
+    /**
+     * @brief Collects timings and counters of the following reads and decodes.
+     * Workers collect into their own stats, which are added to these as their chunks are delivered.
+     * @param target The stats to add to, or nullptr to stop collecting.
+     */
+    void setStats(CodecStats* target) {
+        stats = target;
+        file.setStats(target);
+    }
+
+    /**
+     * @brief Returns the decompressed size of the whole file.
+     * @return The size in bytes.
+     */
+    uint64_t size() const {
+        return totalRawSize;
+    }
+
+    /**
+     * @brief Tells whether chunks can be decoded without their predecessors.
+     * @return true if the file was compressed in independent blocks.
+     */
+    bool isRandomAccess() const {
+        return (flags & BlockCodec::FLAG_INDEPENDENT_BLOCKS) != 0;
+    }
+
+    /**
+     * @brief Returns the chunk table built from the index.
+     * @return The chunks in stream order.
+     */
+    const std::vector<Chunk>& getChunks() const {
+        return chunks;
+    }
+
+    /**
+     * @brief Decodes a run of chunks and hands each one to sink in stream order.
+     * Independent chunks are decoded concurrently, at most two per worker in flight; dependent ones
+     * are decoded serially starting from the first chunk of the file. When the run covers the whole
+     * file, the stream checksum is checked after the last chunk.
+     * @param first The first chunk to deliver.
+     * @param last One past the last chunk to deliver.
+     * @param threadCount The number of decoding threads; 0 uses one per hardware thread.
+     * @param sink Receives every decoded chunk in [first, last).
+     */
+    void decodeChunks(size_t first, size_t last, size_t threadCount, const ChunkSink& sink) {
+        last = std::min(last, chunks.size());
+
+        if (!isRandomAccess()) {
+            BlockDecoder decoder;
+            decoder.setDictionary(dictionary);
+            decoder.setStats(stats);
+            decoder.setStreamFlags(flags);
+            decoder.setVerify(verify);
+            std::string window;
+            std::vector<uint8_t> buffer;
+
+            for (size_t i = 0; i < last; ++i) {
+                const uint8_t* data = chunkData(chunks[i], buffer);
+                size_t historySize = window.size();
+
+                decoder.decodeChunk(data, chunks[i].compressedSize, window);
+
+                if (window.size() - historySize != chunks[i].rawSize) {
+                    throw std::runtime_error("Chunk decodes to the wrong size");
+                }
+
+                if (i >= first) {
+                    sink(chunks[i], window.data() + historySize, window.size() - historySize);
+                }
+
+                if (window.size() > BlockCodec::HISTORY_SIZE) {
+                    window.erase(0, window.size() - BlockCodec::HISTORY_SIZE);
+                }
+            }
+
+            if (last == chunks.size() && decoder.isVerifying()) {
+                std::vector<uint8_t> footer;
+                decoder.checkStreamFooter(file.view(footerOffset, BlockCodec::STREAM_FOOTER_SIZE, footer));
+            }
+            return;
+        }
+
+        ThreadPool pool(threadCount);
+        std::deque<std::future<DecodedChunk>> pending;
+        size_t next = first;
+        size_t delivered = first;
+        uint32_t streamChecksum = Checksum::CRC32C_INIT;
+
+        while (delivered < last) {
+            while (next < last && pending.size() < 2 * pool.size()) {
+                // Mapped chunks are decoded in place; otherwise each task owns a copy of its chunk.
+                std::vector<uint8_t> buffer;
+                const uint8_t* data = chunkData(chunks[next], buffer);
+                const uint8_t* mappedData = file.isMapped() ? data : nullptr;
+                uint32_t size = chunks[next].compressedSize;
+                uint32_t rawSize = chunks[next].rawSize;
+
+                const Dictionary* preset = dictionary;
+                uint8_t streamFlags = flags;
+                bool verifyChunk = verify;
+                bool collect = (stats != nullptr);
+
+                pending.push_back(pool.submit([buffer = std::move(buffer), mappedData, size, rawSize, preset, streamFlags, verifyChunk, collect]() {
+                    DecodedChunk chunk;
+                    decodeIndependentChunk(mappedData ? mappedData : buffer.data(), size, rawSize, preset, streamFlags, verifyChunk, chunk, collect);
+                    return chunk;
+                }));
+                next++;
+            }
+
+            DecodedChunk result = pending.front().get();
+            pending.pop_front();
+
+            if (stats) {
+                stats->merge(result.stats);
+            }
+
+            sink(chunks[delivered], result.data.data(), result.data.size());
+            streamChecksum = Checksum::crcCombine(Checksum::CRC32C_POLYNOMIAL, streamChecksum, result.checksum, result.data.size());
+            delivered++;
+        }
+
+        if (first == 0 && last == chunks.size() && isVerifying()) {
+            checkFooter(streamChecksum);
+        }
+    }
+
+    /**
+     * @brief Decompresses the whole file into an output file.
+     * @param output The file that receives the decompressed data.
+     * @param threadCount The number of decoding threads; 0 uses one per hardware thread.
+     */
+    void decompressAll(OutputFile& output, size_t threadCount) {
+        decodeChunks(0, chunks.size(), threadCount, [&output](const Chunk&, const char* data, size_t size) {
+            output.write(data, size);
+        });
+    }
+
+    /**
+     * @brief Decompresses a byte range without decoding the chunks outside it.
+     * @param offset The offset of the first byte in the decompressed data.
+     * @param length The number of bytes wanted; the range is clipped to the end of the data.
+     * @param threadCount The number of decoding threads; 0 uses one per hardware thread.
+     * @return The bytes of the range.
+     */
+    std::string readRange(uint64_t offset, uint64_t length, size_t threadCount = 1) {
+        std::string result;
+
+        if (offset >= totalRawSize || length == 0) {
+            return result;
+        }
+
+        uint64_t end = std::min(totalRawSize, offset + std::min(length, totalRawSize - offset));
+        result.reserve(static_cast<size_t>(end - offset));
+
+        auto chunkAfter = [](uint64_t position, const Chunk& chunk) {
+            return position < chunk.rawOffset + chunk.rawSize;
+        };
+        size_t first = std::upper_bound(chunks.begin(), chunks.end(), offset, chunkAfter) - chunks.begin();
+        size_t last = std::upper_bound(chunks.begin(), chunks.end(), end - 1, chunkAfter) - chunks.begin() + 1;
+
+        decodeChunks(first, last, threadCount, [&](const Chunk& chunk, const char* data, size_t size) {
+            uint64_t from = std::max(offset, chunk.rawOffset) - chunk.rawOffset;
+            uint64_t to = std::min(end, chunk.rawOffset + size) - chunk.rawOffset;
+            result.append(data + from, static_cast<size_t>(to - from));
+        });
+
+        return result;
+    }
+};
+
+#endif
@@ -0,0 +1,590 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#ifdef DEFLATE_BENCH_ZLIB
+#include <zlib.h>
+#endif
+
+#include "blockcodec.h"
+#include "corpus.h"
+#include "deflate_dm.h"
+#include "filemanager.h"
+
+/**
+ * @brief The measurements of one stage on one corpus entry.
+ */
+struct StageResult {
+    std::string corpus;
+    std::string stage;
+    uint64_t inputSize;
+    uint64_t outputSize;
+    double seconds;
+    long peakRssKb;
+};
+
+/**
+ * @brief Returns the peak resident set size of the process so far.
+ * @return The peak RSS in kilobytes, or 0 where getrusage is not available.
+ */
+static long peakRssKb() {
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Formats a byte count the way corpus entries are named, e.g. 64K or 4M.
+ * @param size The byte count.
+ * @return The short form.
+ */
+static std::string sizeLabel(size_t size) {
+    if (size % (1 << 20) == 0) {
+        return std::to_string(size >> 20) + "M";
+    }
+    if (size % (1 << 10) == 0) {
+        return std::to_string(size >> 10) + "K";
+    }
+    return std::to_string(size);
+}
+
+/**
+ * @brief Parses a comma-separated list of sizes with optional K or M suffixes.
+ * @param list The list, e.g. "64K,1M,8M".
+ * @return The sizes in bytes.
+ */
+static std::vector<size_t> parseSizes(const std::string& list) {
+    std::vector<size_t> sizes;
+    std::stringstream stream(list);
+    std::string item;
+
+    while (std::getline(stream, item, ',')) {
+        char* suffix = nullptr;
+        size_t size = std::strtoull(item.c_str(), &suffix, 10);
+
+        if (*suffix == 'K' || *suffix == 'k') {
+            size <<= 10;
+        }
+        else if (*suffix == 'M' || *suffix == 'm') {
+            size <<= 20;
+        }
+
+        if (size == 0) {
+            throw std::runtime_error("Invalid corpus size: " + item);
+        }
+
+        sizes.push_back(size);
+    }
+
+    return sizes;
+}
+
+/**
+ * @brief Runs a piece of work several times and keeps the fastest run.
+ * @param iterations How many times to run it.
+ * @param work The work to time.
+ * @return The fastest wall-clock time in seconds.
+ */
+template <typename Work>
+static double bestOf(int iterations, Work&& work) {
+    double best = 0;
+
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        work();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (i == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * @brief Runs the DFDM pipeline stage by stage over one input, in blocks with a carried-over history.
+ * Stage times are summed over all blocks: LZ77 match finding, Huffman build (token serialization
+ * and code construction), encode (code-length header, Huffman coding and framing), I/O (writing the
+ * compressed file and reading it back), Huffman decode, Huffman decode of the same tokens in four
+ * interleaved streams, and LZ77 decode. A length_limit row compares
+ * the coded size without the code length limit (in) to the size with it (out), so its ratio is the cost.
+ * @param entry The input.
+ * @param level The compression level.
+ * @param maxCodeLength The longest Huffman code allowed.
+ * @param iterations How many times every stage is run; the fastest run counts.
+ * @param results Receives one result per stage.
+ */
+static void benchStages(const CorpusEntry& entry, int level, int maxCodeLength, int iterations, std::vector<StageResult>& results) {
+    const size_t blockSize = BlockCodec::DEFAULT_BLOCK_SIZE;
+
+    Lz77 lz77(level);
+    Huffman huffman;
+    double lz77Seconds = 0, buildSeconds = 0, encodeSeconds = 0, huffmanDecodeSeconds = 0, interleavedDecodeSeconds = 0, lz77DecodeSeconds = 0;
+    uint64_t interleavedSize = 0;
+    uint64_t tokenSize = 0;
+    uint64_t unlimitedBits = 0;
+    uint64_t limitedBits = 0;
+    std::vector<uint8_t> compressed;
+    std::vector<std::string> blockTokens;
+    std::vector<std::pair<size_t, size_t>> blockBodies;
+
+    long lz77Rss = 0, buildRss = 0, encodeRss = 0;
+
+    for (size_t start = 0; start < entry.data.size(); start += blockSize) {
+        size_t historyStart = (start > BlockCodec::HISTORY_SIZE) ? start - BlockCodec::HISTORY_SIZE : 0;
+        std::string window = entry.data.substr(historyStart, start - historyStart + std::min(blockSize, entry.data.size() - start));
+
+        std::vector<Lz77::Lz77Code> tokens;
+        lz77Seconds += bestOf(iterations, [&] { tokens = lz77.lz77Compress(window, start - historyStart); });
+        lz77Rss = peakRssKb();
+
+        std::string tokenBytes;
+        buildSeconds += bestOf(iterations, [&] {
+            tokenBytes = Lz77::compressedToBytes(tokens);
+            huffman.build(tokenBytes, maxCodeLength);
+        });
+        buildRss = peakRssKb();
+
+        uint64_t blockUnlimited = 0;
+        uint64_t blockLimited = 0;
+        huffman.getLengthLimitCost(blockUnlimited, blockLimited);
+        unlimitedBits += blockUnlimited;
+        limitedBits += blockLimited;
+
+        BitWriter writer;
+        std::vector<uint8_t> block;
+        encodeSeconds += bestOf(iterations, [&] {
+            writer = BitWriter();
+            huffman.writeCodeLengths(writer);
+            huffman.encode(tokenBytes, writer);
+
+            block.clear();
+            BlockCodec::writeBlockHeader(block, BlockCodec::BlockHeader{ BlockCodec::BLOCK_HUFFMAN, static_cast<uint32_t>(window.size() - (start - historyStart)), static_cast<uint32_t>(writer.bitsWritten()) });
+            std::vector<uint8_t> body = writer.take();
+            block.insert(block.end(), body.begin(), body.end());
+        });
+        encodeRss = peakRssKb();
+
+        tokenSize += tokenBytes.size();
+        blockTokens.push_back(tokenBytes);
+        blockBodies.emplace_back(compressed.size() + BlockCodec::BLOCK_HEADER_SIZE, block.size() - BlockCodec::BLOCK_HEADER_SIZE);
+        compressed.insert(compressed.end(), block.begin(), block.end());
+    }
+
+    const std::string tempPath = "deflate_bench.tmp";
+    std::vector<uint8_t> readBack(compressed.size());
+    double ioSeconds = bestOf(iterations, [&] {
+        {
+            OutputFile out(tempPath);
+            out.write(compressed);
+            out.close();
+        }
+        InputFile in(tempPath);
+        if (in.read(0, reinterpret_cast<char*>(readBack.data()), readBack.size()) != readBack.size()) {
+            throw std::runtime_error("Benchmark file was not read back completely");
+        }
+    });
+    std::remove(tempPath.c_str());
+    long ioRss = peakRssKb();
+
+    std::string decoded;
+    for (size_t block = 0; block < blockBodies.size(); ++block) {
+        const uint8_t* headerStart = compressed.data() + blockBodies[block].first - BlockCodec::BLOCK_HEADER_SIZE;
+        BlockCodec::BlockHeader header = BlockCodec::parseBlockHeader(headerStart[0], headerStart + 1);
+
+        std::string tokenBytes;
+        huffmanDecodeSeconds += bestOf(iterations, [&] {
+            BitReader reader(compressed.data() + blockBodies[block].first, blockBodies[block].second);
+            huffman.readCodeLengths(reader);
+            huffman.decode(reader, header.bodyBits - reader.bitsConsumed(), tokenBytes);
+        });
+
+        if (tokenBytes != blockTokens[block]) {
+            throw std::runtime_error("Huffman round trip failed on " + entry.name);
+        }
+
+        BitWriter writers[Huffman::INTERLEAVED_STREAMS];
+        huffman.encodeInterleaved(tokenBytes, writers);
+        std::vector<uint8_t> streams[Huffman::INTERLEAVED_STREAMS];
+        for (int stream = 0; stream < Huffman::INTERLEAVED_STREAMS; ++stream) {
+            streams[stream] = writers[stream].take();
+            interleavedSize += streams[stream].size();
+        }
+
+        std::string interleavedTokens(tokenBytes.size(), '\0');
+        interleavedDecodeSeconds += bestOf(iterations, [&] {
+            BitReader readers[Huffman::INTERLEAVED_STREAMS] = {
+                BitReader(streams[0].data(), streams[0].size()),
+                BitReader(streams[1].data(), streams[1].size()),
+                BitReader(streams[2].data(), streams[2].size()),
+                BitReader(streams[3].data(), streams[3].size())
+            };
+            huffman.decodeInterleaved(readers, &interleavedTokens[0], interleavedTokens.size());
+        });
+
+        if (interleavedTokens != tokenBytes) {
+            throw std::runtime_error("Interleaved Huffman round trip failed on " + entry.name);
+        }
+
+        size_t historySize = decoded.size();
+        lz77DecodeSeconds += bestOf(iterations, [&] {
+            decoded.resize(historySize);
+            Lz77::lz77DecompressFromBytes(tokenBytes, decoded);
+        });
+    }
+    long decodeRss = peakRssKb();
+
+    if (decoded != entry.data) {
+        throw std::runtime_error("LZ77 round trip failed on " + entry.name);
+    }
+
+    uint64_t rawSize = entry.data.size();
+    results.push_back(StageResult{ entry.name, "lz77", rawSize, tokenSize, lz77Seconds, lz77Rss });
+    results.push_back(StageResult{ entry.name, "huffman_build", tokenSize, tokenSize, buildSeconds, buildRss });
+    results.push_back(StageResult{ entry.name, "length_limit", (unlimitedBits + 7) / 8, (limitedBits + 7) / 8, 0, buildRss });
+    results.push_back(StageResult{ entry.name, "encode", tokenSize, compressed.size(), encodeSeconds, encodeRss });
+    results.push_back(StageResult{ entry.name, "io", compressed.size(), compressed.size(), ioSeconds, ioRss });
+    results.push_back(StageResult{ entry.name, "huffman_decode", compressed.size(), tokenSize, huffmanDecodeSeconds, decodeRss });
+    results.push_back(StageResult{ entry.name, "huffman_decode_4", interleavedSize, tokenSize, interleavedDecodeSeconds, decodeRss });
+    results.push_back(StageResult{ entry.name, "lz77_decode", tokenSize, rawSize, lz77DecodeSeconds, decodeRss });
+}
+
+/**
+ * @brief Times buffer-to-buffer compression and decompression through the library API in raw DEFLATE and, if built with it, zlib.
+ * Ratios of these rows are comparable: both produce raw DEFLATE at the same level.
+ * @param entry The input.
+ * @param level The compression level.
+ * @param maxCodeLength The longest Huffman code allowed.
+ * @param iterations How many times every run is repeated; the fastest run counts.
+ * @param results Receives the compress and decompress results.
+ */
+static void benchDeflate(const CorpusEntry& entry, int level, int maxCodeLength, int iterations, std::vector<StageResult>& results) {
+    uint64_t rawSize = entry.data.size();
+    DeflateOptions options;
+    options.format = DeflateFormat::Deflate;
+    options.level = level;
+    options.maxCodeLength = maxCodeLength;
+
+    std::vector<uint8_t> compressed(DeflateDm::compressBound(entry.data.size(), options));
+    size_t compressedSize = 0;
+
+    double compressSeconds = bestOf(iterations, [&] {
+        compressedSize = DeflateDm::compress(entry.data.data(), entry.data.size(), compressed.data(), compressed.size(), options);
+    });
+    compressed.resize(compressedSize);
+    results.push_back(StageResult{ entry.name, "deflate_compress", rawSize, compressed.size(), compressSeconds, peakRssKb() });
+
+    std::string decoded(entry.data.size(), '\0');
+    double decompressSeconds = bestOf(iterations, [&] {
+        decoded.resize(DeflateDm::decompress(compressed.data(), compressed.size(), &decoded[0], decoded.size(), DeflateFormat::Deflate));
+    });
+
+    if (decoded != entry.data) {
+        throw std::runtime_error("DEFLATE round trip failed on " + entry.name);
+    }
+
+    results.push_back(StageResult{ entry.name, "deflate_decompress", compressed.size(), rawSize, decompressSeconds, peakRssKb() });
+
+#ifdef DEFLATE_BENCH_ZLIB
+    std::vector<uint8_t> zlibCompressed(deflateBound(nullptr, static_cast<uLong>(rawSize)) + 64);
+    size_t zlibSize = 0;
+
+    double zlibCompressSeconds = bestOf(iterations, [&] {
+        z_stream stream{};
+        deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(entry.data.data()));
+        stream.avail_in = static_cast<uInt>(rawSize);
+        stream.next_out = zlibCompressed.data();
+        stream.avail_out = static_cast<uInt>(zlibCompressed.size());
+        deflate(&stream, Z_FINISH);
+        zlibSize = stream.total_out;
+        deflateEnd(&stream);
+    });
+    results.push_back(StageResult{ entry.name, "zlib_compress", rawSize, zlibSize, zlibCompressSeconds, peakRssKb() });
+
+    std::string zlibDecoded(rawSize, '\0');
+    double zlibDecompressSeconds = bestOf(iterations, [&] {
+        z_stream stream{};
+        inflateInit2(&stream, -15);
+        stream.next_in = zlibCompressed.data();
+        stream.avail_in = static_cast<uInt>(zlibSize);
+        stream.next_out = reinterpret_cast<Bytef*>(&zlibDecoded[0]);
+        stream.avail_out = static_cast<uInt>(rawSize);
+        inflate(&stream, Z_FINISH);
+        inflateEnd(&stream);
+    });
+    results.push_back(StageResult{ entry.name, "zlib_decompress", zlibSize, rawSize, zlibDecompressSeconds, peakRssKb() });
+#endif
+}
+
+/**
+ * @brief Returns the throughput of a stage, measured on its uncompressed side.
+ * @param result The stage result.
+ * @return Megabytes (10^6 bytes) per second.
+ */
+static double megabytesPerSecond(const StageResult& result) {
+    uint64_t size = std::max(result.inputSize, result.outputSize);
+    return (result.seconds > 0) ? size / result.seconds / 1e6 : 0;
+}
+
+/**
+ * @brief Writes the results as a JSON document.
+ * @param out The stream to write to.
+ * @param results All stage results.
+ * @param level The compression level used.
+ * @param maxCodeLength The code length limit used.
+ */
+static void writeJson(std::ostream& out, const std::vector<StageResult>& results, int level, int maxCodeLength) {
+    out << "{\n  \"level\": " << level << ",\n  \"max_code_length\": " << maxCodeLength << ",\n  \"results\": [\n";
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        const StageResult& result = results[i];
+        out << "    { \"corpus\": \"" << result.corpus << "\", \"stage\": \"" << result.stage << "\""
+            << ", \"input_bytes\": " << result.inputSize << ", \"output_bytes\": " << result.outputSize
+            << ", \"seconds\": " << std::setprecision(6) << result.seconds
+            << ", \"mb_per_s\": " << std::setprecision(4) << megabytesPerSecond(result)
+            << ", \"ratio\": " << std::setprecision(4) << (result.inputSize ? static_cast<double>(result.outputSize) / result.inputSize : 0)
+            << ", \"peak_rss_kb\": " << result.peakRssKb << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+
+    out << "  ]\n}\n";
+}
+
+/**
+ * @brief Extracts a value from one line of the JSON written by writeJson.
+ * @param line The line.
+ * @param key The key, without quotes.
+ * @param value Receives the value, without quotes.
+ * @return false if the line does not hold the key.
+ */
+static bool jsonField(const std::string& line, const std::string& key, std::string& value) {
+    size_t start = line.find("\"" + key + "\": ");
+    if (start == std::string::npos) {
+        return false;
+    }
+
+    start += key.size() + 4;
+    bool quoted = (start < line.size() && line[start] == '"');
+    start += quoted;
+    size_t end = line.find_first_of(quoted ? "\"" : ", }", start);
+    value = line.substr(start, (end == std::string::npos) ? std::string::npos : end - start);
+
+    return true;
+}
+
+/**
+ * @brief Compares the results with an earlier JSON report and lists every stage that got slower or compresses worse.
+ * A stage fails when its throughput falls more than `tolerance` percent below the baseline, or its
+ * output grows by more than 0.1% (ratios are deterministic, so any growth is a change in the coder).
+ * Stages missing from the baseline, and rows without a timing, are skipped. Run gates on an idle
+ * machine with several iterations; the fastest run counts, which keeps the noise well under 10%.
+ * Both runs must use the same level and code length limit, or ratios and speeds would differ for
+ * reasons other than the code.
+ * @param results The results of this run.
+ * @param baselinePath The JSON report to compare with, as written by --json.
+ * @param level The compression level of this run.
+ * @param maxCodeLength The code length limit of this run.
+ * @param tolerance The allowed throughput loss in percent.
+ * @param out The stream the regressions are listed on.
+ * @return The number of regressions.
+ * @throws std::runtime_error if the baseline cannot be opened or was measured with other settings.
+ */
+static size_t checkBaseline(const std::vector<StageResult>& results, const std::string& baselinePath, int level, int maxCodeLength, double tolerance, std::ostream& out) {
+    std::ifstream baseline = openInputFile(baselinePath);
+    std::string line;
+    size_t regressions = 0;
+    bool levelFound = false;
+
+    while (std::getline(baseline, line)) {
+        std::string corpus, stage, speed, ratio, setting;
+
+        if (jsonField(line, "level", setting)) {
+            if (std::atoi(setting.c_str()) != level) {
+                throw std::runtime_error("The baseline was measured at level " + setting + ", this run at level " + std::to_string(level));
+            }
+
+            levelFound = true;
+            continue;
+        }
+
+        if (jsonField(line, "max_code_length", setting)) {
+            if (std::atoi(setting.c_str()) != maxCodeLength) {
+                throw std::runtime_error("The baseline was measured with --max-code-length=" + setting + ", this run with " + std::to_string(maxCodeLength));
+            }
+
+            continue;
+        }
+
+        if (!jsonField(line, "corpus", corpus) || !jsonField(line, "stage", stage) || !jsonField(line, "mb_per_s", speed) || !jsonField(line, "ratio", ratio)) {
+            continue;
+        }
+
+        for (const StageResult& result : results) {
+            if (result.corpus != corpus || result.stage != stage) {
+                continue;
+            }
+
+            double baselineSpeed = std::atof(speed.c_str());
+            double baselineRatio = std::atof(ratio.c_str());
+            double currentSpeed = megabytesPerSecond(result);
+            double currentRatio = result.inputSize ? static_cast<double>(result.outputSize) / result.inputSize : 0;
+
+            if (baselineSpeed > 0 && result.seconds > 0 && currentSpeed < baselineSpeed * (1 - tolerance / 100)) {
+                out << "Regression: " << corpus << " " << stage << " runs at " << std::fixed << std::setprecision(1) << currentSpeed
+                    << " MB/s, baseline " << baselineSpeed << " MB/s\n";
+                ++regressions;
+            }
+
+            if (currentRatio > baselineRatio * 1.001 + 0.0005) {
+                out << "Regression: " << corpus << " " << stage << " has ratio " << std::fixed << std::setprecision(4) << currentRatio
+                    << ", baseline " << baselineRatio << "\n";
+                ++regressions;
+            }
+
+            out.unsetf(std::ios::fixed);
+        }
+    }
+
+    if (!levelFound) {
+        throw std::runtime_error("The baseline records no level; it must be a report written by --json");
+    }
+
+    return regressions;
+}
+
+/**
+ * @brief Entry point of the benchmark.
+ * Usage: deflate_bench [--sizes=64K,1M,4M] [--level=<1-11>] [--max-code-length=<9-15>] [--iterations=<n>] [--json=<path>|-] [--baseline=<path>] [--tolerance=<percent>] [files...]
+ * Without files, the corpus is synthetic text, binary and random data at each size. With --baseline,
+ * the run is compared with an earlier --json report and fails if a stage regressed.
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line argument strings.
+ * @return int Returns 0 on success, 1 on errors, 2 if a stage regressed against the baseline.
+ */
+int main(int argc, char* argv[]) {
+    std::vector<size_t> sizes = { 64 << 10, 1 << 20, 4 << 20 };
+    int level = Lz77::DEFAULT_LEVEL;
+    int maxCodeLength = Huffman::MAX_CODE_LENGTH;
+    int iterations = 3;
+    std::string jsonPath;
+    std::string baselinePath;
+    double tolerance = 10;
+    std::vector<std::string> files;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string argument = argv[i];
+
+            if (argument.rfind("--sizes=", 0) == 0) {
+                sizes = parseSizes(argument.substr(8));
+            }
+            else if (argument.rfind("--level=", 0) == 0) {
+                level = std::atoi(argument.c_str() + 8);
+            }
+            else if (argument.rfind("--max-code-length=", 0) == 0) {
+                maxCodeLength = std::atoi(argument.c_str() + 18);
+            }
+            else if (argument.rfind("--iterations=", 0) == 0) {
+                iterations = std::max(1, std::atoi(argument.c_str() + 13));
+            }
+            else if (argument.rfind("--json=", 0) == 0) {
+                jsonPath = argument.substr(7);
+            }
+            else if (argument.rfind("--baseline=", 0) == 0) {
+                baselinePath = argument.substr(11);
+            }
+            else if (argument.rfind("--tolerance=", 0) == 0) {
+                tolerance = std::atof(argument.c_str() + 12);
+            }
+            else if (argument.rfind("--", 0) == 0) {
+                std::cerr << "Usage: " << argv[0] << " [--sizes=64K,1M,4M] [--level=<1-11>] [--max-code-length=<9-15>] [--iterations=<n>] [--json=<path>|-] [--baseline=<path>] [--tolerance=<percent>] [files...]\n";
+                return 1;
+            }
+            else {
+                files.push_back(argument);
+            }
+        }
+
+        std::vector<CorpusEntry> corpus;
+
+        if (files.empty()) {
+            for (size_t size : sizes) {
+                corpus.push_back(CorpusEntry{ "text-" + sizeLabel(size), generateText(size, 1) });
+                corpus.push_back(CorpusEntry{ "binary-" + sizeLabel(size), generateBinary(size, 2) });
+                corpus.push_back(CorpusEntry{ "random-" + sizeLabel(size), generateRandom(size, 3) });
+            }
+        }
+
+        for (const std::string& file : files) {
+            InputFile input(file);
+            std::vector<uint8_t> buffer;
+            size_t size = 0;
+            const uint8_t* contents = input.contents(buffer, size);
+            corpus.push_back(CorpusEntry{ file, std::string(reinterpret_cast<const char*>(contents), size) });
+        }
+
+        std::vector<StageResult> results;
+
+        for (const CorpusEntry& entry : corpus) {
+            benchStages(entry, level, maxCodeLength, iterations, results);
+            benchDeflate(entry, level, maxCodeLength, iterations, results);
+        }
+
+        std::ostream& table = (jsonPath == "-") ? std::cerr : std::cout;
+        table << std::left << std::setw(24) << "corpus" << std::setw(20) << "stage" << std::right
+            << std::setw(12) << "in" << std::setw(12) << "out" << std::setw(10) << "MB/s" << std::setw(8) << "ratio" << std::setw(12) << "rss KB" << "\n";
+
+        for (const StageResult& result : results) {
+            table << std::left << std::setw(24) << result.corpus << std::setw(20) << result.stage << std::right
+                << std::setw(12) << result.inputSize << std::setw(12) << result.outputSize
+                << std::setw(10) << std::fixed << std::setprecision(1) << megabytesPerSecond(result)
+                << std::setw(8) << std::setprecision(3) << (result.inputSize ? static_cast<double>(result.outputSize) / result.inputSize : 0)
+                << std::setw(12) << result.peakRssKb << "\n";
+            table.unsetf(std::ios::fixed);
+        }
+
+        if (jsonPath == "-") {
+            writeJson(std::cout, results, level, maxCodeLength);
+        }
+        else if (!jsonPath.empty()) {
+            std::ofstream json(jsonPath);
+            writeJson(json, results, level, maxCodeLength);
+        }
+
+        if (!baselinePath.empty()) {
+            size_t regressions = checkBaseline(results, baselinePath, level, maxCodeLength, tolerance, std::cerr);
+
+            if (regressions > 0) {
+                std::cerr << "Performance gate failed: " << regressions << " regressions against " << baselinePath << "\n";
+                return 2;
+            }
+        }
+    }
+    catch (const std::exception& error) {
+        std::cerr << error.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
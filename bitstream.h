@@ -0,0 +1,250 @@
+#ifndef BITSTREAM_H
+#define BITSTREAM_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+/**
+ * @brief Packs variable-width bit fields into a byte buffer, least significant bit first.
+ * Bits collect in a 64-bit accumulator and reach the buffer four bytes at a time.
+ */
+class BitWriter {
+private:
+    std::vector<uint8_t> buffer;
+    uint64_t bitBuffer;
+    int bitCount;
+
+    /**
+     * @brief Moves the low 32 bits of the accumulator into the byte buffer.
+     */
+    void flushWord() {
+        uint32_t word = static_cast<uint32_t>(bitBuffer);
+        uint8_t bytes[4] = {
+            static_cast<uint8_t>(word),
+            static_cast<uint8_t>(word >> 8),
+            static_cast<uint8_t>(word >> 16),
+            static_cast<uint8_t>(word >> 24)
+        };
+
+        buffer.insert(buffer.end(), bytes, bytes + 4);
+        bitBuffer >>= 32;
+        bitCount -= 32;
+    }
+
+public:
+    /**
+     * @brief Constructor creates an empty writer.
+     */
+    BitWriter() : bitBuffer(0), bitCount(0) {}
+
+    /**
+     * @brief Appends a bit field to the stream.
+     * @param value The bits to write; nothing above the low `count` bits may be set.
+     * @param count The number of bits to write, at most 32.
+     */
+    void writeBits(uint64_t value, int count) {
+        bitBuffer |= value << bitCount;
+        bitCount += count;
+
+        if (bitCount >= 32) {
+            flushWord();
+        }
+    }
+
+    /**
+     * @brief Pads the stream with zero bits up to the next byte boundary.
+     */
+    void alignToByte() {
+        writeBits(0, (8 - (bitCount & 7)) & 7);
+    }
+
+    /**
+     * @brief Appends whole bytes; the stream must be byte-aligned.
+     * @param data The bytes to append.
+     * @param size The number of bytes.
+     */
+    void writeAlignedBytes(const uint8_t* data, size_t size) {
+        while (bitCount > 0) {
+            buffer.push_back(static_cast<uint8_t>(bitBuffer));
+            bitBuffer >>= 8;
+            bitCount -= 8;
+        }
+
+        buffer.insert(buffer.end(), data, data + size);
+    }
+
+    /**
+     * @brief Returns the number of bits written so far.
+     * @return The stream length in bits, padding excluded.
+     */
+    uint64_t bitsWritten() const {
+        return static_cast<uint64_t>(buffer.size()) * 8 + bitCount;
+    }
+
+    /**
+     * @brief Flushes the accumulator and hands over the packed bytes.
+     * The last byte is zero-padded; the writer is left empty.
+     * @return The packed byte buffer.
+     */
+    std::vector<uint8_t> take() {
+        while (bitCount > 0) {
+            buffer.push_back(static_cast<uint8_t>(bitBuffer));
+            bitBuffer >>= 8;
+            bitCount = bitCount > 8 ? bitCount - 8 : 0;
+        }
+
+        bitBuffer = 0;
+        std::vector<uint8_t> result;
+        result.swap(buffer);
+        return result;
+    }
+
+    /**
+     * @brief Hands over the bytes that are complete so far and keeps the bits of an unfinished byte.
+     * Used to write out a stream piece by piece while it is still being produced.
+     * @return The complete bytes written since the last call.
+     */
+    std::vector<uint8_t> takeCompleteBytes() {
+        while (bitCount >= 8) {
+            buffer.push_back(static_cast<uint8_t>(bitBuffer));
+            bitBuffer >>= 8;
+            bitCount -= 8;
+        }
+
+        std::vector<uint8_t> result;
+        result.swap(buffer);
+        return result;
+    }
+};
+
+/**
+ * @brief Reads bit fields written by BitWriter from a byte buffer.
+ * The reader keeps up to 64 bits in an accumulator and refills it eight bytes at a time where possible.
+ * Reading past the end yields zero bits and is reported by isOverrun().
+ */
+class BitReader {
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t bytePos;
+    uint64_t bitBuffer;
+    int bitCount;
+
+    /**
+     * @brief Tops the accumulator up to at least 57 bits.
+     */
+    void refill() {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        if (bytePos + 8 <= size) {
+            uint64_t word;
+            std::memcpy(&word, data + bytePos, sizeof(word));
+
+            bitBuffer |= word << bitCount;
+            bytePos += (63 - bitCount) >> 3;
+            bitCount |= 56;
+            return;
+        }
+#endif
+        while (bitCount <= 56) {
+            uint64_t byte = (bytePos < size) ? data[bytePos] : 0;
+            bitBuffer |= byte << bitCount;
+            bytePos++;
+            bitCount += 8;
+        }
+    }
+
+public:
+    /**
+     * @brief Constructor attaches the reader to a byte buffer.
+     * @param data The packed bytes; they must outlive the reader.
+     * @param size The number of bytes available.
+     */
+    BitReader(const uint8_t* data, size_t size) : data(data), size(size), bytePos(0), bitBuffer(0), bitCount(0) {}
+
+    /**
+     * @brief Returns the next bits without consuming them.
+     * @param count The number of bits to look at, at most 56.
+     * @return The bits, first stream bit in the lowest position.
+     */
+    uint64_t peekBits(int count) {
+        if (bitCount < count) {
+            refill();
+        }
+
+        return bitBuffer & ((uint64_t(1) << count) - 1);
+    }
+
+    /**
+     * @brief Drops bits that were already looked at with peekBits().
+     * @param count The number of bits to drop; must not exceed the last peek.
+     */
+    void consumeBits(int count) {
+        bitBuffer >>= count;
+        bitCount -= count;
+    }
+
+    /**
+     * @brief Reads and consumes a bit field.
+     * @param count The number of bits to read, at most 56.
+     * @return The bits, first stream bit in the lowest position.
+     */
+    uint64_t readBits(int count) {
+        uint64_t value = peekBits(count);
+        consumeBits(count);
+        return value;
+    }
+
+    /**
+     * @brief Skips the rest of the current byte.
+     */
+    void alignToByte() {
+        readBits(static_cast<int>((8 - (bitsConsumed() & 7)) & 7));
+    }
+
+    /**
+     * @brief Copies whole bytes out of the stream; the reader must be byte-aligned.
+     * @param destination The buffer that receives the bytes.
+     * @param count The number of bytes to copy.
+     * @return false if the stream holds fewer than count bytes.
+     */
+    bool readAlignedBytes(uint8_t* destination, size_t count) {
+        while (count > 0 && bitCount >= 8) {
+            *destination++ = static_cast<uint8_t>(readBits(8));
+            count--;
+        }
+
+        if (count > 0) {
+            // The fast refill leaves bits of the next byte above bitCount; they must not be OR-ed into later refills.
+            bitBuffer = 0;
+
+            if (bytePos > size || size - bytePos < count) {
+                return false;
+            }
+
+            std::memcpy(destination, data + bytePos, count);
+            bytePos += count;
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Returns the number of bits consumed so far.
+     * @return The stream position in bits.
+     */
+    uint64_t bitsConsumed() const {
+        return static_cast<uint64_t>(bytePos) * 8 - bitCount;
+    }
+
+    /**
+     * @brief Tells whether more bits were consumed than the buffer holds.
+     * @return true if the stream was truncated.
+     */
+    bool isOverrun() const {
+        return bitsConsumed() > static_cast<uint64_t>(size) * 8;
+    }
+};
+
+#endif
@@ -0,0 +1,1100 @@
+#ifndef BLOCKCODEC_H
+#define BLOCKCODEC_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bitstream.h"
+#include "bytekernels.h"
+#include "checksum.h"
+#include "codecstats.h"
+#include "dictionary.h"
+#include "huffman.h"
+#include "lz77.h"
+
+/**
+ * @brief Block framing shared by the compressor and the decompressor.
+ *
+ * A stream is a 6-byte header ("DFDM", version, flags) followed by blocks. Every block starts with
+ * a 9-byte header: the block type, the number of bytes it decodes to and the bit length of its body.
+ * A Huffman block body holds the code-length header and the Huffman-coded LZ77 tokens of that block;
+ * a shared-table block body holds only the tokens, coded with the table of the stream's dictionary.
+ * The interleaved variants of both split the coded tokens into four bit streams: after the
+ * code-length header, if any, and padding to a byte come the number of token bytes and the byte
+ * sizes of the first three streams (4 bytes each), then the streams. Stream i codes the i-th
+ * quarter of the token bytes, so a decoder can run all four at once.
+ * A stored block body is the block's bytes as they are.
+ * The blocks end with a block of type BLOCK_END, which has no sizes and no body.
+ *
+ * With FLAG_CHECKSUMS every block header ends with a CRC-32C of the decoded bytes of its chunk from
+ * the chunk's first block through this one, and the end block is followed by the stream footer:
+ * the decoded size of the whole stream (8 bytes) and the CRC-32C of all of it (4 bytes). Chaining
+ * the block checksums per chunk lets a chunk be checked on its own while both sides compute each
+ * checksum in one pass over data that has just been coded.
+ *
+ * A chunk of input, as listed in the block index, is split into blocks where its statistics change
+ * and where coding does not pay. Every block after the first of its chunk has BLOCK_CONTINUES_CHUNK
+ * set in its type byte; with FLAG_INDEPENDENT_BLOCKS, history restarts only at blocks without it.
+ *
+ * With FLAG_DICTIONARY the stream header is followed by the 4-byte ID of the preset dictionary. The
+ * dictionary's content then precedes the data as LZ77 history, both at the start of the stream and,
+ * with FLAG_INDEPENDENT_BLOCKS, at the start of every chunk.
+ *
+ * With FLAG_BLOCK_INDEX the end block and the stream footer, if any, are followed by the block index: the raw and compressed size
+ * of every chunk of input (8 bytes each), then the chunk count and "DFIX". With FLAG_INDEPENDENT_BLOCKS
+ * no chunk refers to data of an earlier one, so chunks can be coded in parallel.
+ */
+class BlockCodec {
+public:
+    static constexpr uint8_t STREAM_VERSION = 1;
+    static constexpr size_t STREAM_HEADER_SIZE = 6;
+    static constexpr size_t BLOCK_HEADER_SIZE = 9;
+    static constexpr size_t HISTORY_SIZE = 32768;
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 1 << 20;
+    static constexpr size_t MAX_BLOCK_SIZE = 1 << 26;
+
+    static constexpr uint8_t FLAG_INDEPENDENT_BLOCKS = 0x01;
+    static constexpr uint8_t FLAG_BLOCK_INDEX = 0x02;
+    static constexpr uint8_t FLAG_DICTIONARY = 0x04;
+    static constexpr uint8_t FLAG_CHECKSUMS = 0x08;
+
+    static constexpr size_t DICTIONARY_ID_SIZE = 4;
+    static constexpr size_t BLOCK_CHECKSUM_SIZE = 4;
+    static constexpr size_t STREAM_FOOTER_SIZE = 12;
+
+    static constexpr size_t INDEX_ENTRY_SIZE = 8;
+    static constexpr size_t TRAILER_SIZE = 8;
+
+    static constexpr uint8_t BLOCK_END = 0;
+    static constexpr uint8_t BLOCK_HUFFMAN = 1;
+    static constexpr uint8_t BLOCK_HUFFMAN_SHARED = 2;
+    static constexpr uint8_t BLOCK_HUFFMAN_INTERLEAVED = 3;
+    static constexpr uint8_t BLOCK_HUFFMAN_SHARED_INTERLEAVED = 4;
+    static constexpr uint8_t BLOCK_STORED = 5;
+
+    static constexpr uint8_t BLOCK_CONTINUES_CHUNK = 0x80;
+
+    static constexpr size_t JUMP_TABLE_SIZE = 4 * Huffman::INTERLEAVED_STREAMS;
+
+    /**
+     * Blocks with fewer token bytes keep a single stream; the jump table would cost more than the
+     * parallel decode saves.
+     */
+    static constexpr size_t MIN_INTERLEAVED_SIZE = 4096;
+
+    /**
+     * The encoder cuts blocks between pieces of at least this many input bytes, so a chunk has at
+     * most one block per piece plus one.
+     */
+    static constexpr size_t SPLIT_PIECE_SIZE = 16384;
+
+    struct BlockHeader {
+        uint8_t type;
+        uint32_t rawSize;
+        uint32_t bodyBits;
+        bool continuesChunk = false;
+        bool hasChecksum = false;
+        uint32_t checksum = 0;  ///< With hasChecksum: the CRC-32C of the chunk's bytes through this block.
+
+        /**
+         * @brief Returns the number of body bytes that follow the header.
+         * @return The body size in bytes.
+         */
+        size_t bodySize() const {
+            return (static_cast<size_t>(bodyBits) + 7) / 8;
+        }
+    };
+
+    struct IndexEntry {
+        uint32_t rawSize;
+        uint32_t compressedSize;
+    };
+
+    /**
+     * @brief Appends a 32-bit little-endian integer to a byte buffer.
+     * @param out The buffer to append to.
+     * @param value The value to append.
+     */
+    static void writeUint32(std::vector<uint8_t>& out, uint32_t value) {
+        for (int i = 0; i < 4; ++i) {
+            out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    /**
+     * @brief Reads a 32-bit little-endian integer.
+     * @param data Points at the first byte of the integer.
+     * @return The decoded value.
+     */
+    static uint32_t readUint32(const uint8_t* data) {
+        return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+            (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+    }
+
+    /**
+     * @brief Appends the stream header.
+     * @param out The buffer to append to.
+     * @param flags Stream feature flags.
+     * @param dictionaryId The ID of the preset dictionary; only written with FLAG_DICTIONARY.
+     */
+    static void writeStreamHeader(std::vector<uint8_t>& out, uint8_t flags = 0, uint32_t dictionaryId = 0) {
+        const uint8_t header[STREAM_HEADER_SIZE] = { 'D', 'F', 'D', 'M', STREAM_VERSION, flags };
+        out.insert(out.end(), header, header + STREAM_HEADER_SIZE);
+
+        if (flags & FLAG_DICTIONARY) {
+            writeUint32(out, dictionaryId);
+        }
+    }
+
+    /**
+     * @brief Returns the size of the stream header including the fields its flags add.
+     * @param flags Stream feature flags.
+     * @return The offset of the first block.
+     */
+    static size_t streamHeaderSize(uint8_t flags) {
+        return STREAM_HEADER_SIZE + ((flags & FLAG_DICTIONARY) ? DICTIONARY_ID_SIZE : 0);
+    }
+
+    /**
+     * @brief Returns the size of a block header in a stream with the given flags.
+     * @param flags Stream feature flags.
+     * @return The header size, including the checksum with FLAG_CHECKSUMS.
+     */
+    static size_t blockHeaderSize(uint8_t flags) {
+        return BLOCK_HEADER_SIZE + ((flags & FLAG_CHECKSUMS) ? BLOCK_CHECKSUM_SIZE : 0);
+    }
+
+    /**
+     * @brief Checks that the dictionary a stream was compressed with is the one given.
+     * @param flags The stream flags.
+     * @param header Points at streamHeaderSize(flags) bytes of stream header.
+     * @param dictionary The dictionary to decode with, or nullptr.
+     * @throws std::runtime_error if the stream needs a dictionary and it is missing or different.
+     */
+    static void checkDictionary(uint8_t flags, const uint8_t* header, const Dictionary* dictionary) {
+        if (!(flags & FLAG_DICTIONARY)) {
+            return;
+        }
+
+        if (!dictionary) {
+            throw std::runtime_error("Compressed data needs a dictionary");
+        }
+
+        if (readUint32(header + STREAM_HEADER_SIZE) != dictionary->getId()) {
+            throw std::runtime_error("Dictionary does not match the compressed data");
+        }
+    }
+
+    /**
+     * @brief Checks the stream header.
+     * @param data Points at STREAM_HEADER_SIZE bytes.
+     * @return The stream flags.
+     */
+    static uint8_t readStreamHeader(const uint8_t* data) {
+        if (std::memcmp(data, "DFDM", 4) != 0) {
+            throw std::runtime_error("Not a compressed stream: bad magic");
+        }
+
+        if (data[4] != STREAM_VERSION) {
+            throw std::runtime_error("Unsupported stream version");
+        }
+
+        return data[5];
+    }
+
+    /**
+     * @brief Tells whether a block type codes its tokens with the dictionary's table.
+     * @param type The block type.
+     * @return true for the shared-table types.
+     */
+    static bool usesSharedTable(uint8_t type) {
+        return type == BLOCK_HUFFMAN_SHARED || type == BLOCK_HUFFMAN_SHARED_INTERLEAVED;
+    }
+
+    /**
+     * @brief Tells whether a block type splits its tokens into interleaved streams.
+     * @param type The block type.
+     * @return true for the interleaved types.
+     */
+    static bool isInterleaved(uint8_t type) {
+        return type == BLOCK_HUFFMAN_INTERLEAVED || type == BLOCK_HUFFMAN_SHARED_INTERLEAVED;
+    }
+
+    /**
+     * @brief Appends the block header.
+     * @param out The buffer to append to.
+     * @param header The header to write.
+     */
+    static void writeBlockHeader(std::vector<uint8_t>& out, const BlockHeader& header) {
+        out.push_back(header.type | (header.continuesChunk ? BLOCK_CONTINUES_CHUNK : 0));
+
+        if (header.type != BLOCK_END) {
+            writeUint32(out, header.rawSize);
+            writeUint32(out, header.bodyBits);
+
+            if (header.hasChecksum) {
+                writeUint32(out, header.checksum);
+            }
+        }
+    }
+
+    /**
+     * @brief Parses the fields of a block header that follow the type byte.
+     * @param typeByte The block type byte, with BLOCK_CONTINUES_CHUNK if set.
+     * @param data Points at the blockHeaderSize(flags) - 1 bytes after the type byte.
+     * @param flags The stream flags, which tell whether the header has a checksum.
+     * @return The parsed header.
+     */
+    static BlockHeader parseBlockHeader(uint8_t typeByte, const uint8_t* data, uint8_t flags = 0) {
+        uint8_t type = typeByte & ~BLOCK_CONTINUES_CHUNK;
+
+        if (type == BLOCK_END || type > BLOCK_STORED) {
+            throw std::runtime_error("Unknown block type");
+        }
+
+        BlockHeader header{ type, readUint32(data), readUint32(data + 4), (typeByte & BLOCK_CONTINUES_CHUNK) != 0 };
+
+        if (flags & FLAG_CHECKSUMS) {
+            header.hasChecksum = true;
+            header.checksum = readUint32(data + 8);
+        }
+
+        if (header.rawSize > MAX_BLOCK_SIZE) {
+            throw std::runtime_error("Block size exceeds the format limit");
+        }
+
+        if (type == BLOCK_STORED && static_cast<uint64_t>(header.rawSize) * 8 != header.bodyBits) {
+            throw std::runtime_error("Stored block sizes disagree");
+        }
+
+        return header;
+    }
+
+    /**
+     * @brief Appends the stream footer that follows the end block with FLAG_CHECKSUMS.
+     * @param out The buffer to append to.
+     * @param rawSize The decoded size of the stream.
+     * @param checksum The CRC-32C of the decoded stream.
+     */
+    static void writeStreamFooter(std::vector<uint8_t>& out, uint64_t rawSize, uint32_t checksum) {
+        writeUint32(out, static_cast<uint32_t>(rawSize));
+        writeUint32(out, static_cast<uint32_t>(rawSize >> 32));
+        writeUint32(out, checksum);
+    }
+
+    /**
+     * @brief Returns the decoded size recorded in a stream footer.
+     * @param footer Points at STREAM_FOOTER_SIZE bytes.
+     * @return The size of the decoded stream.
+     */
+    static uint64_t readFooterSize(const uint8_t* footer) {
+        return readUint32(footer) | (static_cast<uint64_t>(readUint32(footer + 4)) << 32);
+    }
+
+    /**
+     * @brief Checks the stream footer against the decoded data.
+     * @param footer Points at STREAM_FOOTER_SIZE bytes.
+     * @param rawSize The number of bytes decoded.
+     * @param checksum The CRC-32C of the decoded bytes.
+     * @throws std::runtime_error if either differs.
+     */
+    static void checkStreamFooter(const uint8_t* footer, uint64_t rawSize, uint32_t checksum) {
+        if (readFooterSize(footer) != rawSize) {
+            throw std::runtime_error("Stream size mismatch: the data is truncated or corrupt");
+        }
+
+        if (readUint32(footer + 8) != checksum) {
+            throw std::runtime_error("Stream checksum mismatch: the data is corrupt");
+        }
+    }
+
+    /**
+     * @brief Appends the block index and the trailer that locates it.
+     * @param out The buffer to append to.
+     * @param index One entry per chunk, in stream order.
+     */
+    static void writeIndex(std::vector<uint8_t>& out, const std::vector<IndexEntry>& index) {
+        for (const IndexEntry& entry : index) {
+            writeUint32(out, entry.rawSize);
+            writeUint32(out, entry.compressedSize);
+        }
+
+        writeUint32(out, static_cast<uint32_t>(index.size()));
+        out.insert(out.end(), { 'D', 'F', 'I', 'X' });
+    }
+};
+
+/**
+ * @brief Compresses one block at a time, keeping its match finder and Huffman coder between blocks.
+ */
+class BlockEncoder {
+private:
+    /**
+     * Input with at least this much byte entropy is stored without a match search.
+     */
+    static constexpr double INCOMPRESSIBLE_BITS_PER_BYTE = 7.95;
+
+    Lz77 lz77;
+    Lz77::TokenBytePrices prices;
+    std::vector<Lz77::Lz77Code> tokens;
+    std::vector<std::pair<size_t, std::string>> blocks;
+    Huffman huffman;
+    Huffman sharedCode;
+    const Dictionary* dictionary;
+    CodecStats* stats;
+    std::vector<uint32_t> tokenFrequencies;
+    Huffman splitCode;
+    std::vector<uint32_t> splitBlockFrequencies;
+    std::vector<uint32_t> splitPieceFrequencies;
+    std::vector<uint32_t> splitJointFrequencies;
+    std::string splitPieceBytes;
+    std::string primedWindow;
+    int maxCodeLength;
+    int huffmanStreams;
+    bool checksums;
+    uint32_t chunkChecksum;
+    uint64_t unlimitedBits;
+    uint64_t limitedBits;
+
+    /**
+     * @brief Codes the tokens as interleaved streams behind their jump table.
+     * @param code The Huffman code to use.
+     * @param tokenBytes The serialized tokens.
+     * @param writer The block body so far; it is padded to a byte first.
+     */
+    static void encodeInterleaved(const Huffman& code, const std::string& tokenBytes, BitWriter& writer) {
+        BitWriter streams[Huffman::INTERLEAVED_STREAMS];
+        code.encodeInterleaved(tokenBytes, streams);
+
+        std::vector<uint8_t> bodies[Huffman::INTERLEAVED_STREAMS];
+        for (int stream = 0; stream < Huffman::INTERLEAVED_STREAMS; ++stream) {
+            bodies[stream] = streams[stream].take();
+        }
+
+        writer.alignToByte();
+        writer.writeBits(tokenBytes.size(), 32);
+        for (int stream = 0; stream < Huffman::INTERLEAVED_STREAMS - 1; ++stream) {
+            writer.writeBits(bodies[stream].size(), 32);
+        }
+
+        for (const std::vector<uint8_t>& body : bodies) {
+            writer.writeAlignedBytes(body.data(), body.size());
+        }
+    }
+
+    /**
+     * @brief Returns the coded size of the tokens with the dictionary's shared table.
+     * @return The size in bits, or UINT64_MAX if there is no table or it lacks a used token byte.
+     */
+    uint64_t sharedCodeBits() const {
+        if (!dictionary || dictionary->getCodeLengths().size() != tokenFrequencies.size()) {
+            return UINT64_MAX;
+        }
+
+        const std::vector<int>& lengths = dictionary->getCodeLengths();
+
+        uint64_t bits = 0;
+        for (size_t symbol = 0; symbol < lengths.size(); ++symbol) {
+            if (tokenFrequencies[symbol] > 0 && lengths[symbol] == 0) {
+                return UINT64_MAX;
+            }
+            bits += static_cast<uint64_t>(tokenFrequencies[symbol]) * lengths[symbol];
+        }
+
+        return bits;
+    }
+
+    /**
+     * @brief Returns the order-0 entropy of a byte histogram.
+     * @param counts The count of every byte value.
+     * @param total The sum of the counts.
+     * @return The size in bits of the bytes coded at their ideal code lengths.
+     */
+    static double entropyBits(const uint32_t* counts, uint64_t total) {
+        double bits = 0;
+
+        for (int symbol = 0; symbol < Dictionary::TOKEN_SYMBOLS; ++symbol) {
+            if (counts[symbol] > 0) {
+                bits += counts[symbol] * std::log2(static_cast<double>(total) / counts[symbol]);
+            }
+        }
+
+        return bits;
+    }
+
+    /**
+     * @brief Tells whether input is too random for LZ77 and Huffman coding to shrink it.
+     * Only the byte histogram is looked at, which costs one pass over the input instead of a
+     * match search; high-entropy data that repeats within the window is stored all the same.
+     * @param data The input.
+     * @param size The number of bytes; smaller inputs than a split piece are left to the coder.
+     * @return true if the input should be stored without looking for matches.
+     */
+    static bool looksIncompressible(const char* data, size_t size) {
+        if (size < BlockCodec::SPLIT_PIECE_SIZE) {
+            return false;
+        }
+
+        uint32_t counts[Dictionary::TOKEN_SYMBOLS];
+        ByteKernels::histogram(reinterpret_cast<const uint8_t*>(data), size, counts);
+        return entropyBits(counts, size) >= INCOMPRESSIBLE_BITS_PER_BYTE * size;
+    }
+
+    /**
+     * @brief Returns the size of a block coded with a Huffman table of its own.
+     * @param frequencies The frequency of every token byte in the block.
+     * @return The block header, the code-length header and the coded tokens, in bits.
+     */
+    uint64_t ownCodeBits(const std::vector<uint32_t>& frequencies) {
+        return BlockCodec::BLOCK_HEADER_SIZE * 8 + splitCode.estimateCodedBits(frequencies, maxCodeLength);
+    }
+
+    /**
+     * @brief Groups the tokens of a chunk into blocks where their statistics change.
+     * The tokens are cut into pieces of about BlockCodec::SPLIT_PIECE_SIZE input bytes. A piece joins the
+     * current block unless the block and the piece coded with a table each are smaller than both
+     * coded with one table; then the block ends and the piece starts the next one.
+     * @param tokens The tokens of the chunk.
+     * @param blocks Receives the input size and the serialized tokens of every block; earlier contents are dropped.
+     */
+    void splitBlocks(const std::vector<Lz77::Lz77Code>& tokens, std::vector<std::pair<size_t, std::string>>& blocks) {
+        blocks.clear();
+        std::vector<uint32_t>& blockFrequencies = splitBlockFrequencies;
+        std::vector<uint32_t>& pieceFrequencies = splitPieceFrequencies;
+        std::vector<uint32_t>& jointFrequencies = splitJointFrequencies;
+        std::string& pieceBytes = splitPieceBytes;
+        std::string blockBytes;
+        size_t blockRawSize = 0;
+        uint64_t blockBits = 0;
+
+        for (size_t first = 0; first < tokens.size(); ) {
+            size_t last = first;
+            size_t pieceRawSize = 0;
+
+            while (last < tokens.size() && pieceRawSize < BlockCodec::SPLIT_PIECE_SIZE) {
+                pieceRawSize += static_cast<size_t>(tokens[last].length) + 1;
+                last++;
+            }
+
+            pieceBytes.clear();
+            Lz77::appendTokenBytes(tokens.data() + first, last - first, pieceBytes);
+            ByteKernels::histogram(reinterpret_cast<const uint8_t*>(pieceBytes.data()), pieceBytes.size(), pieceFrequencies.data());
+            first = last;
+
+            if (blockRawSize > 0) {
+                for (int symbol = 0; symbol < Dictionary::TOKEN_SYMBOLS; ++symbol) {
+                    jointFrequencies[symbol] = blockFrequencies[symbol] + pieceFrequencies[symbol];
+                }
+
+                uint64_t jointBits = ownCodeBits(jointFrequencies);
+                uint64_t pieceBits = ownCodeBits(pieceFrequencies);
+
+                if (jointBits <= blockBits + pieceBits) {
+                    blockFrequencies.swap(jointFrequencies);
+                    blockBytes += pieceBytes;
+                    blockRawSize += pieceRawSize;
+                    blockBits = jointBits;
+                    continue;
+                }
+
+                blocks.emplace_back(blockRawSize, std::move(blockBytes));
+                blockBytes.clear();
+            }
+
+            // Copied rather than swapped, so the piece buffer keeps its capacity for the next piece.
+            blockFrequencies.swap(pieceFrequencies);
+            blockBytes.assign(pieceBytes);
+            blockRawSize = pieceRawSize;
+            blockBits = ownCodeBits(blockFrequencies);
+        }
+
+        blocks.emplace_back(blockRawSize, std::move(blockBytes));
+    }
+
+    /**
+     * @brief Writes a block header, with checksums first chaining the block's bytes into the chunk checksum.
+     * @param header The header; its checksum fields are filled in here.
+     * @param data The input bytes of the block, header.rawSize of them.
+     * @param out The buffer that receives the header.
+     */
+    void writeHeader(BlockCodec::BlockHeader header, const char* data, std::vector<uint8_t>& out) {
+        if (checksums) {
+            CodecStats::Timer timer(stats, CodecStats::STAGE_CHECKSUM);
+            uint32_t previous = header.continuesChunk ? chunkChecksum : Checksum::CRC32C_INIT;
+            chunkChecksum = Checksum::crc32c(previous, reinterpret_cast<const uint8_t*>(data), header.rawSize);
+            header.hasChecksum = true;
+            header.checksum = chunkChecksum;
+
+            if (stats) {
+                stats->addBytes(CodecStats::STAGE_CHECKSUM, header.rawSize, 0);
+            }
+        }
+
+        BlockCodec::writeBlockHeader(out, header);
+    }
+
+    /**
+     * @brief Writes a stored block.
+     * @param data The bytes of the block.
+     * @param size The number of bytes.
+     * @param continuesChunk Whether an earlier block of the same chunk precedes this one.
+     * @param out The buffer that receives the block header and body.
+     */
+    void writeStored(const char* data, size_t size, bool continuesChunk, std::vector<uint8_t>& out) {
+        BlockCodec::BlockHeader header{ BlockCodec::BLOCK_STORED, static_cast<uint32_t>(size), static_cast<uint32_t>(size * 8), continuesChunk };
+        writeHeader(header, data, out);
+        out.insert(out.end(), data, data + size);
+
+        if (stats) {
+            stats->blocks++;
+            stats->storedBlocks++;
+        }
+    }
+
+    /**
+     * @brief Writes one block of tokens with the smallest of its own table, the dictionary's table
+     * and storing the input as it is.
+     * @param data The input bytes of the block.
+     * @param rawSize The number of input bytes.
+     * @param tokenBytes The serialized tokens of the block.
+     * @param continuesChunk Whether an earlier block of the same chunk precedes this one.
+     * @param out The buffer that receives the block header and body.
+     */
+    void writeHuffmanBlock(const char* data, size_t rawSize, const std::string& tokenBytes, bool continuesChunk, std::vector<uint8_t>& out) {
+        {
+            CodecStats::Timer timer(stats, CodecStats::STAGE_HUFFMAN_BUILD);
+            ByteKernels::histogram(reinterpret_cast<const uint8_t*>(tokenBytes.data()), tokenBytes.size(), tokenFrequencies.data());
+            huffman.buildFromFrequencies(tokenFrequencies, maxCodeLength);
+        }
+
+        uint64_t blockUnlimited = 0;
+        uint64_t blockLimited = 0;
+        huffman.getLengthLimitCost(blockUnlimited, blockLimited);
+
+        CodecStats::Timer timer(stats, CodecStats::STAGE_HUFFMAN_ENCODE);
+        BitWriter writer;
+        huffman.writeCodeLengths(writer);
+        bool shared = sharedCodeBits() < writer.bitsWritten() + blockLimited;
+        bool interleaved = huffmanStreams == Huffman::INTERLEAVED_STREAMS && tokenBytes.size() >= BlockCodec::MIN_INTERLEAVED_SIZE;
+        const Huffman& code = shared ? sharedCode : huffman;
+        uint8_t type = shared ? (interleaved ? BlockCodec::BLOCK_HUFFMAN_SHARED_INTERLEAVED : BlockCodec::BLOCK_HUFFMAN_SHARED)
+            : (interleaved ? BlockCodec::BLOCK_HUFFMAN_INTERLEAVED : BlockCodec::BLOCK_HUFFMAN);
+
+        if (shared) {
+            writer = BitWriter();
+        }
+
+        if (interleaved) {
+            encodeInterleaved(code, tokenBytes, writer);
+        }
+        else {
+            code.encode(tokenBytes, writer);
+        }
+        timer.stop();
+
+        if ((writer.bitsWritten() + 7) / 8 >= rawSize) {
+            writeStored(data, rawSize, continuesChunk, out);
+            return;
+        }
+
+        unlimitedBits += blockUnlimited;
+        limitedBits += blockLimited;
+
+        if (stats) {
+            countBlock(code, type, tokenBytes.size(), (writer.bitsWritten() + 7) / 8);
+        }
+
+        BlockCodec::BlockHeader header{ type, static_cast<uint32_t>(rawSize), static_cast<uint32_t>(writer.bitsWritten()), continuesChunk };
+        writeHeader(header, data, out);
+
+        std::vector<uint8_t> body = writer.take();
+        out.insert(out.end(), body.begin(), body.end());
+    }
+
+    /**
+     * @brief Adds the sizes and the code of a finished Huffman block to the stats.
+     * @param code The Huffman code the block was written with.
+     * @param type The block type.
+     * @param tokenSize The bytes of LZ77 tokens.
+     * @param bodySize The bytes of the block body.
+     */
+    void countBlock(const Huffman& code, uint8_t type, size_t tokenSize, size_t bodySize) {
+        stats->blocks++;
+        stats->sharedTableBlocks += BlockCodec::usesSharedTable(type) ? 1 : 0;
+        stats->addBytes(CodecStats::STAGE_HUFFMAN_BUILD, tokenSize, 0);
+        stats->addBytes(CodecStats::STAGE_HUFFMAN_ENCODE, tokenSize, bodySize + BlockCodec::BLOCK_HEADER_SIZE);
+        stats->addCodeLengths(code.getCodeLengths());
+    }
+
+public:
+    /**
+     * @brief Constructor sets up the match finder.
+     * @param level The compression level, between Lz77::MIN_LEVEL and Lz77::MAX_LEVEL.
+     */
+    explicit BlockEncoder(int level = Lz77::DEFAULT_LEVEL)
+        : lz77(level), dictionary(nullptr), stats(nullptr), tokenFrequencies(Dictionary::TOKEN_SYMBOLS, 0),
+        splitBlockFrequencies(Dictionary::TOKEN_SYMBOLS, 0), splitPieceFrequencies(Dictionary::TOKEN_SYMBOLS, 0), splitJointFrequencies(Dictionary::TOKEN_SYMBOLS, 0),
+        maxCodeLength(Huffman::MAX_CODE_LENGTH), huffmanStreams(1), checksums(false), chunkChecksum(Checksum::CRC32C_INIT),
+        unlimitedBits(0), limitedBits(0) {}
+
+    /**
+     * @brief Compresses the following blocks against a preset dictionary.
+     * Its content becomes LZ77 history in front of windows that start at the beginning of the
+     * input, and each block uses its shared table instead of its own when that is smaller.
+     * @param preset The dictionary, which must outlive its use; nullptr for none.
+     */
+    void setDictionary(const Dictionary* preset) {
+        dictionary = preset;
+
+        // Workers keep their encoder between tasks, so the table is only rebuilt when it changes.
+        if (dictionary && dictionary->getCodeLengths().size() == tokenFrequencies.size() && sharedCode.getCodeLengths() != dictionary->getCodeLengths()) {
+            sharedCode.buildFromLengths(dictionary->getCodeLengths());
+        }
+    }
+
+    /**
+     * @brief Collects timings and counters of the following blocks.
+     * @param target The stats to add to, or nullptr to stop collecting.
+     */
+    void setStats(CodecStats* target) {
+        stats = target;
+    }
+
+    /**
+     * @brief Switches to another compression level for the following blocks.
+     * @param level The compression level, between Lz77::MIN_LEVEL and Lz77::MAX_LEVEL.
+     */
+    void setLevel(int level) {
+        lz77.setLevel(level);
+    }
+
+    /**
+     * @brief Limits the Huffman code lengths of the following blocks.
+     * @param length The longest code allowed, between Rfc1951::MIN_CODE_LENGTH_LIMIT and Huffman::MAX_CODE_LENGTH; the options take one limit for both formats.
+     */
+    void setMaxCodeLength(int length) {
+        maxCodeLength = length;
+    }
+
+    /**
+     * @brief Chooses how many bit streams the tokens of the following blocks are coded in.
+     * Interleaved streams decode faster and cost about 16 bytes per block; blocks of fewer than
+     * BlockCodec::MIN_INTERLEAVED_SIZE token bytes always use one stream.
+     * @param streams 1, or Huffman::INTERLEAVED_STREAMS for the interleaved block types.
+     */
+    void setHuffmanStreams(int streams) {
+        huffmanStreams = streams;
+    }
+
+    /**
+     * @brief Writes the following blocks with checksums, for streams with BlockCodec::FLAG_CHECKSUMS.
+     * @param enabled Whether block headers carry checksums.
+     */
+    void setChecksums(bool enabled) {
+        checksums = enabled;
+    }
+
+    /**
+     * @brief Returns the CRC-32C of the input of the last encodeBlock call, with checksums enabled.
+     * Callers combine these into the checksum of the whole stream.
+     * @return The checksum of the chunk.
+     */
+    uint32_t getChecksum() const {
+        return chunkChecksum;
+    }
+
+    /**
+     * @brief Reports how much the code length limit has cost over all blocks encoded so far.
+     * @param unlimited Receives the coded size in bits the blocks would have with unlimited code lengths.
+     * @param limited Receives the coded size in bits they have with the limited codes.
+     */
+    void getLengthLimitCost(uint64_t& unlimited, uint64_t& limited) const {
+        unlimited = unlimitedBits;
+        limited = limitedBits;
+    }
+
+    /**
+     * @brief Compresses the tail of a window into framed blocks.
+     * Input that looks random is stored as it is. Otherwise the tokens are split into blocks where
+     * their statistics change, and each block is Huffman-coded or, if that does not pay, stored.
+     * A window with less than 32 KB of history is taken to start at the beginning of the input, so
+     * with a dictionary its content is put in front of it.
+     * @param window Earlier data used as history, followed by the bytes of the block.
+     * @param windowSize The number of bytes in window.
+     * @param start The position of the first byte of the block in window.
+     * @param out The buffer that receives the block headers and bodies.
+     */
+    void encodeBlock(const char* window, size_t windowSize, size_t start, std::vector<uint8_t>& out) {
+        size_t rawSize = windowSize - start;
+
+        if (looksIncompressible(window + start, rawSize)) {
+            writeStored(window + start, rawSize, false, out);
+            return;
+        }
+
+        if (dictionary && !dictionary->getContent().empty() && start < BlockCodec::HISTORY_SIZE) {
+            const std::string& content = dictionary->getContent();
+            size_t keep = std::min(content.size(), BlockCodec::HISTORY_SIZE - start);
+
+            primedWindow.reserve(keep + windowSize);
+            primedWindow.assign(content, content.size() - keep, keep);
+            primedWindow.append(window, windowSize);
+
+            window = primedWindow.data();
+            windowSize = primedWindow.size();
+            start += keep;
+        }
+
+        {
+            CodecStats::Timer timer(stats, CodecStats::STAGE_LZ77);
+            lz77.lz77Compress(window, windowSize, start, prices, tokens);
+
+            if (stats) {
+                stats->addTokens(tokens);
+            }
+        }
+
+        {
+            CodecStats::Timer timer(stats, CodecStats::STAGE_HUFFMAN_BUILD);
+            splitBlocks(tokens, blocks);
+        }
+
+        size_t position = start;
+        for (const std::pair<size_t, std::string>& block : blocks) {
+            if (stats) {
+                stats->addBytes(CodecStats::STAGE_LZ77, block.first, block.second.size());
+            }
+
+            writeHuffmanBlock(window + position, block.first, block.second, position != start, out);
+            position += block.first;
+        }
+    }
+};
+
+/**
+ * @brief Decompresses framed blocks, keeping its Huffman decoder between blocks.
+ */
+class BlockDecoder {
+private:
+    Huffman huffman;
+    Huffman sharedCode;
+    std::string tokenBytes;
+    const Dictionary* dictionary;
+    CodecStats* stats;
+    uint8_t streamFlags;
+    bool verify;
+    uint32_t chunkChecksum;
+    uint64_t chunkSize;
+    uint32_t streamChecksum;
+    uint64_t streamSize;
+
+    /**
+     * @brief Checks a decoded block against the checksum in its header and folds finished chunks
+     * into the stream checksum.
+     * @param header The block header.
+     * @param data The decoded bytes of the block.
+     * @throws std::runtime_error if the checksum differs.
+     */
+    void checkBlock(const BlockCodec::BlockHeader& header, const char* data) {
+        CodecStats::Timer timer(stats, CodecStats::STAGE_CHECKSUM);
+
+        if (!header.continuesChunk) {
+            streamChecksum = Checksum::crcCombine(Checksum::CRC32C_POLYNOMIAL, streamChecksum, chunkChecksum, chunkSize);
+            streamSize += chunkSize;
+            chunkChecksum = Checksum::CRC32C_INIT;
+            chunkSize = 0;
+        }
+
+        chunkChecksum = Checksum::crc32c(chunkChecksum, reinterpret_cast<const uint8_t*>(data), header.rawSize);
+        chunkSize += header.rawSize;
+
+        if (chunkChecksum != header.checksum) {
+            throw std::runtime_error("Block checksum mismatch: the data is corrupt");
+        }
+
+        if (stats) {
+            stats->addBytes(CodecStats::STAGE_CHECKSUM, header.rawSize, 0);
+        }
+    }
+
+    /**
+     * @brief Decodes the interleaved streams of a block body.
+     * @param code The Huffman code of the block.
+     * @param body The block body.
+     * @param bodySize The size of the body in bytes.
+     * @param headerBits The bits of the body before the padding and the jump table.
+     * @param tokenBytes Receives the serialized tokens; its capacity is kept between blocks.
+     */
+    static void decodeInterleaved(const Huffman& code, const uint8_t* body, size_t bodySize, uint64_t headerBits, std::string& tokenBytes) {
+        size_t position = static_cast<size_t>((headerBits + 7) / 8);
+
+        if (bodySize < position || bodySize - position < BlockCodec::JUMP_TABLE_SIZE) {
+            throw std::runtime_error("Truncated jump table");
+        }
+
+        uint32_t count = BlockCodec::readUint32(body + position);
+        size_t remaining = bodySize - position - BlockCodec::JUMP_TABLE_SIZE;
+        const uint8_t* streamData = body + position + BlockCodec::JUMP_TABLE_SIZE;
+
+        size_t sizes[Huffman::INTERLEAVED_STREAMS];
+        for (int stream = 0; stream < Huffman::INTERLEAVED_STREAMS - 1; ++stream) {
+            sizes[stream] = BlockCodec::readUint32(body + position + 4 * (stream + 1));
+
+            if (sizes[stream] > remaining) {
+                throw std::runtime_error("Jump table points past the end of the block");
+            }
+            remaining -= sizes[stream];
+        }
+        sizes[Huffman::INTERLEAVED_STREAMS - 1] = remaining;
+
+        // Every code is at least one bit long, which bounds the output before it is allocated.
+        if (count > static_cast<uint64_t>(bodySize) * 8) {
+            throw std::runtime_error("Jump table claims more tokens than the block holds");
+        }
+
+        BitReader readers[Huffman::INTERLEAVED_STREAMS] = {
+            BitReader(streamData, sizes[0]),
+            BitReader(streamData + sizes[0], sizes[1]),
+            BitReader(streamData + sizes[0] + sizes[1], sizes[2]),
+            BitReader(streamData + sizes[0] + sizes[1] + sizes[2], sizes[3])
+        };
+
+        tokenBytes.resize(count);
+        code.decodeInterleaved(readers, &tokenBytes[0], count);
+    }
+
+    /**
+     * @brief Splits a chunk held in memory into its blocks.
+     * @param data The compressed chunk, starting at its first block header.
+     * @param size The compressed size of the chunk.
+     * @param flags The stream flags.
+     * @param visit Called with the header and the body of every block, in order.
+     */
+    template <typename Visitor>
+    static void forEachBlock(const uint8_t* data, size_t size, uint8_t flags, Visitor&& visit) {
+        size_t pos = 0;
+
+        while (pos < size) {
+            if (size - pos < BlockCodec::blockHeaderSize(flags)) {
+                throw std::runtime_error("Truncated block header");
+            }
+
+            BlockCodec::BlockHeader header = BlockCodec::parseBlockHeader(data[pos], data + pos + 1, flags);
+            pos += BlockCodec::blockHeaderSize(flags);
+
+            if (size - pos < header.bodySize()) {
+                throw std::runtime_error("Truncated block body");
+            }
+
+            visit(header, data + pos);
+            pos += header.bodySize();
+        }
+    }
+
+public:
+    /**
+     * @brief Constructor sets up a decoder without a dictionary.
+     */
+    BlockDecoder()
+        : dictionary(nullptr), stats(nullptr), streamFlags(0), verify(true), chunkChecksum(Checksum::CRC32C_INIT), chunkSize(0),
+        streamChecksum(Checksum::CRC32C_INIT), streamSize(0) {}
+
+    /**
+     * @brief Starts a stream: the following blocks are read with its flags, and the stream checksum restarts.
+     * @param flags The stream flags from its header.
+     */
+    void setStreamFlags(uint8_t flags) {
+        streamFlags = flags;
+        chunkChecksum = Checksum::CRC32C_INIT;
+        chunkSize = 0;
+        streamChecksum = Checksum::CRC32C_INIT;
+        streamSize = 0;
+    }
+
+    /**
+     * @brief Turns checksum verification on (the default) or off for trusted data.
+     * @param enabled Whether decoded blocks are checked against their checksums.
+     */
+    void setVerify(bool enabled) {
+        verify = enabled;
+    }
+
+    /**
+     * @brief Tells whether decoded blocks are checked, which needs a stream with checksums and verification on.
+     * @return true if checksums are computed.
+     */
+    bool isVerifying() const {
+        return verify && (streamFlags & BlockCodec::FLAG_CHECKSUMS);
+    }
+
+    /**
+     * @brief Returns the CRC-32C of the chunk decoded last, or of the chunk so far; only while verifying.
+     * @return The chunk checksum.
+     */
+    uint32_t getChunkChecksum() const {
+        return chunkChecksum;
+    }
+
+    /**
+     * @brief Checks the stream footer against every block decoded since setStreamFlags; only while verifying.
+     * @param footer Points at BlockCodec::STREAM_FOOTER_SIZE bytes.
+     * @throws std::runtime_error if the size or the checksum differs.
+     */
+    void checkStreamFooter(const uint8_t* footer) const {
+        uint32_t checksum = Checksum::crcCombine(Checksum::CRC32C_POLYNOMIAL, streamChecksum, chunkChecksum, chunkSize);
+        BlockCodec::checkStreamFooter(footer, streamSize + chunkSize, checksum);
+    }
+
+    /**
+     * @brief Collects timings and counters of the following blocks.
+     * @param target The stats to add to, or nullptr to stop collecting.
+     */
+    void setStats(CodecStats* target) {
+        stats = target;
+    }
+
+    /**
+     * @brief Decodes the following blocks with a preset dictionary.
+     * Its content is history in front of output position 0, and its table decodes shared-table blocks.
+     * @param preset The dictionary, which must outlive its use; nullptr for none.
+     */
+    void setDictionary(const Dictionary* preset) {
+        dictionary = preset;
+
+        if (dictionary && dictionary->getCodeLengths().size() == static_cast<size_t>(Dictionary::TOKEN_SYMBOLS) && sharedCode.getCodeLengths() != dictionary->getCodeLengths()) {
+            sharedCode.buildFromLengths(dictionary->getCodeLengths());
+        }
+    }
+
+    /**
+     * @brief Decodes one block body into a caller-provided buffer.
+     * Stored blocks are copied as they are.
+     * @param header The parsed block header.
+     * @param body The block body, header.bodySize() bytes long.
+     * @param output The output buffer; the bytes before position are history, preceded by the dictionary.
+     * @param capacity The size of the output buffer. Matches near the end of the block are copied in
+     * wide moves when there is room, so up to 15 bytes after the block may be overwritten as well.
+     * @param position Where the block's bytes start.
+     * @return The position after the block's bytes.
+     */
+    size_t decodeBlock(const BlockCodec::BlockHeader& header, const uint8_t* body, char* output, size_t capacity, size_t position) {
+        if (header.rawSize > capacity - position) {
+            throw std::runtime_error("Decompressed data does not fit the output buffer");
+        }
+
+        if (header.type == BlockCodec::BLOCK_STORED) {
+            std::memcpy(output + position, body, header.rawSize);
+
+            if (stats) {
+                stats->blocks++;
+                stats->storedBlocks++;
+            }
+
+            if (header.hasChecksum && verify) {
+                checkBlock(header, output + position);
+            }
+
+            return position + header.rawSize;
+        }
+
+        {
+            CodecStats::Timer timer(stats, CodecStats::STAGE_HUFFMAN_DECODE);
+            BitReader reader(body, header.bodySize());
+            const Huffman* code = &huffman;
+
+            if (BlockCodec::usesSharedTable(header.type)) {
+                if (!dictionary || dictionary->getCodeLengths().size() != static_cast<size_t>(Dictionary::TOKEN_SYMBOLS)) {
+                    throw std::runtime_error("Block uses a shared table but no dictionary was given");
+                }
+                code = &sharedCode;
+            }
+            else {
+                huffman.readCodeLengths(reader);
+            }
+
+            if (reader.bitsConsumed() > header.bodyBits) {
+                throw std::runtime_error("Block header is longer than the block");
+            }
+
+            if (BlockCodec::isInterleaved(header.type)) {
+                decodeInterleaved(*code, body, header.bodySize(), reader.bitsConsumed(), tokenBytes);
+            }
+            else {
+                code->decode(reader, header.bodyBits - reader.bitsConsumed(), tokenBytes);
+            }
+        }
+
+        CodecStats::Timer timer(stats, CodecStats::STAGE_LZ77_DECODE);
+        const std::string* prefix = dictionary ? &dictionary->getContent() : nullptr;
+        size_t end = Lz77::lz77DecompressFromBytes(tokenBytes, output, capacity, position,
+            prefix ? prefix->data() : nullptr, prefix ? prefix->size() : 0);
+
+        if (end != position + header.rawSize) {
+            throw std::runtime_error("Block decodes to the wrong size");
+        }
+
+        if (header.hasChecksum && verify) {
+            timer.stop();
+            checkBlock(header, output + position);
+        }
+
+        if (stats) {
+            stats->blocks++;
+            stats->sharedTableBlocks += BlockCodec::usesSharedTable(header.type) ? 1 : 0;
+            stats->addBytes(CodecStats::STAGE_HUFFMAN_DECODE, header.bodySize() + BlockCodec::BLOCK_HEADER_SIZE, tokenBytes.size());
+            stats->addBytes(CodecStats::STAGE_LZ77_DECODE, tokenBytes.size(), header.rawSize);
+        }
+
+        return end;
+    }
+
+    /**
+     * @brief Decodes one block body and appends its bytes to the window.
+     * @param header The parsed block header.
+     * @param body The block body, header.bodySize() bytes long.
+     * @param window Earlier output used as history; the block's bytes are appended to it.
+     */
+    void decodeBlock(const BlockCodec::BlockHeader& header, const uint8_t* body, std::string& window) {
+        size_t historySize = window.size();
+
+        // Room for the wide match copies past the block, trimmed again once it is decoded.
+        window.resize(historySize + header.rawSize + 16);
+        decodeBlock(header, body, &window[0], window.size(), historySize);
+        window.resize(historySize + header.rawSize);
+    }
+
+    /**
+     * @brief Decodes all blocks of one index chunk held in memory into a caller-provided buffer.
+     * @param data The compressed chunk, starting at its first block header.
+     * @param size The compressed size of the chunk.
+     * @param output The output buffer; the bytes before position are history.
+     * @param capacity The size of the output buffer.
+     * @param position Where the chunk's bytes start.
+     * @return The position after the chunk's bytes.
+     */
+    size_t decodeChunk(const uint8_t* data, size_t size, char* output, size_t capacity, size_t position) {
+        forEachBlock(data, size, streamFlags, [&](const BlockCodec::BlockHeader& header, const uint8_t* body) {
+            position = decodeBlock(header, body, output, capacity, position);
+        });
+
+        return position;
+    }
+
+    /**
+     * @brief Decodes all blocks of one index chunk held in memory.
+     * @param data The compressed chunk, starting at its first block header.
+     * @param size The compressed size of the chunk.
+     * @param window Earlier output used as history; the chunk's bytes are appended to it.
+     */
+    void decodeChunk(const uint8_t* data, size_t size, std::string& window) {
+        forEachBlock(data, size, streamFlags, [&](const BlockCodec::BlockHeader& header, const uint8_t* body) {
+            decodeBlock(header, body, window);
+        });
+    }
+};
+
+#endif
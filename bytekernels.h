@@ -0,0 +1,266 @@
+#ifndef BYTEKERNELS_H
+#define BYTEKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#include <immintrin.h>
+#define BYTEKERNELS_X86 1
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+/**
+ * @brief Hot byte loops of the compressor and decompressor with wide-word and SIMD variants.
+ * Each kernel has a portable scalar version; where x86 offers more, the fastest version the CPU
+ * supports is picked once at run time, so one binary runs everywhere and still uses AVX2 where it exists.
+ */
+class ByteKernels {
+public:
+    /**
+     * @brief Signature of the match length kernels.
+     * @param first The start of the earlier occurrence.
+     * @param second The start of the current position; both ranges must hold maxLength readable bytes.
+     * @param maxLength The most bytes to compare.
+     * @return The number of equal leading bytes, at most maxLength.
+     */
+    using MatchLengthFunction = int (*)(const char* first, const char* second, int maxLength);
+
+private:
+    /**
+     * @brief Returns the index of the lowest set bit.
+     * @param value A nonzero value.
+     * @return The number of trailing zero bits.
+     */
+    static int countTrailingZeros(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctzll(value);
+#elif defined(_MSC_VER) && defined(_M_X64)
+        unsigned long index;
+        _BitScanForward64(&index, value);
+        return static_cast<int>(index);
+#else
+        int count = 0;
+        while (!(value & 1)) {
+            value >>= 1;
+            count++;
+        }
+        return count;
+#endif
+    }
+
+    /**
+     * @brief Returns the number of equal leading bytes in two 8-byte words loaded from memory.
+     * @param difference The XOR of the two words; nonzero.
+     * @return The index of the first differing byte.
+     */
+    static int firstDifferentByte(uint64_t difference) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        return __builtin_clzll(difference) / 8;
+#else
+        return countTrailingZeros(difference) / 8;
+#endif
+    }
+
+    /**
+     * @brief Compares the bytes left after the wide loops, 8 at a time and then one by one.
+     * @param first The earlier occurrence.
+     * @param second The current position.
+     * @param length The number of bytes already known to be equal.
+     * @param maxLength The most bytes to compare.
+     * @return The number of equal leading bytes.
+     */
+    static int matchLengthTail(const char* first, const char* second, int length, int maxLength) {
+        while (length + 8 <= maxLength) {
+            uint64_t a;
+            uint64_t b;
+            std::memcpy(&a, first + length, 8);
+            std::memcpy(&b, second + length, 8);
+
+            if (a != b) {
+                return length + firstDifferentByte(a ^ b);
+            }
+            length += 8;
+        }
+
+        while (length < maxLength && first[length] == second[length]) {
+            length++;
+        }
+
+        return length;
+    }
+
+    /**
+     * @brief Portable match length: 8-byte XOR and count-trailing-zeros.
+     */
+    static int matchLengthScalar(const char* first, const char* second, int maxLength) {
+        return matchLengthTail(first, second, 0, maxLength);
+    }
+
+#ifdef BYTEKERNELS_X86
+    /**
+     * @brief SSE2 match length: compares 16 bytes per step and locates the first mismatch in the byte mask.
+     */
+    static int matchLengthSse2(const char* first, const char* second, int maxLength) {
+        int length = 0;
+
+        while (length + 16 <= maxLength) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + length));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(second + length));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b))) ^ 0xFFFFu;
+
+            if (mask) {
+                return length + countTrailingZeros(mask);
+            }
+            length += 16;
+        }
+
+        return matchLengthTail(first, second, length, maxLength);
+    }
+
+#if defined(__GNUC__) || defined(__clang__)
+    /**
+     * @brief AVX2 match length: compares 32 bytes per step. Compiled for AVX2 on its own, so it is
+     * only called after the CPU has been checked.
+     */
+    __attribute__((target("avx2")))
+    static int matchLengthAvx2(const char* first, const char* second, int maxLength) {
+        int length = 0;
+
+        while (length + 32 <= maxLength) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + length));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(second + length));
+            uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)));
+
+            if (mask) {
+                return length + countTrailingZeros(mask);
+            }
+            length += 32;
+        }
+
+        return matchLengthTail(first, second, length, maxLength);
+    }
+#endif
+#endif
+
+public:
+    /**
+     * @brief Picks the fastest match length kernel this CPU supports.
+     * Callers keep the result, so the check runs once per match finder rather than once per match.
+     * @return The kernel.
+     */
+    static MatchLengthFunction matchLengthFunction() {
+#ifdef BYTEKERNELS_X86
+#if defined(__GNUC__) || defined(__clang__)
+        if (__builtin_cpu_supports("avx2")) {
+            return matchLengthAvx2;
+        }
+
+        if (__builtin_cpu_supports("sse2")) {
+            return matchLengthSse2;
+        }
+#elif defined(_M_X64)
+        return matchLengthSse2;
+#endif
+#endif
+        return matchLengthScalar;
+    }
+
+    /**
+     * @brief Copies an LZ77 match: length bytes from distance bytes back, overlap included.
+     * With enough room after the match, the copy moves 16 or 8 bytes at a time and may write up to
+     * 15 bytes past it; those bytes are overwritten by whatever is decoded next. Distances under 8
+     * repeat a short pattern, so they are first widened to a multiple of the pattern that is at least
+     * 8. Near the end of the buffer the copy goes byte by byte and writes nothing past the match.
+     * @param destination Where the match goes; distance bytes before it must be valid output.
+     * @param distance How far back the match starts; at least 1.
+     * @param length The number of bytes to copy.
+     * @param room The number of bytes that may be written at destination; at least length.
+     */
+    static void copyMatch(char* destination, size_t distance, size_t length, size_t room) {
+        const char* source = destination - distance;
+
+        if (room < length + 16) {
+            for (size_t i = 0; i < length; ++i) {
+                destination[i] = source[i];
+            }
+            return;
+        }
+
+        if (distance == 1) {
+            std::memset(destination, *source, length);
+            return;
+        }
+
+        char* end = destination + length;
+
+        if (distance < 8) {
+            // The pattern repeats every distance bytes, so any multiple of it is a valid distance too.
+            size_t step = distance * ((8 + distance - 1) / distance);
+            size_t lead = step - distance;
+
+            for (size_t i = 0; i < lead; ++i) {
+                destination[i] = source[i];
+            }
+            destination += lead;
+            source = destination - step;
+        }
+
+        if (distance >= 16) {
+            while (destination < end) {
+                std::memcpy(destination, source, 16);
+                destination += 16;
+                source += 16;
+            }
+            return;
+        }
+
+        while (destination < end) {
+            std::memcpy(destination, source, 8);
+            destination += 8;
+            source += 8;
+        }
+    }
+
+    /**
+     * @brief Counts how often every byte value occurs.
+     * Four banks of counters are filled in turn from 8-byte loads, so consecutive equal bytes update
+     * different counters instead of waiting on each other's increments; the banks are summed at the end.
+     * Scatter-style SIMD does not beat this on current CPUs, so there is no vector variant.
+     * @param data The bytes to count.
+     * @param size The number of bytes.
+     * @param counts Receives 256 counts; previous contents are overwritten.
+     */
+    static void histogram(const uint8_t* data, size_t size, uint32_t* counts) {
+        uint32_t banks[4][256] = {};
+        size_t position = 0;
+
+        for (; position + 8 <= size; position += 8) {
+            uint64_t word;
+            std::memcpy(&word, data + position, 8);
+
+            banks[0][word & 0xFF]++;
+            banks[1][(word >> 8) & 0xFF]++;
+            banks[2][(word >> 16) & 0xFF]++;
+            banks[3][(word >> 24) & 0xFF]++;
+            banks[0][(word >> 32) & 0xFF]++;
+            banks[1][(word >> 40) & 0xFF]++;
+            banks[2][(word >> 48) & 0xFF]++;
+            banks[3][word >> 56]++;
+        }
+
+        for (; position < size; ++position) {
+            banks[0][data[position]]++;
+        }
+
+        for (int value = 0; value < 256; ++value) {
+            counts[value] = banks[0][value] + banks[1][value] + banks[2][value] + banks[3][value];
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,244 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <nmmintrin.h>
+#define CHECKSUM_X86_64 1
+#endif
+
+/**
+ * @brief Running checksums: CRC-32 and Adler-32 for the gzip and zlib wrappers, CRC-32C for DFDM.
+ * Every function takes the value returned for the preceding data, so checksums can be updated block by block.
+ */
+class Checksum {
+public:
+    static constexpr uint32_t CRC32_POLYNOMIAL = 0xEDB88320u;
+    static constexpr uint32_t CRC32C_POLYNOMIAL = 0x82F63B78u;
+
+private:
+    /**
+     * @brief Lookup tables for slicing-by-8 with a reflected CRC-32 polynomial.
+     * Table 0 is the byte-wise table; table k gives the CRC of a byte followed by k zero bytes, so
+     * eight bytes are folded in with eight independent lookups.
+     */
+    struct SliceTables {
+        uint32_t entries[8][256];
+
+        explicit SliceTables(uint32_t polynomial) {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; ++bit) {
+                    crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
+                }
+                entries[0][i] = crc;
+            }
+
+            for (int slice = 1; slice < 8; ++slice) {
+                for (int i = 0; i < 256; ++i) {
+                    uint32_t previous = entries[slice - 1][i];
+                    entries[slice][i] = (previous >> 8) ^ entries[0][previous & 0xFF];
+                }
+            }
+        }
+    };
+
+    /**
+     * @brief Returns the slicing tables of a polynomial, built on first use.
+     * @return The tables.
+     */
+    template <uint32_t Polynomial>
+    static const SliceTables& sliceTables() {
+        static const SliceTables tables(Polynomial);
+        return tables;
+    }
+
+    /**
+     * @brief Updates a reflected CRC eight bytes at a time with slicing-by-8.
+     * @param tables The slicing tables of the polynomial.
+     * @param crc The CRC of the preceding data.
+     * @param data The next bytes.
+     * @param size The number of bytes.
+     * @return The CRC including data.
+     */
+    static uint32_t crcSliced(const SliceTables& tables, uint32_t crc, const uint8_t* data, size_t size) {
+        const uint32_t (*table)[256] = tables.entries;
+        crc = ~crc;
+
+        while (size >= 8) {
+            uint32_t low = crc ^ (static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+                (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24));
+
+            crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^ table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24] ^
+                table[3][data[4]] ^ table[2][data[5]] ^ table[1][data[6]] ^ table[0][data[7]];
+
+            data += 8;
+            size -= 8;
+        }
+
+        for (size_t i = 0; i < size; ++i) {
+            crc = table[0][(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+
+        return ~crc;
+    }
+
+    /**
+     * @brief Portable CRC-32C.
+     */
+    static uint32_t crc32cSliced(uint32_t crc, const uint8_t* data, size_t size) {
+        return crcSliced(sliceTables<CRC32C_POLYNOMIAL>(), crc, data, size);
+    }
+
+#if defined(CHECKSUM_X86_64) && (defined(__GNUC__) || defined(__clang__))
+    /**
+     * @brief CRC-32C with the SSE4.2 crc32 instruction, 8 bytes per step. Compiled for SSE4.2 on its
+     * own, so it is only called after the CPU has been checked.
+     */
+    __attribute__((target("sse4.2")))
+    static uint32_t crc32cSse42(uint32_t crc, const uint8_t* data, size_t size) {
+        uint64_t value = ~crc;
+
+        while (size >= 8) {
+            uint64_t word;
+            std::memcpy(&word, data, sizeof(word));
+            value = _mm_crc32_u64(value, word);
+            data += 8;
+            size -= 8;
+        }
+
+        uint32_t tail = static_cast<uint32_t>(value);
+        for (size_t i = 0; i < size; ++i) {
+            tail = _mm_crc32_u8(tail, data[i]);
+        }
+
+        return ~tail;
+    }
+#endif
+
+    /**
+     * @brief Multiplies two polynomials modulo a reflected CRC polynomial.
+     * @param a A polynomial, bit 31 holding x^0.
+     * @param b Another polynomial.
+     * @param polynomial The reflected CRC polynomial.
+     * @return a * b modulo the polynomial.
+     */
+    static uint32_t multiplyModulo(uint32_t a, uint32_t b, uint32_t polynomial) {
+        uint32_t product = 0;
+
+        for (uint32_t bit = 1u << 31; bit != 0; bit >>= 1) {
+            if (a & bit) {
+                product ^= b;
+            }
+            b = (b & 1) ? (b >> 1) ^ polynomial : b >> 1;
+        }
+
+        return product;
+    }
+
+public:
+    static constexpr uint32_t CRC32_INIT = 0;
+    static constexpr uint32_t CRC32C_INIT = 0;
+    static constexpr uint32_t ADLER32_INIT = 1;
+
+    /**
+     * @brief Signature of the CRC-32C kernels.
+     */
+    using Crc32cFunction = uint32_t (*)(uint32_t crc, const uint8_t* data, size_t size);
+
+    /**
+     * @brief Picks the fastest CRC-32C kernel this CPU supports: SSE4.2 where it exists, else slicing-by-8.
+     * @return The kernel.
+     */
+    static Crc32cFunction crc32cFunction() {
+#if defined(CHECKSUM_X86_64) && (defined(__GNUC__) || defined(__clang__))
+        if (__builtin_cpu_supports("sse4.2")) {
+            return crc32cSse42;
+        }
+#endif
+        return crc32cSliced;
+    }
+
+    /**
+     * @brief Updates a CRC-32 (ISO-HDLC, as used by gzip).
+     * @param crc The CRC of the preceding data, CRC32_INIT at the start.
+     * @param data The next bytes.
+     * @param size The number of bytes.
+     * @return The CRC including data.
+     */
+    static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size) {
+        return crcSliced(sliceTables<CRC32_POLYNOMIAL>(), crc, data, size);
+    }
+
+    /**
+     * @brief Updates a CRC-32C (Castagnoli, as used by iSCSI and ext4), which DFDM blocks and streams carry.
+     * @param crc The CRC of the preceding data, CRC32C_INIT at the start.
+     * @param data The next bytes.
+     * @param size The number of bytes.
+     * @return The CRC including data.
+     */
+    static uint32_t crc32c(uint32_t crc, const uint8_t* data, size_t size) {
+        static const Crc32cFunction function = crc32cFunction();
+        return function(crc, data, size);
+    }
+
+    /**
+     * @brief Returns the CRC of two pieces of data from the CRCs of each, as zlib's crc32_combine does.
+     * The first CRC is advanced past secondSize zero bytes by multiplying it with x^(8 * secondSize),
+     * which takes a few hundred steps however long the second piece is.
+     * @param polynomial The reflected CRC polynomial, such as CRC32C_POLYNOMIAL.
+     * @param first The CRC of the first piece.
+     * @param second The CRC of the second piece.
+     * @param secondSize The size of the second piece in bytes.
+     * @return The CRC of the first piece followed by the second.
+     */
+    static uint32_t crcCombine(uint32_t polynomial, uint32_t first, uint32_t second, uint64_t secondSize) {
+        // power is x^(2^k) modulo the polynomial, starting at x^8 for one byte.
+        uint32_t power = 1u << 23;
+        uint32_t shift = 1u << 31;
+
+        for (; secondSize != 0; secondSize >>= 1) {
+            if (secondSize & 1) {
+                shift = multiplyModulo(power, shift, polynomial);
+            }
+            power = multiplyModulo(power, power, polynomial);
+        }
+
+        return multiplyModulo(shift, first, polynomial) ^ second;
+    }
+
+    /**
+     * @brief Updates an Adler-32 checksum (as used by zlib).
+     * Sums are reduced only every 5552 bytes, the longest run that cannot overflow 32 bits.
+     * @param adler The checksum of the preceding data, ADLER32_INIT at the start.
+     * @param data The next bytes.
+     * @param size The number of bytes.
+     * @return The checksum including data.
+     */
+    static uint32_t adler32(uint32_t adler, const uint8_t* data, size_t size) {
+        const uint32_t modulus = 65521;
+        uint32_t a = adler & 0xFFFF;
+        uint32_t b = adler >> 16;
+
+        while (size > 0) {
+            size_t run = (size < 5552) ? size : 5552;
+            size -= run;
+
+            for (size_t i = 0; i < run; ++i) {
+                a += data[i];
+                b += a;
+            }
+
+            data += run;
+            a %= modulus;
+            b %= modulus;
+        }
+
+        return (b << 16) | a;
+    }
+};
+
+#endif
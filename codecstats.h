@@ -0,0 +1,332 @@
+#ifndef CODECSTATS_H
+#define CODECSTATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+/**
+ * @brief Timings and counters collected by the block coders when a caller asks for them.
+ *
+ * Coders take a CodecStats pointer and collect nothing while it is null, so the default path pays
+ * for no clock reads. Every stage records its wall time and the bytes that went in and came out of
+ * it; the compressor also counts LZ77 tokens and how often each Huffman code length was assigned.
+ * Workers collect into their own CodecStats and the results are merged, so no counter is shared
+ * between threads; stage times are then summed over the workers rather than measured end to end.
+ */
+class CodecStats {
+public:
+    enum Stage {
+        STAGE_READ,
+        STAGE_LZ77,
+        STAGE_HUFFMAN_BUILD,
+        STAGE_HUFFMAN_ENCODE,
+        STAGE_HUFFMAN_DECODE,
+        STAGE_LZ77_DECODE,
+        STAGE_CHECKSUM,
+        STAGE_WRITE,
+        STAGE_COUNT
+    };
+
+    static constexpr int MAX_CODE_LENGTH = 15;
+
+    struct StageStats {
+        double seconds = 0;
+        uint64_t bytesIn = 0;
+        uint64_t bytesOut = 0;
+    };
+
+    /**
+     * @brief Adds the wall time of a scope to a stage.
+     * Does nothing, not even read the clock, when no stats are collected.
+     */
+    class Timer {
+    private:
+        CodecStats* stats;
+        Stage stage;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        /**
+         * @brief Constructor starts timing.
+         * @param stats The stats to add to, or nullptr.
+         * @param stage The stage being timed.
+         */
+        Timer(CodecStats* stats, Stage stage) : stats(stats), stage(stage) {
+            if (stats) {
+                start = std::chrono::steady_clock::now();
+            }
+        }
+
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+        /**
+         * @brief Adds the time since construction to the stage now rather than at the end of the scope.
+         */
+        void stop() {
+            if (stats) {
+                stats->stages[stage].seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                stats = nullptr;
+            }
+        }
+
+        /**
+         * @brief Destructor adds the time since construction to the stage unless stop() already did.
+         */
+        ~Timer() {
+            stop();
+        }
+    };
+
+    StageStats stages[STAGE_COUNT];
+    uint64_t blocks = 0;
+    uint64_t sharedTableBlocks = 0;
+    uint64_t storedBlocks = 0;
+    uint64_t tokens = 0;
+    uint64_t matches = 0;
+    uint64_t matchLengthSum = 0;
+    uint64_t matchOffsetSum = 0;
+    uint64_t codeLengthCounts[MAX_CODE_LENGTH + 1] = {};
+    uint64_t allocations = 0;
+    uint64_t allocatedBytes = 0;
+
+    /**
+     * @brief Adds bytes to a stage.
+     * @param stage The stage.
+     * @param bytesIn The bytes the stage consumed.
+     * @param bytesOut The bytes the stage produced.
+     */
+    void addBytes(Stage stage, uint64_t bytesIn, uint64_t bytesOut) {
+        stages[stage].bytesIn += bytesIn;
+        stages[stage].bytesOut += bytesOut;
+    }
+
+    /**
+     * @brief Adds a block's LZ77 tokens to the token counters.
+     * @param tokens Tokens with length and offSet fields; a length of 0 means no match.
+     */
+    template <typename Token>
+    void addTokens(const std::vector<Token>& tokens) {
+        this->tokens += tokens.size();
+
+        for (const Token& token : tokens) {
+            if (token.length > 0) {
+                matches++;
+                matchLengthSum += token.length;
+                matchOffsetSum += token.offSet;
+            }
+        }
+    }
+
+    /**
+     * @brief Adds the code lengths of a Huffman code to the length histogram.
+     * @param lengths One length per symbol; 0 for unused symbols.
+     */
+    void addCodeLengths(const std::vector<int>& lengths) {
+        for (int length : lengths) {
+            if (length > 0 && length <= MAX_CODE_LENGTH) {
+                codeLengthCounts[length]++;
+            }
+        }
+    }
+
+    /**
+     * @brief Adds the stats of another coder, such as a worker thread's.
+     * @param other The stats to add.
+     */
+    void merge(const CodecStats& other) {
+        for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+            stages[stage].seconds += other.stages[stage].seconds;
+            stages[stage].bytesIn += other.stages[stage].bytesIn;
+            stages[stage].bytesOut += other.stages[stage].bytesOut;
+        }
+
+        blocks += other.blocks;
+        sharedTableBlocks += other.sharedTableBlocks;
+        storedBlocks += other.storedBlocks;
+        tokens += other.tokens;
+        matches += other.matches;
+        matchLengthSum += other.matchLengthSum;
+        matchOffsetSum += other.matchOffsetSum;
+        allocations += other.allocations;
+        allocatedBytes += other.allocatedBytes;
+
+        for (int length = 0; length <= MAX_CODE_LENGTH; ++length) {
+            codeLengthCounts[length] += other.codeLengthCounts[length];
+        }
+    }
+
+    /**
+     * @brief Returns the name of a stage as used in reports.
+     * @param stage The stage.
+     * @return The name.
+     */
+    static const char* stageName(int stage) {
+        static const char* const names[STAGE_COUNT] = {
+            "read", "lz77", "huffman_build", "huffman_encode", "huffman_decode", "lz77_decode", "checksum", "write"
+        };
+        return names[stage];
+    }
+
+    /**
+     * @brief Returns the mean length of the LZ77 matches.
+     * @return The mean in bytes, or 0 without matches.
+     */
+    double averageMatchLength() const {
+        return matches ? static_cast<double>(matchLengthSum) / matches : 0.0;
+    }
+
+    /**
+     * @brief Returns the mean distance of the LZ77 matches.
+     * @return The mean in bytes, or 0 without matches.
+     */
+    double averageMatchOffset() const {
+        return matches ? static_cast<double>(matchOffsetSum) / matches : 0.0;
+    }
+
+    /**
+     * @brief Returns how many literal bytes there are per match.
+     * Every token carries one literal, so this is the number of tokens per match.
+     * @return The ratio, or 0 without matches.
+     */
+    double literalsPerMatch() const {
+        return matches ? static_cast<double>(tokens) / matches : 0.0;
+    }
+
+    /**
+     * @brief Writes a table for people to read.
+     * Stages that did not run are left out.
+     * @param out The stream to write to.
+     */
+    void writeText(std::ostream& out) const {
+        std::ios_base::fmtflags savedFlags = out.flags();
+        out << std::fixed << std::setprecision(3);
+
+        out << std::left << std::setw(16) << "stage" << std::right << std::setw(12) << "ms"
+            << std::setw(14) << "bytes in" << std::setw(14) << "bytes out" << std::setw(10) << "MB/s" << "\n";
+
+        for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+            const StageStats& stats = stages[stage];
+
+            if (stats.seconds == 0 && stats.bytesIn == 0 && stats.bytesOut == 0) {
+                continue;
+            }
+
+            double megabytesPerSecond = (stats.seconds > 0) ? stats.bytesIn / stats.seconds / 1e6 : 0.0;
+            out << std::left << std::setw(16) << stageName(stage) << std::right << std::setw(12) << stats.seconds * 1000
+                << std::setw(14) << stats.bytesIn << std::setw(14) << stats.bytesOut << std::setw(10) << megabytesPerSecond << "\n";
+        }
+
+        if (blocks > 0) {
+            out << "blocks: " << blocks << " (" << sharedTableBlocks << " with the shared table, " << storedBlocks << " stored)\n";
+        }
+
+        if (tokens > 0) {
+            out << "tokens: " << tokens << ", matches: " << matches << ", literals per match: " << literalsPerMatch()
+                << ", average match length: " << averageMatchLength() << ", average offset: " << averageMatchOffset() << "\n";
+            out << "code lengths:";
+
+            for (int length = 1; length <= MAX_CODE_LENGTH; ++length) {
+                if (codeLengthCounts[length] > 0) {
+                    out << " " << length << ":" << codeLengthCounts[length];
+                }
+            }
+            out << "\n";
+        }
+
+        out << "allocations: " << allocations << " (" << allocatedBytes << " bytes)\n";
+        out.flags(savedFlags);
+    }
+
+    /**
+     * @brief Writes the stats as one JSON object.
+     * @param out The stream to write to.
+     */
+    void writeJson(std::ostream& out) const {
+        std::ios_base::fmtflags savedFlags = out.flags();
+        out << std::fixed << std::setprecision(6);
+
+        out << "{\"stages\":{";
+        for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+            out << (stage ? "," : "") << "\"" << stageName(stage) << "\":{\"seconds\":" << stages[stage].seconds
+                << ",\"bytes_in\":" << stages[stage].bytesIn << ",\"bytes_out\":" << stages[stage].bytesOut << "}";
+        }
+
+        out << "},\"blocks\":" << blocks << ",\"shared_table_blocks\":" << sharedTableBlocks << ",\"stored_blocks\":" << storedBlocks
+            << ",\"tokens\":" << tokens << ",\"matches\":" << matches
+            << ",\"literals_per_match\":" << literalsPerMatch()
+            << ",\"average_match_length\":" << averageMatchLength()
+            << ",\"average_match_offset\":" << averageMatchOffset()
+            << ",\"code_lengths\":[";
+
+        for (int length = 0; length <= MAX_CODE_LENGTH; ++length) {
+            out << (length ? "," : "") << codeLengthCounts[length];
+        }
+
+        out << "],\"allocations\":" << allocations << ",\"allocated_bytes\":" << allocatedBytes << "}\n";
+        out.flags(savedFlags);
+    }
+};
+
+/**
+ * @brief Process-wide allocation counters.
+ * A program that wants allocator activity in its stats replaces the global operator new and calls
+ * record(); the counters stay at zero otherwise. Counting is off until setEnabled(true), so an
+ * allocation then costs one relaxed load instead of two shared read-modify-writes. Differences
+ * between two snapshots give the activity of the code in between.
+ */
+class AllocationCounter {
+public:
+    /**
+     * @brief Returns whether allocations are being counted.
+     * @return The flag.
+     */
+    static std::atomic<bool>& enabled() {
+        static std::atomic<bool> flag{ false };
+        return flag;
+    }
+
+    /**
+     * @brief Turns counting on or off.
+     * @param enable Whether to count the following allocations.
+     */
+    static void setEnabled(bool enable) {
+        enabled().store(enable, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Returns the number of allocations so far.
+     * @return The counter.
+     */
+    static std::atomic<uint64_t>& allocations() {
+        static std::atomic<uint64_t> count{ 0 };
+        return count;
+    }
+
+    /**
+     * @brief Returns the number of bytes allocated so far.
+     * @return The counter.
+     */
+    static std::atomic<uint64_t>& allocatedBytes() {
+        static std::atomic<uint64_t> bytes{ 0 };
+        return bytes;
+    }
+
+    /**
+     * @brief Records one allocation if counting is enabled.
+     * @param size The size of the allocation.
+     */
+    static void record(size_t size) {
+        if (enabled().load(std::memory_order_relaxed)) {
+            allocations().fetch_add(1, std::memory_order_relaxed);
+            allocatedBytes().fetch_add(size, std::memory_order_relaxed);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <cstdint>
+#include <random>
+#include <string>
+
+/**
+ * @brief One input of the benchmark or the tests: a name and the bytes to compress.
+ */
+struct CorpusEntry {
+    std::string name;
+    std::string data;
+};
+
+/**
+ * @brief Generates English-like text: words drawn from a small vocabulary with a skewed distribution.
+ * @param size The number of bytes to generate.
+ * @param seed The random seed, so runs are reproducible.
+ * @return The generated text.
+ */
+inline std::string generateText(size_t size, uint32_t seed) {
+    static const char* const WORDS[] = {
+        "the", "of", "and", "to", "in", "a", "is", "that", "for", "it", "as", "was", "with", "be", "by", "on",
+        "not", "he", "this", "are", "or", "his", "from", "at", "which", "but", "have", "an", "had", "they",
+        "you", "were", "their", "one", "all", "we", "can", "her", "has", "there", "been", "if", "more", "when",
+        "will", "would", "who", "so", "no", "compression", "huffman", "window", "match", "block", "stream"
+    };
+    const size_t wordCount = sizeof(WORDS) / sizeof(WORDS[0]);
+
+    std::mt19937 random(seed);
+    std::geometric_distribution<size_t> wordIndex(0.08);
+    std::uniform_int_distribution<int> sentenceLength(4, 18);
+
+    std::string text;
+    text.reserve(size + 32);
+
+    while (text.size() < size) {
+        int words = sentenceLength(random);
+
+        for (int i = 0; i < words; ++i) {
+            std::string word = WORDS[wordIndex(random) % wordCount];
+            if (i == 0) {
+                word[0] = static_cast<char>(word[0] - 'a' + 'A');
+            }
+
+            text += word;
+            text += (i + 1 < words) ? ' ' : '.';
+        }
+
+        text += (random() % 8 == 0) ? '\n' : ' ';
+    }
+
+    text.resize(size);
+    return text;
+}
+
+/**
+ * @brief Generates structured binary data: fixed-size records with counters, small deltas and flags.
+ * @param size The number of bytes to generate.
+ * @param seed The random seed, so runs are reproducible.
+ * @return The generated bytes.
+ */
+inline std::string generateBinary(size_t size, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::string data;
+    data.reserve(size + 16);
+
+    uint32_t counter = 0;
+    int32_t value = 1000;
+
+    while (data.size() < size) {
+        value += static_cast<int32_t>(random() % 17) - 8;
+        uint8_t flags = (random() % 16 == 0) ? static_cast<uint8_t>(random()) : 0;
+
+        for (int i = 0; i < 4; ++i) {
+            data += static_cast<char>(counter >> (8 * i));
+        }
+        for (int i = 0; i < 4; ++i) {
+            data += static_cast<char>(static_cast<uint32_t>(value) >> (8 * i));
+        }
+        data += static_cast<char>(flags);
+        data.append(7, '\0');
+
+        counter++;
+    }
+
+    data.resize(size);
+    return data;
+}
+
+/**
+ * @brief Generates incompressible data.
+ * @param size The number of bytes to generate.
+ * @param seed The random seed, so runs are reproducible.
+ * @return The generated bytes.
+ */
+inline std::string generateRandom(size_t size, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::string data(size, '\0');
+
+    for (char& byte : data) {
+        byte = static_cast<char>(random());
+    }
+
+    return data;
+}
+
+#endif
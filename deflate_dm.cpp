@@ -0,0 +1,529 @@
+#include "deflate_dm.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "blockcodec.h"
+#include "rfc1951.h"
+
+/**
+ * @brief Appends bytes to the caller's output buffer, failing if they do not fit.
+ */
+class OutputSpan {
+private:
+    uint8_t* data;
+    size_t capacity;
+    size_t position;
+
+public:
+    /**
+     * @brief Constructor wraps a caller-provided buffer.
+     * @param data The buffer.
+     * @param capacity The size of the buffer.
+     */
+    OutputSpan(void* data, size_t capacity) : data(static_cast<uint8_t*>(data)), capacity(capacity), position(0) {}
+
+    /**
+     * @brief Appends bytes.
+     * @param bytes The bytes to append.
+     */
+    void append(const std::vector<uint8_t>& bytes) {
+        if (bytes.size() > capacity - position) {
+            throw std::runtime_error("Compressed data does not fit the output buffer");
+        }
+
+        if (!bytes.empty()) {
+            std::memcpy(data + position, bytes.data(), bytes.size());
+        }
+        position += bytes.size();
+    }
+
+    /**
+     * @brief Returns the number of bytes written.
+     * @return The output size.
+     */
+    size_t size() const {
+        return position;
+    }
+};
+
+/**
+ * @brief Maps the public format enum to the wrapper used by the RFC 1951 coder.
+ * @param format A format other than Dfdm.
+ * @return The wrapper.
+ */
+static Rfc1951::Framing toFraming(DeflateFormat format) {
+    return (format == DeflateFormat::Gzip) ? Rfc1951::Framing::Gzip
+        : (format == DeflateFormat::Zlib) ? Rfc1951::Framing::Zlib
+        : Rfc1951::Framing::Raw;
+}
+
+/**
+ * @brief Returns the number of blocks an input is split into.
+ * @param inputSize The input size.
+ * @param blockSize The block size.
+ * @return The block count, at least 1.
+ */
+static size_t blockCount(size_t inputSize, size_t blockSize) {
+    return (inputSize == 0) ? 1 : (inputSize + blockSize - 1) / blockSize;
+}
+
+/**
+ * @brief Checks the block size, code length, stream count and dictionary options.
+ * @param options The options to check.
+ */
+static void validateOptions(const DeflateOptions& options) {
+    if (options.blockSize == 0 || options.blockSize > BlockCodec::MAX_BLOCK_SIZE) {
+        throw std::invalid_argument("Block size must be between 1 byte and 64 MiB");
+    }
+
+    if (options.maxCodeLength < Rfc1951::MIN_CODE_LENGTH_LIMIT || options.maxCodeLength > Huffman::MAX_CODE_LENGTH) {
+        throw std::invalid_argument("Maximum code length must be between 9 and 15");
+    }
+
+    if (options.huffmanStreams != 1 && options.huffmanStreams != Huffman::INTERLEAVED_STREAMS) {
+        throw std::invalid_argument("Huffman streams must be 1 or 4");
+    }
+
+    if (options.dictionary && options.format != DeflateFormat::Dfdm) {
+        throw std::invalid_argument("Dictionaries are only supported by the Dfdm format");
+    }
+}
+
+/**
+ * @brief Decompresses DFDM data block by block straight into the output buffer.
+ * @param data The compressed data.
+ * @param inputSize The number of bytes.
+ * @param out The output buffer.
+ * @param outputCapacity The size of the output buffer.
+ * @param decoder The block decoder to use, set up to verify checksums or not.
+ * @param dictionary The preset dictionary, or nullptr.
+ * @return The number of bytes written to out.
+ */
+static size_t decompressDfdm(const uint8_t* data, size_t inputSize, char* out, size_t outputCapacity, BlockDecoder& decoder, const Dictionary* dictionary) {
+    if (inputSize < BlockCodec::STREAM_HEADER_SIZE) {
+        throw std::runtime_error("Compressed data is too short");
+    }
+
+    uint8_t flags = BlockCodec::readStreamHeader(data);
+    size_t pos = BlockCodec::streamHeaderSize(flags);
+
+    if (inputSize < pos) {
+        throw std::runtime_error("Compressed data is too short");
+    }
+
+    BlockCodec::checkDictionary(flags, data, dictionary);
+
+    decoder.setDictionary(dictionary);
+    decoder.setStreamFlags(flags);
+    size_t blockHeaderSize = BlockCodec::blockHeaderSize(flags);
+    size_t position = 0;
+    size_t base = 0;
+
+    while (true) {
+        if (pos >= inputSize) {
+            throw std::runtime_error("Unexpected end of compressed data");
+        }
+
+        if (data[pos] == BlockCodec::BLOCK_END) {
+            if (decoder.isVerifying()) {
+                if (inputSize - pos - 1 < BlockCodec::STREAM_FOOTER_SIZE) {
+                    throw std::runtime_error("Truncated stream footer");
+                }
+
+                decoder.checkStreamFooter(data + pos + 1);
+            }
+            break;
+        }
+
+        if (inputSize - pos < blockHeaderSize) {
+            throw std::runtime_error("Truncated block header");
+        }
+
+        BlockCodec::BlockHeader header = BlockCodec::parseBlockHeader(data[pos], data + pos + 1, flags);
+        pos += blockHeaderSize;
+
+        if (inputSize - pos < header.bodySize()) {
+            throw std::runtime_error("Truncated block body");
+        }
+
+        // Chunks of independent streams start their own window, with only the dictionary in front.
+        if ((flags & BlockCodec::FLAG_INDEPENDENT_BLOCKS) && !header.continuesChunk) {
+            base = position;
+        }
+
+        position = base + decoder.decodeBlock(header, data + pos, out + base, outputCapacity - base, position - base);
+        pos += header.bodySize();
+    }
+
+    return position;
+}
+
+size_t DeflateDm::compressBound(size_t inputSize, const DeflateOptions& options) {
+    validateOptions(options);
+    size_t blocks = blockCount(inputSize, options.blockSize);
+
+    if (options.format == DeflateFormat::Dfdm) {
+        // A block is never larger than its stored form, so only block headers, the footer and the index add to the input.
+        size_t blockHeaders = inputSize / BlockCodec::SPLIT_PIECE_SIZE + blocks;
+        uint8_t flags = BlockCodec::FLAG_CHECKSUMS | (options.dictionary ? BlockCodec::FLAG_DICTIONARY : 0);
+        return BlockCodec::streamHeaderSize(flags) + 1 + BlockCodec::STREAM_FOOTER_SIZE + BlockCodec::TRAILER_SIZE +
+            blocks * BlockCodec::INDEX_ENTRY_SIZE + blockHeaders * BlockCodec::blockHeaderSize(flags) + inputSize;
+    }
+
+    // The encoder never writes more than stored blocks would: 5 bytes per 65535, plus header and trailer.
+    size_t storedPieces = inputSize / Rfc1951::MAX_STORED_LENGTH + blocks;
+    return inputSize + 5 * storedPieces + blocks + 10 + 8;
+}
+
+size_t DeflateDm::compress(const void* input, size_t inputSize, void* output, size_t outputCapacity, const DeflateOptions& options) {
+    return DeflateContext().compress(input, inputSize, output, outputCapacity, options);
+}
+
+uint64_t DeflateDm::decompressedSize(const void* input, size_t inputSize) {
+    const uint8_t* data = static_cast<const uint8_t*>(input);
+
+    if (inputSize < BlockCodec::STREAM_HEADER_SIZE + 1 + BlockCodec::TRAILER_SIZE) {
+        throw std::runtime_error("Compressed data is too short");
+    }
+
+    uint8_t flags = BlockCodec::readStreamHeader(data);
+    size_t headerSize = BlockCodec::streamHeaderSize(flags);
+
+    if (!(flags & BlockCodec::FLAG_BLOCK_INDEX)) {
+        throw std::runtime_error("Compressed data has no block index");
+    }
+
+    if (inputSize < headerSize + 1 + BlockCodec::TRAILER_SIZE) {
+        throw std::runtime_error("Compressed data is too short");
+    }
+
+    const uint8_t* trailer = data + inputSize - BlockCodec::TRAILER_SIZE;
+    if (std::memcmp(trailer + 4, "DFIX", 4) != 0) {
+        throw std::runtime_error("Block index trailer is missing");
+    }
+
+    uint64_t chunkCount = BlockCodec::readUint32(trailer);
+    uint64_t footerSize = (flags & BlockCodec::FLAG_CHECKSUMS) ? BlockCodec::STREAM_FOOTER_SIZE : 0;
+    if (chunkCount * BlockCodec::INDEX_ENTRY_SIZE + footerSize > inputSize - BlockCodec::TRAILER_SIZE - headerSize - 1) {
+        throw std::runtime_error("Block index is larger than the data");
+    }
+
+    const uint8_t* index = trailer - chunkCount * BlockCodec::INDEX_ENTRY_SIZE;
+    uint64_t size = 0;
+
+    for (uint64_t i = 0; i < chunkCount; ++i) {
+        uint32_t rawSize = BlockCodec::readUint32(index + i * BlockCodec::INDEX_ENTRY_SIZE);
+
+        if (rawSize > BlockCodec::MAX_BLOCK_SIZE) {
+            throw std::runtime_error("Block index entry is larger than a chunk can be");
+        }
+
+        size += rawSize;
+    }
+
+    // The footer repeats the total, so a damaged index is caught before callers allocate for it.
+    if (footerSize && BlockCodec::readFooterSize(index - footerSize) != size) {
+        throw std::runtime_error("Block index does not match the stream footer");
+    }
+
+    return size;
+}
+
+bool DeflateDm::detectFormat(const void* input, size_t inputSize, DeflateFormat& format) {
+    const uint8_t* data = static_cast<const uint8_t*>(input);
+    Rfc1951::Framing framing;
+
+    if (inputSize >= 4 && std::memcmp(data, "DFDM", 4) == 0) {
+        format = DeflateFormat::Dfdm;
+        return true;
+    }
+
+    if (Rfc1951::detectFraming(data, inputSize, framing)) {
+        format = (framing == Rfc1951::Framing::Gzip) ? DeflateFormat::Gzip : DeflateFormat::Zlib;
+        return true;
+    }
+
+    return false;
+}
+
+size_t DeflateDm::decompress(const void* input, size_t inputSize, void* output, size_t outputCapacity) {
+    DeflateFormat format;
+
+    if (!detectFormat(input, inputSize, format)) {
+        throw std::runtime_error("Unknown compressed format");
+    }
+
+    return decompress(input, inputSize, output, outputCapacity, format);
+}
+
+size_t DeflateDm::decompress(const void* input, size_t inputSize, void* output, size_t outputCapacity, const void* dictionary, size_t dictionarySize) {
+    DeflateFormat format;
+
+    if (!detectFormat(input, inputSize, format)) {
+        throw std::runtime_error("Unknown compressed format");
+    }
+
+    return DeflateContext().decompress(input, inputSize, output, outputCapacity, format, dictionary, dictionarySize);
+}
+
+size_t DeflateDm::decompress(const void* input, size_t inputSize, void* output, size_t outputCapacity, DeflateFormat format) {
+    return DeflateContext().decompress(input, inputSize, output, outputCapacity, format);
+}
+
+/**
+ * @brief The coders and scratch buffers of a context, each created on first use.
+ */
+struct DeflateContext::State {
+    std::unique_ptr<BlockEncoder> blockEncoder;
+    std::unique_ptr<DeflateEncoder> deflateEncoder;
+    std::unique_ptr<BlockDecoder> blockDecoder;
+    std::unique_ptr<Inflater> inflater;
+    std::vector<uint8_t> bytes;
+    std::vector<BlockCodec::IndexEntry> index;
+    std::vector<uint8_t> dictionaryBytes;
+    Dictionary dictionary;
+    bool verify = true;
+    uint64_t maxOutputSize = UINT64_MAX;
+
+    /**
+     * @brief Returns the parsed form of a serialized dictionary, parsing it only if it differs from the last one.
+     * @param data The serialized dictionary, or nullptr.
+     * @param size The number of bytes.
+     * @return The dictionary, or nullptr if none was given.
+     */
+    const Dictionary* useDictionary(const void* data, size_t size) {
+        if (!data) {
+            return nullptr;
+        }
+
+        const uint8_t* serialized = static_cast<const uint8_t*>(data);
+        if (dictionaryBytes.empty() || dictionaryBytes.size() != size || std::memcmp(dictionaryBytes.data(), serialized, size) != 0) {
+            dictionaryBytes.clear();
+            dictionary = Dictionary::parse(serialized, size);
+            dictionaryBytes.assign(serialized, serialized + size);
+        }
+
+        return &dictionary;
+    }
+
+    /**
+     * @brief Returns the RFC 1951 decoder.
+     * @return The decoder.
+     */
+    Inflater& getInflater() {
+        if (!inflater) {
+            inflater.reset(new Inflater());
+        }
+
+        return *inflater;
+    }
+
+    /**
+     * @brief Returns the DFDM block decoder.
+     * @return The decoder.
+     */
+    BlockDecoder& getBlockDecoder() {
+        if (!blockDecoder) {
+            blockDecoder.reset(new BlockDecoder());
+        }
+
+        blockDecoder->setVerify(verify);
+        return *blockDecoder;
+    }
+};
+
+DeflateContext::DeflateContext() : state(new State()) {}
+
+DeflateContext::~DeflateContext() = default;
+
+void DeflateContext::setVerifyChecksums(bool verify) {
+    state->verify = verify;
+}
+
+void DeflateContext::setMaxOutputSize(uint64_t limit) {
+    state->maxOutputSize = limit;
+}
+
+size_t DeflateContext::compress(const void* input, size_t inputSize, void* output, size_t outputCapacity, const DeflateOptions& options) {
+    validateOptions(options);
+
+    const char* data = static_cast<const char*>(input);
+    OutputSpan out(output, outputCapacity);
+    std::vector<uint8_t>& bytes = state->bytes;
+    bytes.clear();
+
+    if (options.format == DeflateFormat::Dfdm) {
+        const Dictionary* dictionary = state->useDictionary(options.dictionary, options.dictionarySize);
+        uint8_t flags = BlockCodec::FLAG_BLOCK_INDEX | BlockCodec::FLAG_CHECKSUMS | (dictionary ? BlockCodec::FLAG_DICTIONARY : 0);
+
+        BlockCodec::writeStreamHeader(bytes, flags, dictionary ? dictionary->getId() : 0);
+        out.append(bytes);
+
+        if (!state->blockEncoder) {
+            state->blockEncoder.reset(new BlockEncoder(options.level));
+        }
+
+        BlockEncoder& encoder = *state->blockEncoder;
+        encoder.setLevel(options.level);
+        encoder.setMaxCodeLength(options.maxCodeLength);
+        encoder.setHuffmanStreams(options.huffmanStreams);
+        encoder.setDictionary(dictionary);
+        encoder.setChecksums(true);
+        encoder.setStats(options.stats);
+        std::vector<BlockCodec::IndexEntry>& index = state->index;
+        index.clear();
+        uint32_t checksum = Checksum::CRC32C_INIT;
+
+        // Each block is staged in bytes and then copied out rather than encoded into the caller's buffer.
+        // BlockEncoder appends to a vector because the file and parallel compressors share it. A block's
+        // header holds the body size and CRC-32C, so it is only written once the body is done, and a
+        // block that codes larger than its input is replaced by a stored one. The copy covers compressed
+        // bytes only, and bytes keeps its capacity between blocks and calls, so staging allocates nothing.
+        for (size_t start = 0; start < inputSize; start += options.blockSize) {
+            size_t historyStart = (start > BlockCodec::HISTORY_SIZE) ? start - BlockCodec::HISTORY_SIZE : 0;
+            size_t end = start + std::min(options.blockSize, inputSize - start);
+
+            bytes.clear();
+            encoder.encodeBlock(data + historyStart, end - historyStart, start - historyStart, bytes);
+            out.append(bytes);
+            index.push_back(BlockCodec::IndexEntry{ static_cast<uint32_t>(end - start), static_cast<uint32_t>(bytes.size()) });
+            checksum = Checksum::crcCombine(Checksum::CRC32C_POLYNOMIAL, checksum, encoder.getChecksum(), end - start);
+        }
+
+        bytes.clear();
+        BlockCodec::writeBlockHeader(bytes, BlockCodec::BlockHeader{ BlockCodec::BLOCK_END, 0, 0 });
+        BlockCodec::writeStreamFooter(bytes, inputSize, checksum);
+        BlockCodec::writeIndex(bytes, index);
+        out.append(bytes);
+
+        return out.size();
+    }
+
+    Rfc1951::Framing framing = toFraming(options.format);
+    Rfc1951::writeHeader(bytes, framing, options.level);
+    out.append(bytes);
+
+    if (!state->deflateEncoder) {
+        state->deflateEncoder.reset(new DeflateEncoder(options.level));
+    }
+
+    // A call that failed part way leaves bits of its stream behind.
+    DeflateEncoder& encoder = *state->deflateEncoder;
+    encoder.reset();
+    encoder.setLevel(options.level);
+    encoder.setMaxCodeLength(options.maxCodeLength);
+    encoder.setStats(options.stats);
+    uint32_t checksum = Rfc1951::initialChecksum(framing);
+    size_t start = 0;
+
+    do {
+        size_t historyStart = (start > BlockCodec::HISTORY_SIZE) ? start - BlockCodec::HISTORY_SIZE : 0;
+        size_t end = start + std::min(options.blockSize, inputSize - start);
+
+        encoder.encodeBlock(data + historyStart, end - historyStart, start - historyStart, end == inputSize);
+        checksum = Rfc1951::updateChecksum(framing, checksum, data + start, end - start);
+        out.append(end == inputSize ? encoder.finish() : encoder.takeOutput());
+        start = end;
+    } while (start < inputSize);
+
+    bytes.clear();
+    Rfc1951::writeTrailer(bytes, framing, checksum, inputSize);
+    out.append(bytes);
+
+    return out.size();
+}
+
+size_t DeflateContext::decompress(const void* input, size_t inputSize, void* output, size_t outputCapacity, DeflateFormat format,
+    const void* dictionary, size_t dictionarySize) {
+    const uint8_t* data = static_cast<const uint8_t*>(input);
+    char* out = static_cast<char*>(output);
+    size_t position = 0;
+    size_t pos = 0;
+
+    if (format == DeflateFormat::Dfdm) {
+        const Dictionary* preset = state->useDictionary(dictionary, dictionarySize);
+        return decompressDfdm(data, inputSize, out, outputCapacity, state->getBlockDecoder(), preset);
+    }
+
+    Rfc1951::Framing framing = toFraming(format);
+    Inflater& inflater = state->getInflater();
+
+    do {
+        pos += Rfc1951::parseHeader(data + pos, inputSize - pos, framing);
+
+        uint32_t checksum = Rfc1951::initialChecksum(framing);
+        std::function<void(const char*, size_t)> checksumBlock;
+        if (state->verify) {
+            checksumBlock = [&](const char* bytes, size_t size) {
+                checksum = Rfc1951::updateChecksum(framing, checksum, bytes, size);
+            };
+        }
+
+        size_t memberSize = 0;
+        pos += inflater.inflate(data + pos, inputSize - pos, out + position, outputCapacity - position, memberSize, checksumBlock);
+
+        if (inputSize - pos < Rfc1951::trailerSize(framing)) {
+            throw std::runtime_error("Truncated stream trailer");
+        }
+
+        Rfc1951::checkTrailer(framing, data + pos, checksum, memberSize, state->verify);
+
+        pos += Rfc1951::trailerSize(framing);
+        position += memberSize;
+    } while (framing == Rfc1951::Framing::Gzip && pos < inputSize);
+
+    return position;
+}
+
+void DeflateContext::decompress(const void* input, size_t inputSize, std::vector<uint8_t>& output, DeflateFormat format,
+    const void* dictionary, size_t dictionarySize) {
+    const uint8_t* data = static_cast<const uint8_t*>(input);
+    output.clear();
+
+    if (format == DeflateFormat::Dfdm) {
+        // Room for the wide match copies past the end.
+        uint64_t size = DeflateDm::decompressedSize(input, inputSize);
+        if (size > state->maxOutputSize) {
+            throw std::runtime_error("Decompressed data is larger than the output limit");
+        }
+
+        output.resize(static_cast<size_t>(size) + 16);
+        output.resize(decompress(input, inputSize, output.data(), output.size(), format, dictionary, dictionarySize));
+        return;
+    }
+
+    Rfc1951::Framing framing = toFraming(format);
+    Inflater& inflater = state->getInflater();
+    size_t pos = 0;
+
+    do {
+        pos += Rfc1951::parseHeader(data + pos, inputSize - pos, framing);
+
+        uint32_t checksum = Rfc1951::initialChecksum(framing);
+        size_t memberStart = output.size();
+        pos += inflater.inflate(data + pos, inputSize - pos, [&](const char* bytes, size_t size) {
+            if (size > state->maxOutputSize - output.size()) {
+                throw std::runtime_error("Decompressed data is larger than the output limit");
+            }
+
+            output.insert(output.end(), bytes, bytes + size);
+            if (state->verify) {
+                checksum = Rfc1951::updateChecksum(framing, checksum, bytes, size);
+            }
+        });
+
+        if (inputSize - pos < Rfc1951::trailerSize(framing)) {
+            throw std::runtime_error("Truncated stream trailer");
+        }
+
+        size_t memberSize = output.size() - memberStart;
+        Rfc1951::checkTrailer(framing, data + pos, checksum, memberSize, state->verify);
+
+        pos += Rfc1951::trailerSize(framing);
+    } while (framing == Rfc1951::Framing::Gzip && pos < inputSize);
+}
@@ -0,0 +1,199 @@
+#ifndef DEFLATE_DM_H
+#define DEFLATE_DM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class CodecStats;
+
+/**
+ * @brief Container formats the library reads and writes.
+ * Dfdm is this project's block format with a block index; Deflate is a raw RFC 1951 stream, and
+ * Zlib and Gzip wrap it as RFC 1950 and RFC 1952 do.
+ */
+enum class DeflateFormat { Dfdm, Deflate, Zlib, Gzip };
+
+/**
+ * @brief Settings for DeflateDm::compress.
+ */
+struct DeflateOptions {
+    DeflateFormat format = DeflateFormat::Dfdm;
+    int level = 6;               ///< Between 1 (fastest) and 11 (smallest output); 10 and 11 parse optimally and are much slower.
+    size_t blockSize = 1 << 20;  ///< Input bytes per block (Dfdm: per indexed chunk, which may be split into smaller blocks), at most 64 MiB.
+    int maxCodeLength = 15;      ///< The longest Huffman code, between 9 and 15; shorter codes decode faster but compress less.
+    int huffmanStreams = 1;      ///< Dfdm only: 4 codes each block in four interleaved bit streams, which decode faster.
+    const void* dictionary = nullptr;  ///< A serialized preset dictionary made by `deflate train`; Dfdm only.
+    size_t dictionarySize = 0;         ///< The size of the serialized dictionary in bytes.
+    CodecStats* stats = nullptr;       ///< Receives per-stage timings and token counts when set (see codecstats.h).
+};
+
+/**
+ * @brief Buffer-to-buffer compression and decompression.
+ *
+ * Input is read in place and decompressed data is written straight into the caller's buffer, so
+ * nothing goes through files or intermediate copies of the data. Every function is reentrant;
+ * errors are reported as std::runtime_error (std::invalid_argument for bad options).
+ */
+class DeflateDm {
+public:
+    /**
+     * @brief Returns an output size that compress() never exceeds.
+     * @param inputSize The number of bytes to be compressed.
+     * @param options The settings that will be passed to compress().
+     * @return The worst-case compressed size in bytes.
+     */
+    static size_t compressBound(size_t inputSize, const DeflateOptions& options = DeflateOptions());
+
+    /**
+     * @brief Compresses a buffer.
+     * @param input The bytes to compress.
+     * @param inputSize The number of bytes.
+     * @param output The buffer that receives the compressed data.
+     * @param outputCapacity The size of the output buffer; compressBound() is always enough.
+     * @param options Format, level and block size.
+     * @return The number of bytes written to output.
+     * @throws std::runtime_error if the compressed data does not fit.
+     */
+    static size_t compress(const void* input, size_t inputSize, void* output, size_t outputCapacity, const DeflateOptions& options = DeflateOptions());
+
+    /**
+     * @brief Returns the decompressed size recorded in a DFDM block index.
+     * @param input The compressed data.
+     * @param inputSize The number of bytes.
+     * @return The size of the decompressed data.
+     * @throws std::runtime_error if the data is not DFDM or has no block index.
+     */
+    static uint64_t decompressedSize(const void* input, size_t inputSize);
+
+    /**
+     * @brief Decompresses a buffer whose format is detected from its header.
+     * Raw DEFLATE has no header; use the overload that takes a format for it.
+     * @param input The compressed data.
+     * @param inputSize The number of bytes.
+     * @param output The buffer that receives the decompressed data.
+     * @param outputCapacity The size of the output buffer. Matches are copied in wide moves, so bytes
+     * past the returned size, up to 15 of them, may be overwritten as well.
+     * @return The number of bytes written to output.
+     * @throws std::runtime_error if the data is invalid, fails its checksum or does not fit.
+     */
+    static size_t decompress(const void* input, size_t inputSize, void* output, size_t outputCapacity);
+
+    /**
+     * @brief Decompresses a buffer of a known format.
+     * @param input The compressed data.
+     * @param inputSize The number of bytes.
+     * @param output The buffer that receives the decompressed data.
+     * @param outputCapacity The size of the output buffer; up to 15 bytes past the returned size may be overwritten.
+     * @param format The format of the compressed data.
+     * @return The number of bytes written to output.
+     * @throws std::runtime_error if the data is invalid, fails its checksum or does not fit.
+     */
+    static size_t decompress(const void* input, size_t inputSize, void* output, size_t outputCapacity, DeflateFormat format);
+
+    /**
+     * @brief Decompresses a buffer whose format is detected from its header, using a preset dictionary.
+     * The dictionary is only used by DFDM data compressed with it; other data decodes as usual.
+     * @param input The compressed data.
+     * @param inputSize The number of bytes.
+     * @param output The buffer that receives the decompressed data.
+     * @param outputCapacity The size of the output buffer; up to 15 bytes past the returned size may be overwritten.
+     * @param dictionary The serialized dictionary the data was compressed with.
+     * @param dictionarySize The size of the serialized dictionary.
+     * @return The number of bytes written to output.
+     * @throws std::runtime_error if the data is invalid, needs a different dictionary or does not fit.
+     */
+    static size_t decompress(const void* input, size_t inputSize, void* output, size_t outputCapacity, const void* dictionary, size_t dictionarySize);
+
+    /**
+     * @brief Detects the format of compressed data from its first bytes.
+     * @param input The compressed data.
+     * @param inputSize The number of bytes.
+     * @param format Receives the detected format.
+     * @return false if the data starts with no known header; it may still be raw DEFLATE.
+     */
+    static bool detectFormat(const void* input, size_t inputSize, DeflateFormat& format);
+};
+
+/**
+ * @brief A compressor and decompressor that keeps its working memory between calls.
+ *
+ * The DeflateDm functions set up match finder tables, Huffman tables and token buffers for every
+ * call. A context creates them on first use and only resets them for the following calls, and keeps
+ * the last preset dictionary parsed, which makes it the better choice for many small buffers. A
+ * context is not thread-safe; use one per thread.
+ */
+class DeflateContext {
+public:
+    DeflateContext();
+    ~DeflateContext();
+
+    DeflateContext(const DeflateContext&) = delete;
+    DeflateContext& operator=(const DeflateContext&) = delete;
+
+    /**
+     * @brief Turns checksum verification of the following decompress calls on (the default) or off.
+     * Turning it off saves a pass of CRC-32C (Dfdm) or CRC-32/Adler-32 (Gzip, Zlib) over the output
+     * and is meant for data that is known to be intact; corrupt data may then decode to wrong bytes.
+     * @param verify Whether to check the checksums the data carries.
+     */
+    void setVerifyChecksums(bool verify);
+
+    /**
+     * @brief Limits how much data the following decompress calls into a vector may produce.
+     * DFDM data whose block index declares more is rejected before anything is allocated, and
+     * DEFLATE, zlib and gzip data is rejected as soon as its output passes the limit, so a small
+     * hostile input cannot make the context allocate gigabytes. Calls into a caller-provided buffer
+     * are bounded by its capacity instead.
+     * @param limit The largest decompressed size in bytes; there is no limit by default.
+     */
+    void setMaxOutputSize(uint64_t limit);
+
+    /**
+     * @brief Compresses a buffer, as DeflateDm::compress does.
+     * @param input The bytes to compress.
+     * @param inputSize The number of bytes.
+     * @param output The buffer that receives the compressed data.
+     * @param outputCapacity The size of the output buffer; DeflateDm::compressBound() is always enough.
+     * @param options Format, level and block size.
+     * @return The number of bytes written to output.
+     * @throws std::runtime_error if the compressed data does not fit.
+     */
+    size_t compress(const void* input, size_t inputSize, void* output, size_t outputCapacity, const DeflateOptions& options = DeflateOptions());
+
+    /**
+     * @brief Decompresses a buffer of a known format into a caller-provided buffer.
+     * @param input The compressed data.
+     * @param inputSize The number of bytes.
+     * @param output The buffer that receives the decompressed data.
+     * @param outputCapacity The size of the output buffer; up to 15 bytes past the returned size may be overwritten.
+     * @param format The format of the compressed data.
+     * @param dictionary The serialized dictionary DFDM data was compressed with, or nullptr; other formats ignore it.
+     * @param dictionarySize The size of the serialized dictionary.
+     * @return The number of bytes written to output.
+     * @throws std::runtime_error if the data is invalid, fails its checksum or does not fit.
+     */
+    size_t decompress(const void* input, size_t inputSize, void* output, size_t outputCapacity, DeflateFormat format,
+        const void* dictionary = nullptr, size_t dictionarySize = 0);
+
+    /**
+     * @brief Decompresses a buffer of a known format into a vector sized to fit.
+     * DFDM output is sized from the block index; the other formats grow the vector as they decode.
+     * @param input The compressed data.
+     * @param inputSize The number of bytes.
+     * @param output Receives the decompressed data; earlier contents are dropped.
+     * @param format The format of the compressed data.
+     * @param dictionary The serialized dictionary DFDM data was compressed with, or nullptr; other formats ignore it.
+     * @param dictionarySize The size of the serialized dictionary.
+     * @throws std::runtime_error if the data is invalid, fails its checksum or decodes past the output limit.
+     */
+    void decompress(const void* input, size_t inputSize, std::vector<uint8_t>& output, DeflateFormat format,
+        const void* dictionary = nullptr, size_t dictionarySize = 0);
+
+private:
+    struct State;
+    std::unique_ptr<State> state;
+};
+
+#endif
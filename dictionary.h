@@ -0,0 +1,283 @@
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bytekernels.h"
+#include "checksum.h"
+#include "huffman.h"
+#include "lz77.h"
+
+/**
+ * @brief A preset dictionary and a shared Huffman table for compressing many small, similar inputs.
+ *
+ * The content primes the LZ77 window, so the first bytes of an input can already refer back to
+ * common substrings. The code lengths describe a Huffman code for the LZ77 token bytes of typical
+ * inputs; blocks coded with it need no code-length header. Both come from Dictionary::train and are
+ * identified by a CRC-32 of the dictionary, which compressed streams record so that decoding with a
+ * different dictionary fails cleanly.
+ *
+ * The serialized form is "DFDC", a version byte, the ID, the content size (32-bit little-endian),
+ * the content and one code length byte per token byte value.
+ */
+class Dictionary {
+public:
+    static constexpr uint8_t VERSION = 1;
+    static constexpr size_t MAX_CONTENT_SIZE = 32768;
+    static constexpr size_t DEFAULT_CONTENT_SIZE = 16384;
+    static constexpr int TOKEN_SYMBOLS = 256;
+
+private:
+    static constexpr size_t HEADER_SIZE = 13;
+    static constexpr size_t GRAM_LENGTH = 8;
+
+    std::string content;
+    std::vector<int> codeLengths;
+    uint32_t id;
+
+    /**
+     * @brief Recomputes the ID from the content and the code lengths.
+     */
+    void updateId() {
+        id = Checksum::crc32(Checksum::CRC32_INIT, reinterpret_cast<const uint8_t*>(content.data()), content.size());
+
+        for (int length : codeLengths) {
+            uint8_t byte = static_cast<uint8_t>(length);
+            id = Checksum::crc32(id, &byte, 1);
+        }
+    }
+
+    /**
+     * @brief Reads the 8 bytes at a position as one integer key.
+     * @param data The bytes.
+     * @return The key.
+     */
+    static uint64_t gramKey(const char* data) {
+        uint64_t key;
+        std::memcpy(&key, data, GRAM_LENGTH);
+        return key;
+    }
+
+    /**
+     * @brief Picks the substrings that recur most across the samples.
+     * Every 8-byte substring is counted over all samples; runs of positions whose substring recurs
+     * become candidate segments, scored by how often their substrings recur in total. The best
+     * segments are kept until maxSize is reached, the best ones last, since they then sit closest to
+     * the data and get the shortest offsets.
+     * @param samples Typical inputs.
+     * @param maxSize The largest content size.
+     * @return The content.
+     */
+    static std::string selectContent(const std::vector<std::string>& samples, size_t maxSize) {
+        std::unordered_map<uint64_t, uint32_t> gramCounts;
+
+        for (const std::string& sample : samples) {
+            for (size_t position = 0; position + GRAM_LENGTH <= sample.size(); ++position) {
+                gramCounts[gramKey(sample.data() + position)]++;
+            }
+        }
+
+        std::unordered_map<std::string, uint64_t> segments;
+
+        for (const std::string& sample : samples) {
+            size_t position = 0;
+
+            while (position + GRAM_LENGTH <= sample.size()) {
+                uint32_t count = gramCounts[gramKey(sample.data() + position)];
+
+                if (count < 2) {
+                    position++;
+                    continue;
+                }
+
+                size_t end = position;
+                uint64_t score = 0;
+
+                while (end + GRAM_LENGTH <= sample.size() && (count = gramCounts[gramKey(sample.data() + end)]) >= 2) {
+                    score += count;
+                    end++;
+                }
+
+                std::string segment = sample.substr(position, std::min(end - position + GRAM_LENGTH - 1, maxSize));
+                uint64_t& best = segments[segment];
+                best = std::max(best, score);
+                position = end;
+            }
+        }
+
+        std::vector<std::pair<uint64_t, std::string>> ranked;
+        ranked.reserve(segments.size());
+        for (auto& segment : segments) {
+            ranked.emplace_back(segment.second, segment.first);
+        }
+
+        std::sort(ranked.begin(), ranked.end(), [](const std::pair<uint64_t, std::string>& left, const std::pair<uint64_t, std::string>& right) {
+            return left.first != right.first ? left.first > right.first : left.second < right.second;
+        });
+
+        std::vector<const std::string*> chosen;
+        std::string selected;
+
+        for (const auto& candidate : ranked) {
+            if (selected.size() + candidate.second.size() > maxSize) {
+                continue;
+            }
+
+            if (selected.find(candidate.second) != std::string::npos) {
+                continue;
+            }
+
+            chosen.push_back(&candidate.second);
+            selected += candidate.second;
+        }
+
+        std::string result;
+        result.reserve(selected.size());
+        for (auto segment = chosen.rbegin(); segment != chosen.rend(); ++segment) {
+            result += **segment;
+        }
+
+        return result;
+    }
+
+public:
+    /**
+     * @brief Constructor makes an empty dictionary, which primes nothing and has no shared table.
+     */
+    Dictionary() : codeLengths(), id(0) {
+        updateId();
+    }
+
+    /**
+     * @brief Trains a dictionary on typical inputs.
+     * The content is made of the substrings that recur most across the samples. The shared table is
+     * built from the LZ77 tokens of every sample compressed against that content; every token byte
+     * gets a code, so any input can be coded with it.
+     * @param samples Typical inputs.
+     * @param maxSize The largest content size, at most MAX_CONTENT_SIZE.
+     * @param level The compression level the dictionary will be used with.
+     * @return The dictionary.
+     */
+    static Dictionary train(const std::vector<std::string>& samples, size_t maxSize = DEFAULT_CONTENT_SIZE, int level = Lz77::DEFAULT_LEVEL) {
+        if (maxSize > MAX_CONTENT_SIZE) {
+            throw std::invalid_argument("Dictionary size must be at most 32 KiB");
+        }
+
+        Dictionary dictionary;
+        dictionary.content = selectContent(samples, maxSize);
+
+        Lz77 lz77(level);
+        std::vector<uint32_t> frequencies(TOKEN_SYMBOLS, 1);
+        uint32_t counts[TOKEN_SYMBOLS];
+
+        for (const std::string& sample : samples) {
+            std::string window = dictionary.content + sample;
+            std::string tokenBytes = Lz77::compressedToBytes(lz77.lz77Compress(window.data(), window.size(), dictionary.content.size()));
+
+            ByteKernels::histogram(reinterpret_cast<const uint8_t*>(tokenBytes.data()), tokenBytes.size(), counts);
+            for (int symbol = 0; symbol < TOKEN_SYMBOLS; ++symbol) {
+                frequencies[symbol] = static_cast<uint32_t>(std::min<uint64_t>(uint64_t(frequencies[symbol]) + counts[symbol], UINT32_MAX / TOKEN_SYMBOLS));
+            }
+        }
+
+        Huffman huffman(TOKEN_SYMBOLS);
+        huffman.buildFromFrequencies(frequencies);
+        dictionary.codeLengths = huffman.getCodeLengths();
+        dictionary.updateId();
+
+        return dictionary;
+    }
+
+    /**
+     * @brief Reads a dictionary written by serialize().
+     * @param data The serialized dictionary.
+     * @param size The number of bytes.
+     * @return The dictionary.
+     * @throws std::runtime_error if the data is not a valid dictionary.
+     */
+    static Dictionary parse(const uint8_t* data, size_t size) {
+        if (size < HEADER_SIZE || std::memcmp(data, "DFDC", 4) != 0) {
+            throw std::runtime_error("Not a dictionary: bad magic");
+        }
+
+        if (data[4] != VERSION) {
+            throw std::runtime_error("Unsupported dictionary version");
+        }
+
+        uint32_t storedId = static_cast<uint32_t>(data[5]) | (static_cast<uint32_t>(data[6]) << 8) |
+            (static_cast<uint32_t>(data[7]) << 16) | (static_cast<uint32_t>(data[8]) << 24);
+        size_t contentSize = static_cast<size_t>(data[9]) | (static_cast<size_t>(data[10]) << 8) |
+            (static_cast<size_t>(data[11]) << 16) | (static_cast<size_t>(data[12]) << 24);
+
+        if (contentSize > MAX_CONTENT_SIZE || size != HEADER_SIZE + contentSize + TOKEN_SYMBOLS) {
+            throw std::runtime_error("Dictionary has the wrong size");
+        }
+
+        Dictionary dictionary;
+        dictionary.content.assign(reinterpret_cast<const char*>(data + HEADER_SIZE), contentSize);
+        dictionary.codeLengths.assign(data + HEADER_SIZE + contentSize, data + size);
+
+        // Checks that the lengths form a prefix code before any encoder or decoder relies on them.
+        Huffman(TOKEN_SYMBOLS).buildFromLengths(dictionary.codeLengths);
+        dictionary.updateId();
+
+        if (dictionary.id != storedId) {
+            throw std::runtime_error("Dictionary is corrupt: ID mismatch");
+        }
+
+        return dictionary;
+    }
+
+    /**
+     * @brief Writes the dictionary in the form parse() reads.
+     * @return The serialized dictionary.
+     */
+    std::vector<uint8_t> serialize() const {
+        std::vector<uint8_t> out = { 'D', 'F', 'D', 'C', VERSION };
+
+        for (uint32_t value : { id, static_cast<uint32_t>(content.size()) }) {
+            for (int i = 0; i < 4; ++i) {
+                out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+            }
+        }
+
+        out.insert(out.end(), content.begin(), content.end());
+        for (int symbol = 0; symbol < TOKEN_SYMBOLS; ++symbol) {
+            out.push_back(static_cast<uint8_t>(symbol < static_cast<int>(codeLengths.size()) ? codeLengths[symbol] : 0));
+        }
+
+        return out;
+    }
+
+    /**
+     * @brief Returns the ID that compressed streams record.
+     * @return The CRC-32 of the content and the code lengths.
+     */
+    uint32_t getId() const {
+        return id;
+    }
+
+    /**
+     * @brief Returns the bytes that prime the LZ77 window.
+     * @return The content; matches may refer to it as if it preceded the input.
+     */
+    const std::string& getContent() const {
+        return content;
+    }
+
+    /**
+     * @brief Returns the code lengths of the shared table.
+     * @return One length per token byte value, or nothing if the dictionary has no table.
+     */
+    const std::vector<int>& getCodeLengths() const {
+        return codeLengths;
+    }
+};
+
+#endif
@@ -0,0 +1,595 @@
+#ifndef FILEMANAGER_H
+#define FILEMANAGER_H
+
+#include <fstream>
+#include <vector>
+#include <iostream>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <cstring>
+#include <memory>
+#include <algorithm>
+#include <cerrno>
+
+#include "codecstats.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define FILEMANAGER_POSIX 1
+#endif
+
+/**
+ * @brief Reads up to `size` bytes from a stream, stopping early only at end of file.
+ * @param file The stream to read from.
+ * @param buffer The destination buffer.
+ * @param size The maximal number of bytes to read.
+ * @return The number of bytes actually read.
+ */
+inline size_t readChunk(std::istream& file, char* buffer, size_t size) {
+    file.read(buffer, static_cast<std::streamsize>(size));
+    return static_cast<size_t>(file.gcount());
+}
+
+/**
+ * @brief Writes a byte buffer to a stream.
+ * @param file The stream to write to.
+ * @param data The bytes to write.
+ * @throws std::runtime_error if the write fails.
+ */
+inline void writeBytes(std::ostream& file, const std::vector<uint8_t>& data) {
+    if (!file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()))) {
+        throw std::runtime_error("Error: file cannot be written!");
+    }
+}
+
+/**
+ * @brief Opens a file for binary reading.
+ * @param fileName The path of the file.
+ * @return The opened stream.
+ * @throws std::runtime_error if the file cannot be opened.
+ */
+inline std::ifstream openInputFile(const std::string& fileName) {
+    std::ifstream file(fileName, std::ios::binary);
+
+    if (!file) {
+        throw std::runtime_error("Error: file cannot be opened: " + fileName);
+    }
+
+    return file;
+}
+
+/**
+ * @brief Opens a file for binary writing, replacing its contents.
+ * @param fileName The path of the file.
+ * @return The opened stream.
+ * @throws std::runtime_error if the file cannot be created.
+ */
+inline std::ofstream openOutputFile(const std::string& fileName) {
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+
+    if (!file) {
+        throw std::runtime_error("Error: file cannot be created: " + fileName);
+    }
+
+    return file;
+}
+
+/**
+ * @brief A file opened for reading, memory-mapped where possible.
+ *
+ * Regular files are mapped read-only on POSIX systems, so readers look at the file's bytes in place
+ * and nothing is copied through iostreams. Anything that cannot be mapped (pipes, other platforms)
+ * falls back to a buffered stream, and view() copies into a caller buffer instead.
+ */
+class InputFile {
+private:
+    std::string fileName;
+    const uint8_t* mapping;
+    uint64_t fileSize;
+    bool mapped;
+    std::unique_ptr<std::ifstream> stream;
+    uint64_t streamPosition;
+    CodecStats* stats;
+
+    /**
+     * @brief Maps a regular file into memory.
+     * @return false if the file is not a regular file or cannot be mapped.
+     */
+    bool map() {
+#ifdef FILEMANAGER_POSIX
+        int descriptor = ::open(fileName.c_str(), O_RDONLY);
+        if (descriptor < 0) {
+            return false;
+        }
+
+        struct stat status;
+        if (::fstat(descriptor, &status) != 0 || !S_ISREG(status.st_mode)) {
+            ::close(descriptor);
+            return false;
+        }
+
+        fileSize = static_cast<uint64_t>(status.st_size);
+
+        if (fileSize > 0) {
+            void* address = ::mmap(nullptr, static_cast<size_t>(fileSize), PROT_READ, MAP_PRIVATE, descriptor, 0);
+
+            if (address == MAP_FAILED) {
+                ::close(descriptor);
+                return false;
+            }
+
+            ::madvise(address, static_cast<size_t>(fileSize), MADV_SEQUENTIAL);
+            mapping = static_cast<const uint8_t*>(address);
+        }
+
+        ::close(descriptor);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * @brief Moves the fallback stream to an offset, seeking only when it is not already there.
+     * Sequential readers therefore also work on streams that cannot seek.
+     * @param offset The offset in the file.
+     */
+    void seekStream(uint64_t offset) {
+        if (offset != streamPosition) {
+            stream->clear();
+            stream->seekg(static_cast<std::streamoff>(offset));
+            streamPosition = offset;
+        }
+    }
+
+public:
+    /**
+     * @brief Opens a file, mapping it if it is a regular file.
+     * @param fileName The path of the file.
+     * @throws std::runtime_error if the file cannot be opened.
+     */
+    explicit InputFile(const std::string& fileName)
+        : fileName(fileName), mapping(nullptr), fileSize(0), mapped(false), streamPosition(0), stats(nullptr) {
+        mapped = map();
+
+        if (!mapped) {
+            stream.reset(new std::ifstream(openInputFile(fileName)));
+        }
+    }
+
+    InputFile(const InputFile&) = delete;
+    InputFile& operator=(const InputFile&) = delete;
+
+    /**
+     * @brief Collects the time and bytes of the following copying reads.
+     * Bytes used in place from a mapped file are not copied and not counted.
+     * @param target The stats to add to, or nullptr to stop collecting.
+     */
+    void setStats(CodecStats* target) {
+        stats = target;
+    }
+
+    ~InputFile() {
+#ifdef FILEMANAGER_POSIX
+        if (mapping) {
+            ::munmap(const_cast<uint8_t*>(mapping), static_cast<size_t>(fileSize));
+        }
+#endif
+    }
+
+    /**
+     * @brief Tells whether the file is mapped, i.e. whether data() can be used.
+     * @return true for mapped files.
+     */
+    bool isMapped() const {
+        return mapped;
+    }
+
+    /**
+     * @brief Returns the mapped contents of the file.
+     * @return The first byte of the file; only valid for mapped files.
+     */
+    const uint8_t* data() const {
+        static const uint8_t empty = 0;
+        return mapping ? mapping : &empty;
+    }
+
+    /**
+     * @brief Returns the size of the file.
+     * @return The size in bytes; for a stream that cannot seek, 0.
+     */
+    uint64_t size() {
+        if (mapped) {
+            return fileSize;
+        }
+
+        stream->clear();
+        stream->seekg(0, std::ios::end);
+        std::streamoff end = stream->tellg();
+        stream->clear();
+        stream->seekg(static_cast<std::streamoff>(streamPosition));
+        stream->clear();
+
+        return (end > 0) ? static_cast<uint64_t>(end) : 0;
+    }
+
+    /**
+     * @brief Copies up to size bytes at an offset into a buffer.
+     * @param offset The offset in the file.
+     * @param buffer The destination.
+     * @param size The most bytes to read.
+     * @return The number of bytes read; fewer than size only at the end of the file.
+     */
+    size_t read(uint64_t offset, char* buffer, size_t size) {
+        CodecStats::Timer timer(stats, CodecStats::STAGE_READ);
+        size_t count = 0;
+
+        if (mapped) {
+            count = (offset < fileSize) ? static_cast<size_t>(std::min<uint64_t>(size, fileSize - offset)) : 0;
+            if (count > 0) {
+                std::memcpy(buffer, mapping + offset, count);
+            }
+        }
+        else {
+            seekStream(offset);
+            count = readChunk(*stream, buffer, size);
+            streamPosition += count;
+        }
+
+        if (stats) {
+            stats->addBytes(CodecStats::STAGE_READ, count, count);
+        }
+
+        return count;
+    }
+
+    /**
+     * @brief Returns exactly size bytes at an offset, in place if the file is mapped.
+     * @param offset The offset in the file.
+     * @param size The number of bytes.
+     * @param buffer Holds the bytes if the file is not mapped.
+     * @return The bytes; valid until buffer changes or the file is closed.
+     * @throws std::runtime_error if the file ends first.
+     */
+    const uint8_t* view(uint64_t offset, size_t size, std::vector<uint8_t>& buffer) {
+        if (mapped) {
+            if (offset > fileSize || size > fileSize - offset) {
+                throw std::runtime_error("Unexpected end of compressed file");
+            }
+            return mapping + offset;
+        }
+
+        buffer.resize(size);
+        if (read(offset, reinterpret_cast<char*>(buffer.data()), size) != size) {
+            throw std::runtime_error("Unexpected end of compressed file");
+        }
+
+        return buffer.data();
+    }
+
+    /**
+     * @brief Returns the whole file, in place if it is mapped.
+     * Unmapped files are read to the end, so this also works for streams that cannot seek.
+     * @param buffer Holds the bytes if the file is not mapped.
+     * @param size Receives the number of bytes.
+     * @return The bytes; valid until buffer changes or the file is closed.
+     */
+    const uint8_t* contents(std::vector<uint8_t>& buffer, size_t& size) {
+        if (mapped) {
+            size = static_cast<size_t>(fileSize);
+            return data();
+        }
+
+        const size_t piece = 1 << 20;
+        buffer.clear();
+        uint64_t offset = 0;
+
+        while (true) {
+            buffer.resize(static_cast<size_t>(offset) + piece);
+            size_t count = read(offset, reinterpret_cast<char*>(buffer.data()) + offset, piece);
+            offset += count;
+
+            if (count < piece) {
+                break;
+            }
+        }
+
+        buffer.resize(static_cast<size_t>(offset));
+        size = buffer.size();
+        return buffer.data();
+    }
+
+    /**
+     * @brief Tells whether an offset is at or past the end of the file.
+     * @param offset The offset in the file.
+     * @return true if no byte follows offset.
+     */
+    bool atEnd(uint64_t offset) {
+        if (mapped) {
+            return offset >= fileSize;
+        }
+
+        seekStream(offset);
+        return stream->peek() == std::char_traits<char>::eof();
+    }
+};
+
+/**
+ * @brief Walks an input file block by block, each block preceded by up to historySize bytes of the input before it.
+ * Mapped files are windowed in place. Otherwise the window is a buffer that keeps only the history
+ * between blocks, so memory use depends on the block size rather than the file size.
+ */
+class InputWindow {
+private:
+    InputFile& input;
+    size_t blockSize;
+    size_t historySize;
+    std::string buffer;
+    const char* windowData;
+    size_t windowSize;
+    size_t blockStart;
+    uint64_t offset;
+
+public:
+    /**
+     * @brief Constructor starts before the first block.
+     * @param input The file to read.
+     * @param blockSize The number of input bytes per block.
+     * @param historySize The number of earlier bytes to keep in front of every block.
+     */
+    InputWindow(InputFile& input, size_t blockSize, size_t historySize)
+        : input(input), blockSize(blockSize), historySize(historySize), windowData(nullptr), windowSize(0), blockStart(0), offset(0) {}
+
+    /**
+     * @brief Moves to the next block.
+     * @return false if the input has no more bytes; the window is then empty.
+     */
+    bool next() {
+        if (input.isMapped()) {
+            uint64_t fileSize = input.size();
+            uint64_t start = std::min(offset, fileSize);
+            uint64_t end = start + std::min<uint64_t>(blockSize, fileSize - start);
+            uint64_t historyStart = (start > historySize) ? start - historySize : 0;
+
+            windowData = reinterpret_cast<const char*>(input.data()) + historyStart;
+            windowSize = static_cast<size_t>(end - historyStart);
+            blockStart = static_cast<size_t>(start - historyStart);
+            offset = end;
+
+            return end > start;
+        }
+
+        if (buffer.size() > historySize) {
+            buffer.erase(0, buffer.size() - historySize);
+        }
+
+        size_t history = buffer.size();
+        buffer.resize(history + blockSize);
+        size_t count = input.read(offset, &buffer[history], blockSize);
+        buffer.resize(history + count);
+        offset += count;
+
+        windowData = buffer.data();
+        windowSize = buffer.size();
+        blockStart = history;
+
+        return count > 0;
+    }
+
+    /**
+     * @brief Returns the history followed by the current block.
+     * @return The first byte of the window.
+     */
+    const char* data() const {
+        return windowData;
+    }
+
+    /**
+     * @brief Returns the size of the window.
+     * @return The history size plus the block size.
+     */
+    size_t size() const {
+        return windowSize;
+    }
+
+    /**
+     * @brief Returns where the current block starts in the window.
+     * @return The size of the history in front of the block.
+     */
+    size_t start() const {
+        return blockStart;
+    }
+
+    /**
+     * @brief Tells whether the current block is the last one.
+     * @return true if no input follows it.
+     */
+    bool atEnd() {
+        return input.atEnd(offset);
+    }
+};
+
+/**
+ * @brief A file opened for writing whose small writes are collected and written in large batches.
+ *
+ * On POSIX systems bytes go straight to write(2) once 1 MiB has accumulated, and writes larger than
+ * that bypass the batch buffer entirely; elsewhere a buffered stream is used. Space can be reserved
+ * up front when the final size is known, so the file system allocates it in one piece.
+ */
+class OutputFile {
+private:
+    static constexpr size_t BATCH_SIZE = 1 << 20;
+
+    std::string fileName;
+    int descriptor;
+    std::unique_ptr<std::ofstream> stream;
+    std::vector<char> batch;
+    CodecStats* stats;
+
+    /**
+     * @brief Writes bytes to the file, bypassing the batch buffer.
+     * @param data The bytes.
+     * @param size The number of bytes.
+     */
+    void writeThrough(const char* data, size_t size) {
+        CodecStats::Timer timer(stats, CodecStats::STAGE_WRITE);
+
+        if (stats) {
+            stats->addBytes(CodecStats::STAGE_WRITE, size, size);
+        }
+
+#ifdef FILEMANAGER_POSIX
+        if (descriptor >= 0) {
+            while (size > 0) {
+                ssize_t written = ::write(descriptor, data, size);
+
+                if (written < 0 && errno == EINTR) {
+                    continue;
+                }
+
+                if (written < 0) {
+                    throw std::runtime_error("Error: file cannot be written!");
+                }
+
+                data += written;
+                size -= static_cast<size_t>(written);
+            }
+            return;
+        }
+#endif
+        if (!stream->write(data, static_cast<std::streamsize>(size))) {
+            throw std::runtime_error("Error: file cannot be written!");
+        }
+    }
+
+public:
+    /**
+     * @brief Creates a file, replacing its contents.
+     * @param fileName The path of the file.
+     * @throws std::runtime_error if the file cannot be created.
+     */
+    explicit OutputFile(const std::string& fileName) : fileName(fileName), descriptor(-1), stats(nullptr) {
+#ifdef FILEMANAGER_POSIX
+        descriptor = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+        if (descriptor < 0) {
+            throw std::runtime_error("Error: file cannot be created: " + fileName);
+        }
+#else
+        stream.reset(new std::ofstream(openOutputFile(fileName)));
+#endif
+        batch.reserve(BATCH_SIZE);
+    }
+
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+
+    /**
+     * @brief Flushes what is left and closes the file; errors are only reported by close().
+     */
+    ~OutputFile() {
+        try {
+            close();
+        }
+        catch (const std::exception&) {
+        }
+    }
+
+    /**
+     * @brief Reserves disk space for a file whose final size is known.
+     * This is only a hint: the file keeps its size until written, and nothing happens where
+     * preallocation is not supported.
+     * @param size The expected size of the file in bytes.
+     */
+    void preallocate(uint64_t size) {
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+        if (descriptor >= 0 && size > 0) {
+            ::fallocate(descriptor, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size));
+        }
+#else
+        (void)size;
+#endif
+    }
+
+    /**
+     * @brief Collects the time and bytes of the following writes to the file.
+     * @param target The stats to add to, or nullptr to stop collecting.
+     */
+    void setStats(CodecStats* target) {
+        stats = target;
+    }
+
+    /**
+     * @brief Appends bytes to the file.
+     * @param data The bytes.
+     * @param size The number of bytes.
+     */
+    void write(const char* data, size_t size) {
+        if (batch.size() + size > BATCH_SIZE) {
+            flush();
+        }
+
+        if (size >= BATCH_SIZE) {
+            writeThrough(data, size);
+            return;
+        }
+
+        batch.insert(batch.end(), data, data + size);
+    }
+
+    /**
+     * @brief Appends bytes to the file.
+     * @param data The bytes.
+     */
+    void write(const std::vector<uint8_t>& data) {
+        write(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+
+    /**
+     * @brief Writes out the batched bytes.
+     */
+    void flush() {
+        if (!batch.empty()) {
+            writeThrough(batch.data(), batch.size());
+            batch.clear();
+        }
+    }
+
+    /**
+     * @brief Flushes and closes the file.
+     * @throws std::runtime_error if the last bytes cannot be written.
+     */
+    void close() {
+        if (descriptor < 0 && !stream) {
+            return;
+        }
+
+        flush();
+
+#ifdef FILEMANAGER_POSIX
+        if (descriptor >= 0) {
+            int result = ::close(descriptor);
+            descriptor = -1;
+
+            if (result != 0) {
+                throw std::runtime_error("Error: file cannot be written!");
+            }
+        }
+#endif
+        if (stream) {
+            stream->close();
+            bool failed = stream->fail();
+            stream.reset();
+
+            if (failed) {
+                throw std::runtime_error("Error: file cannot be written!");
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,59 @@
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include "archivereader.h"
+#include "filemanager.h"
+
+/**
+ * @brief The largest stream whose contents are decoded after the index loaded.
+ */
+static constexpr uint64_t OUTPUT_LIMIT = 1 << 20;
+
+/**
+ * @brief The file ArchiveReader reads the inputs from: one per process under the system's
+ * temporary directory, removed at exit.
+ */
+struct ScratchFile {
+    std::string path;
+
+    ScratchFile()
+        : path((std::filesystem::temp_directory_path() / ("fuzz_archiveindex_" + std::to_string(std::random_device()()))).string()) {}
+
+    ~ScratchFile() {
+        std::remove(path.c_str());
+    }
+};
+
+/**
+ * @brief Fuzz target for ArchiveReader::loadIndex.
+ * The input is opened as a compressed file, which loads its header, trailer and block index, and
+ * small streams are then decoded whole through the index.
+ * @param data The fuzzer input.
+ * @param size The number of bytes.
+ * @return 0.
+ */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    static const ScratchFile scratch;
+
+    {
+        std::ofstream file = openOutputFile(scratch.path);
+        file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+    }
+
+    try {
+        ArchiveReader reader(scratch.path);
+
+        if (reader.size() <= OUTPUT_LIMIT) {
+            reader.readRange(0, reader.size());
+        }
+    }
+    catch (const std::runtime_error&) {
+    }
+
+    return 0;
+}
@@ -0,0 +1,47 @@
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "blockcodec.h"
+#include "corpus.h"
+#include "dictionary.h"
+
+/**
+ * @brief The output buffer size; larger blocks are rejected before anything is decoded.
+ */
+static constexpr size_t OUTPUT_LIMIT = 1 << 20;
+
+/**
+ * @brief Fuzz target for BlockDecoder.
+ * The first byte is taken as the stream flags; the rest is decoded as the blocks of one chunk,
+ * with a small dictionary when the flags ask for one.
+ * @param data The fuzzer input.
+ * @param size The number of bytes.
+ * @return 0.
+ */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    static const Dictionary dictionary = Dictionary::train({ generateText(4096, 1), generateText(4096, 2) }, 2048);
+    static std::vector<char> output(OUTPUT_LIMIT);
+
+    if (size == 0) {
+        return 0;
+    }
+
+    uint8_t flags = data[0] & (BlockCodec::FLAG_INDEPENDENT_BLOCKS | BlockCodec::FLAG_BLOCK_INDEX | BlockCodec::FLAG_DICTIONARY | BlockCodec::FLAG_CHECKSUMS);
+
+    try {
+        BlockDecoder decoder;
+        decoder.setStreamFlags(flags);
+
+        if (flags & BlockCodec::FLAG_DICTIONARY) {
+            decoder.setDictionary(&dictionary);
+        }
+
+        decoder.decodeChunk(data + 1, size - 1, output.data(), output.size(), 0);
+    }
+    catch (const std::runtime_error&) {
+    }
+
+    return 0;
+}
@@ -0,0 +1,27 @@
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
+#include "dictionary.h"
+
+/**
+ * @brief Fuzz target for Dictionary::parse.
+ * The input must be rejected or parse to a dictionary that serializes back to the same bytes.
+ * @param data The fuzzer input.
+ * @param size The number of bytes.
+ * @return 0.
+ */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    try {
+        Dictionary dictionary = Dictionary::parse(data, size);
+
+        if (dictionary.serialize() != std::vector<uint8_t>(data, data + size)) {
+            std::abort();
+        }
+    }
+    catch (const std::runtime_error&) {
+    }
+
+    return 0;
+}
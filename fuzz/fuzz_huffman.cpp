@@ -0,0 +1,65 @@
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bitstream.h"
+#include "huffman.h"
+
+/**
+ * @brief Fuzz target for Huffman::readCodeLengths and the decoders.
+ * The input must survive a round trip through its own code and, read as a code length header
+ * followed by codes, must decode in one and in interleaved streams or be rejected.
+ * @param data The fuzzer input.
+ * @param size The number of bytes.
+ * @return 0.
+ */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    std::string input(reinterpret_cast<const char*>(data), size);
+
+    Huffman encoder;
+    encoder.build(input);
+
+    BitWriter writer;
+    encoder.writeCodeLengths(writer);
+    uint64_t headerBits = writer.bitsWritten();
+    encoder.encode(input, writer);
+    uint64_t bodyBits = writer.bitsWritten() - headerBits;
+    std::vector<uint8_t> encoded = writer.take();
+
+    BitReader encodedReader(encoded.data(), encoded.size());
+    Huffman decoder;
+    decoder.readCodeLengths(encodedReader);
+    if (decoder.decode(encodedReader, bodyBits) != input) {
+        std::abort();
+    }
+
+    try {
+        BitReader reader(data, size);
+        decoder.readCodeLengths(reader);
+
+        if (reader.isOverrun()) {
+            return 0;
+        }
+
+        size_t position = static_cast<size_t>((reader.bitsConsumed() + 7) / 8);
+        decoder.decode(reader, static_cast<uint64_t>(size) * 8 - reader.bitsConsumed());
+
+        // Every code is at least one bit long, so the streams hold at most this many symbols.
+        size_t quarter = (size - position) / Huffman::INTERLEAVED_STREAMS;
+        BitReader readers[Huffman::INTERLEAVED_STREAMS] = {
+            BitReader(data + position, quarter),
+            BitReader(data + position + quarter, quarter),
+            BitReader(data + position + 2 * quarter, quarter),
+            BitReader(data + position + 3 * quarter, size - position - 3 * quarter)
+        };
+
+        std::string output((size - position) * 8, '\0');
+        decoder.decodeInterleaved(readers, &output[0], output.size());
+    }
+    catch (const std::runtime_error&) {
+    }
+
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
+#include "deflate_dm.h"
+#include "rfc1951.h"
+
+/**
+ * @brief The output buffer size; streams that decode to more are rejected.
+ */
+static constexpr size_t OUTPUT_LIMIT = 1 << 20;
+
+/**
+ * @brief Fuzz target for Inflater.
+ * The input is inflated as raw DEFLATE data, which must decode or be rejected, and must survive a
+ * round trip through the DEFLATE encoder at the level its first byte picks.
+ * @param data The fuzzer input.
+ * @param size The number of bytes.
+ * @return 0.
+ */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    static std::vector<char> output(OUTPUT_LIMIT);
+
+    try {
+        Inflater inflater;
+        size_t decodedSize = 0;
+        inflater.inflate(data, size, output.data(), output.size(), decodedSize);
+    }
+    catch (const std::runtime_error&) {
+    }
+
+    if (size == 0) {
+        return 0;
+    }
+
+    DeflateOptions options;
+    options.format = DeflateFormat::Deflate;
+    options.level = 1 + data[0] % 11;
+
+    std::vector<uint8_t> compressed(DeflateDm::compressBound(size, options));
+    compressed.resize(DeflateDm::compress(data, size, compressed.data(), compressed.size(), options));
+
+    std::vector<uint8_t> decoded(size + 16);
+    decoded.resize(DeflateDm::decompress(compressed.data(), compressed.size(), decoded.data(), decoded.size(), DeflateFormat::Deflate));
+
+    if (decoded != std::vector<uint8_t>(data, data + size)) {
+        std::abort();
+    }
+
+    return 0;
+}
@@ -0,0 +1,43 @@
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "lz77.h"
+
+/**
+ * @brief The largest output the token decoder may write before it has to reject the tokens.
+ */
+static constexpr size_t OUTPUT_LIMIT = 1 << 20;
+
+/**
+ * @brief Fuzz target for the LZ77 tokenizer and the token decoder.
+ * The first byte picks a level; the rest must survive a round trip through lz77Compress and the
+ * token bytes at that level and, read as serialized tokens itself, must decode or be rejected.
+ * @param data The fuzzer input.
+ * @param size The number of bytes.
+ * @return 0.
+ */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+
+    int level = Lz77::MIN_LEVEL + data[0] % (Lz77::MAX_LEVEL - Lz77::MIN_LEVEL + 1);
+    std::string input(reinterpret_cast<const char*>(data + 1), size - 1);
+
+    Lz77 lz77(level);
+    if (Lz77::lz77DecompressFromBytes(Lz77::compressedToBytes(lz77.lz77Compress(input))) != input) {
+        std::abort();
+    }
+
+    static std::vector<char> output(OUTPUT_LIMIT);
+    try {
+        Lz77::lz77DecompressFromBytes(input, output.data(), output.size(), 0);
+    }
+    catch (const std::runtime_error&) {
+    }
+
+    return 0;
+}
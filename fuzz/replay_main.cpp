@@ -0,0 +1,59 @@
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+/**
+ * @brief Runs the fuzz target on one input file.
+ * @param path The path of the file.
+ */
+static void replayFile(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    LLVMFuzzerTestOneInput(data.data(), data.size());
+}
+
+/**
+ * @brief Entry point of a fuzz target built without libFuzzer.
+ * Each argument is an input file or a corpus directory, whose files are run in turn; without
+ * arguments the input is read from standard input, as AFL feeds it. Crashes found by a fuzzer can
+ * so be reproduced with any compiler.
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line argument strings.
+ * @return 0 once every input ran.
+ */
+int main(int argc, char* argv[]) {
+    size_t inputs = 0;
+
+    if (argc < 2) {
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+        return 0;
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        std::filesystem::path path = argv[i];
+
+        if (std::filesystem::is_directory(path)) {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(path)) {
+                if (entry.is_regular_file()) {
+                    replayFile(entry.path());
+                    ++inputs;
+                }
+            }
+        }
+        else {
+            replayFile(path);
+            ++inputs;
+        }
+    }
+
+    std::cout << "Ran " << inputs << " inputs.\n";
+    return 0;
+}
@@ -0,0 +1,844 @@
+#ifndef HUFFMAN_H
+#define HUFFMAN_H
+
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+
+#include "bitstream.h"
+#include "bytekernels.h"
+
+class Huffman {
+private:
+
+    /**
+     * @brief A tree node in the flat node pool. Children are pool indices; leaves have none.
+     */
+    struct Node {
+        uint32_t rate;
+        uint16_t character;
+        uint16_t left;
+        uint16_t right;
+        uint8_t depth;
+
+        bool isLeaf() const {
+            return left == NO_CHILD;
+        }
+    };
+
+    static constexpr uint16_t NO_CHILD = 0xFFFF;
+
+    struct DecodeEntry {
+        uint32_t value;
+        uint8_t bits;
+        uint8_t subBits;
+    };
+
+    static constexpr int ROOT_TABLE_BITS = 10;
+    static constexpr int SUB_TABLE_BITS = 6;
+
+    int symbolCount;
+    std::vector<uint64_t> codeBits;
+    std::vector<int> codeLengths;
+
+    std::vector<DecodeEntry> decodeTable;
+    int rootTableBits;
+    std::vector<uint16_t> sortedSymbols;
+    std::vector<int> headerLengths;
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> frequencyCounts;
+    int leafCount;
+    int nodeCount;
+
+    std::vector<uint64_t> mergeWeights;
+    std::vector<uint8_t> mergePackages;
+    uint64_t unlimitedBits;
+    uint64_t limitedBits;
+
+    /**
+     * @brief Creates one leaf per used symbol in the node pool, sorted by frequency.
+     * Ties are broken by symbol, so equal inputs always give the same tree.
+     * @param frequencies The frequency of every symbol; symbols with frequency 0 get no leaf.
+     */
+    void collectLeaves(const uint32_t* frequencies) {
+        leafCount = 0;
+
+        for (int symbol = 0; symbol < symbolCount; ++symbol) {
+            if (frequencies[symbol] > 0) {
+                nodes[leafCount++] = Node{ frequencies[symbol], static_cast<uint16_t>(symbol), NO_CHILD, NO_CHILD, 0 };
+            }
+        }
+
+        std::sort(nodes.begin(), nodes.begin() + leafCount, [](const Node& left, const Node& right) {
+            return left.rate != right.rate ? left.rate < right.rate : left.character < right.character;
+        });
+    }
+
+    /**
+     * @brief Builds the Huffman tree over the sorted leaves with the two-queue method.
+     * The leaves form one queue; internal nodes are created in nondecreasing order of frequency, so
+     * they form a second sorted queue right behind the leaves in the pool. Each step merges the two
+     * smallest heads, which makes the build O(n) and free of heap allocations.
+     * @return The depth of the deepest leaf, i.e. the longest code.
+     */
+    int buildTree() {
+        nodeCount = leafCount;
+
+        int nextLeaf = 0;
+        int nextInternal = leafCount;
+
+        auto takeSmallest = [&]() -> uint16_t {
+            if (nextLeaf < leafCount && (nextInternal >= nodeCount || nodes[nextLeaf].rate <= nodes[nextInternal].rate)) {
+                return static_cast<uint16_t>(nextLeaf++);
+            }
+            return static_cast<uint16_t>(nextInternal++);
+        };
+
+        for (int merges = leafCount - 1; merges > 0; --merges) {
+            uint16_t left = takeSmallest();
+            uint16_t right = takeSmallest();
+
+            nodes[nodeCount++] = Node{ nodes[left].rate + nodes[right].rate, 0, left, right, 0 };
+        }
+
+        // Parents always follow their children in the pool, so one backward pass assigns every depth.
+        int maxDepth = 0;
+        nodes[nodeCount - 1].depth = 0;
+
+        for (int node = nodeCount - 1; node >= 0; --node) {
+            if (!nodes[node].isLeaf()) {
+                nodes[nodes[node].left].depth = static_cast<uint8_t>(std::min(nodes[node].depth + 1, 255));
+                nodes[nodes[node].right].depth = static_cast<uint8_t>(std::min(nodes[node].depth + 1, 255));
+            }
+            else {
+                maxDepth = std::max(maxDepth, static_cast<int>(nodes[node].depth));
+            }
+        }
+
+        return maxDepth;
+    }
+
+    /**
+     * @brief Computes optimal code lengths of at most maxCodeLength bits with the package-merge algorithm.
+     * Level maxCodeLength holds the sorted leaves; every shallower level merges the leaves with the
+     * pairs ("packages") of the level below. The cheapest 2n - 2 items of the top level define the code:
+     * a leaf's length is the number of levels in which it is selected. Because leaves are sorted, each
+     * level selects a prefix of them, so only the item kinds need to be kept per level.
+     * @param maxCodeLength The longest code allowed.
+     * @throws std::runtime_error if more symbols are used than maxCodeLength bits can code.
+     */
+    void limitCodeLengths(int maxCodeLength) {
+        if (leafCount > (1 << maxCodeLength)) {
+            throw std::runtime_error("Too many symbols for the code length limit");
+        }
+
+        size_t listCapacity = 2 * static_cast<size_t>(leafCount);
+        mergeWeights.resize(2 * listCapacity);
+        mergePackages.resize(static_cast<size_t>(maxCodeLength) * listCapacity);
+
+        uint64_t* previous = mergeWeights.data();
+        uint64_t* current = mergeWeights.data() + listCapacity;
+        size_t previousSize = static_cast<size_t>(leafCount);
+
+        for (int leaf = 0; leaf < leafCount; ++leaf) {
+            previous[leaf] = nodes[leaf].rate;
+            mergePackages[static_cast<size_t>(maxCodeLength - 1) * listCapacity + leaf] = 0;
+        }
+
+        for (int level = maxCodeLength - 2; level >= 0; --level) {
+            uint8_t* packages = mergePackages.data() + static_cast<size_t>(level) * listCapacity;
+            size_t packageCount = previousSize / 2;
+            size_t nextLeaf = 0;
+            size_t nextPackage = 0;
+            size_t size = 0;
+
+            while (nextLeaf < static_cast<size_t>(leafCount) || nextPackage < packageCount) {
+                uint64_t packageWeight = (nextPackage < packageCount) ? previous[2 * nextPackage] + previous[2 * nextPackage + 1] : 0;
+
+                if (nextPackage >= packageCount || (nextLeaf < static_cast<size_t>(leafCount) && nodes[nextLeaf].rate <= packageWeight)) {
+                    current[size] = nodes[nextLeaf++].rate;
+                    packages[size++] = 0;
+                }
+                else {
+                    current[size] = packageWeight;
+                    packages[size++] = 1;
+                    nextPackage++;
+                }
+            }
+
+            std::swap(previous, current);
+            previousSize = size;
+        }
+
+        for (int leaf = 0; leaf < leafCount; ++leaf) {
+            nodes[leaf].depth = 0;
+        }
+
+        size_t selected = 2 * static_cast<size_t>(leafCount) - 2;
+
+        for (int level = 0; level < maxCodeLength && selected > 0; ++level) {
+            const uint8_t* packages = mergePackages.data() + static_cast<size_t>(level) * listCapacity;
+            size_t leavesSelected = 0;
+
+            for (size_t item = 0; item < selected; ++item) {
+                leavesSelected += packages[item] ? 0 : 1;
+            }
+
+            for (size_t leaf = 0; leaf < leavesSelected; ++leaf) {
+                nodes[leaf].depth++;
+            }
+
+            selected = 2 * (selected - leavesSelected);
+        }
+    }
+
+    /**
+     * @brief Returns the number of bits the leaves cost with their current depths as code lengths.
+     * @return The sum of frequency times code length.
+     */
+    uint64_t codedLeafBits() const {
+        uint64_t bits = 0;
+
+        for (int leaf = 0; leaf < leafCount; ++leaf) {
+            bits += static_cast<uint64_t>(nodes[leaf].rate) * std::max<int>(nodes[leaf].depth, 1);
+        }
+
+        return bits;
+    }
+
+    /**
+     * @brief Records the code length of every leaf: its depth in the tree, or its limited length after package-merge.
+     */
+    void fillCodeLengths() {
+        std::fill(codeLengths.begin(), codeLengths.end(), 0);
+
+        for (int leaf = 0; leaf < leafCount; ++leaf) {
+            codeLengths[nodes[leaf].character] = (nodes[leaf].depth > 0) ? nodes[leaf].depth : 1;
+        }
+    }
+
+    /**
+     * @brief Computes the code lengths for given symbol frequencies, limited to maxCodeLength.
+     * @param frequencies The frequency of every symbol of the alphabet; missing entries count as 0.
+     * @param maxCodeLength The longest code allowed, between 1 and MAX_CODE_LENGTH.
+     */
+    void computeCodeLengths(const std::vector<uint32_t>& frequencies, int maxCodeLength) {
+        if (maxCodeLength < 1 || maxCodeLength > MAX_CODE_LENGTH) {
+            throw std::invalid_argument("Code length limit must be between 1 and " + std::to_string(MAX_CODE_LENGTH));
+        }
+
+        if (static_cast<int>(frequencies.size()) < symbolCount) {
+            std::fill(std::copy(frequencies.begin(), frequencies.end(), frequencyCounts.begin()), frequencyCounts.end(), 0);
+            collectLeaves(frequencyCounts.data());
+        }
+        else {
+            collectLeaves(frequencies.data());
+        }
+
+        unlimitedBits = 0;
+        limitedBits = 0;
+
+        if (leafCount == 0) {
+            nodeCount = 0;
+            std::fill(codeLengths.begin(), codeLengths.end(), 0);
+            return;
+        }
+
+        int depth = buildTree();
+        unlimitedBits = codedLeafBits();
+
+        if (depth > maxCodeLength) {
+            limitCodeLengths(maxCodeLength);
+        }
+
+        limitedBits = codedLeafBits();
+        fillCodeLengths();
+    }
+
+    /**
+     * @brief Reverses the order of the low bits of a code.
+     * @param code The code to reverse.
+     * @param length The number of bits in the code.
+     * @return The reversed code.
+     */
+    static uint64_t reverseBits(uint64_t code, int length) {
+        uint64_t reversed = 0;
+
+        for (int i = 0; i < length; ++i) {
+            reversed = (reversed << 1) | (code & 1);
+            code >>= 1;
+        }
+
+        return reversed;
+    }
+
+    /**
+     * @brief Assigns canonical codes from the code lengths as in RFC 1951, section 3.2.2.
+     * Shorter codes come first and codes of equal length follow symbol order, so the lengths alone
+     * are enough to rebuild them. Codes are stored bit-reversed for the LSB-first bit stream.
+     */
+    void assignCanonicalCodes() {
+        int maxLength = 0;
+        for (int symbol = 0; symbol < symbolCount; ++symbol) {
+            maxLength = std::max(maxLength, codeLengths[symbol]);
+        }
+
+        uint64_t lengthCount[MAX_CODE_LENGTH + 1] = {};
+        for (int symbol = 0; symbol < symbolCount; ++symbol) {
+            if (codeLengths[symbol] > 0) {
+                lengthCount[codeLengths[symbol]]++;
+            }
+        }
+
+        uint64_t nextCode[MAX_CODE_LENGTH + 1] = {};
+        uint64_t code = 0;
+        for (int length = 1; length <= maxLength; ++length) {
+            code = (code + lengthCount[length - 1]) << 1;
+            nextCode[length] = code;
+        }
+
+        for (int symbol = 0; symbol < symbolCount; ++symbol) {
+            int length = codeLengths[symbol];
+            codeBits[symbol] = (length > 0) ? reverseBits(nextCode[length]++, length) : 0;
+        }
+    }
+
+    /**
+     * @brief Lists the symbols that have a code in canonical order, by code length and then by symbol.
+     * In this order the codes are increasing, so codes that share a prefix are adjacent.
+     * @return The number of symbols written to sortedSymbols.
+     */
+    int sortSymbolsByCode() {
+        int offsets[MAX_CODE_LENGTH + 2] = {};
+        for (int symbol = 0; symbol < symbolCount; ++symbol) {
+            offsets[codeLengths[symbol] + 1]++;
+        }
+
+        // offsets[length] becomes the position of the first code of that length; length 0 is skipped.
+        offsets[1] = 0;
+        for (int length = 1; length <= MAX_CODE_LENGTH; ++length) {
+            offsets[length + 1] += offsets[length];
+        }
+
+        for (int symbol = 0; symbol < symbolCount; ++symbol) {
+            if (codeLengths[symbol] > 0) {
+                sortedSymbols[offsets[codeLengths[symbol]]++] = static_cast<uint16_t>(symbol);
+            }
+        }
+
+        return offsets[MAX_CODE_LENGTH];
+    }
+
+    /**
+     * @brief Fills one level of the decode table and, recursively, the subtables below it.
+     * Each entry is indexed by the next `tableBits` stream bits. Codes that fit resolve to a symbol;
+     * longer codes sharing a prefix get an entry that links to a subtable for their remaining bits.
+     * Those codes form a run of sortedSymbols, so subtables are filled from ranges of it.
+     * @param first The first position in sortedSymbols of the codes that pass through this table.
+     * @param last The position after the last of them.
+     * @param consumed The number of code bits already resolved by the tables above.
+     * @param tableBits Receives the index width of the new table.
+     * @return The position of the new table in decodeTable.
+     */
+    uint32_t fillDecodeTable(int first, int last, int consumed, int& tableBits) {
+        // The longest code comes last in canonical order.
+        int maxLength = codeLengths[sortedSymbols[last - 1]] - consumed;
+
+        tableBits = std::min(maxLength, consumed == 0 ? ROOT_TABLE_BITS : SUB_TABLE_BITS);
+        uint32_t tableSize = uint32_t(1) << tableBits;
+        uint32_t tableStart = static_cast<uint32_t>(decodeTable.size());
+        decodeTable.resize(tableStart + tableSize, DecodeEntry{0, 0, 0});
+
+        int position = first;
+
+        while (position < last) {
+            int symbol = sortedSymbols[position];
+            int remaining = codeLengths[symbol] - consumed;
+            uint32_t code = static_cast<uint32_t>(codeBits[symbol] >> consumed);
+
+            if (remaining <= tableBits) {
+                for (uint32_t index = code & ((uint32_t(1) << remaining) - 1); index < tableSize; index += uint32_t(1) << remaining) {
+                    decodeTable[tableStart + index] = DecodeEntry{static_cast<uint32_t>(symbol), static_cast<uint8_t>(remaining), 0};
+                }
+
+                ++position;
+                continue;
+            }
+
+            uint32_t index = code & (tableSize - 1);
+            int groupEnd = position + 1;
+
+            while (groupEnd < last && static_cast<uint32_t>(codeBits[sortedSymbols[groupEnd]] >> consumed & (tableSize - 1)) == index) {
+                ++groupEnd;
+            }
+
+            int subBits = 0;
+            uint32_t subStart = fillDecodeTable(position, groupEnd, consumed + tableBits, subBits);
+            decodeTable[tableStart + index] = DecodeEntry{subStart, static_cast<uint8_t>(tableBits), static_cast<uint8_t>(subBits)};
+            position = groupEnd;
+        }
+
+        return tableStart;
+    }
+
+    /**
+     * @brief Drops the decode tables, so decoding fails until they are built again.
+     * A single zero-length entry makes decodeSymbol() reject any bits rather than index an empty table.
+     */
+    void clearDecodeTable() {
+        decodeTable.assign(1, DecodeEntry{0, 0, 0});
+        rootTableBits = 0;
+    }
+
+    /**
+     * @brief Builds the table-driven decoder from the current code lengths and canonical codes.
+     * The tables and the sorted symbol list keep their capacity, so rebuilding them allocates nothing.
+     */
+    void buildDecodeTable() {
+        int count = sortSymbolsByCode();
+
+        if (count == 0) {
+            clearDecodeTable();
+            return;
+        }
+
+        decodeTable.clear();
+        fillDecodeTable(0, count, 0, rootTableBits);
+    }
+
+public:
+    static constexpr int MAX_CODE_LENGTH = 15;
+    static constexpr int INTERLEAVED_STREAMS = 4;
+
+    /**
+     * @brief Constructor sizes the node pool and the tables for the alphabet once.
+     * @param symbolCount The size of the alphabet; 256 for bytes.
+     */
+    explicit Huffman(int symbolCount = 256)
+        : symbolCount(symbolCount), codeBits(symbolCount, 0), codeLengths(symbolCount, 0), decodeTable(1, DecodeEntry{0, 0, 0}), rootTableBits(0), sortedSymbols(symbolCount, 0),
+        headerLengths(symbolCount, 0), nodes(2 * symbolCount), frequencyCounts(symbolCount, 0), leafCount(0), nodeCount(0), unlimitedBits(0), limitedBits(0) {}
+
+    Huffman(const Huffman&) = delete;
+    Huffman& operator=(const Huffman&) = delete;
+
+    /**
+     * @brief Builds the Huffman tree and generates codes for encoding.
+     * The decode tables are not built; a decoder gets them from readCodeLengths() or buildFromLengths().
+     * @param data The input string to be processed.
+     * @param maxCodeLength The longest code allowed, between 1 and MAX_CODE_LENGTH.
+     */
+    void build(const std::string& data, int maxCodeLength = MAX_CODE_LENGTH) {
+        std::fill(frequencyCounts.begin(), frequencyCounts.end(), 0);
+        ByteKernels::histogram(reinterpret_cast<const uint8_t*>(data.data()), data.size(), frequencyCounts.data());
+
+        buildFromFrequencies(frequencyCounts, maxCodeLength);
+    }
+
+    /**
+     * @brief Builds the Huffman tree for given symbol frequencies and generates codes for encoding.
+     * If the tree is deeper than maxCodeLength, the code lengths are replaced by the optimal
+     * length-limited ones from package-merge; getLengthLimitCost() reports what that costs.
+     * Only the encoder side is prepared: the decode tables are cleared rather than built.
+     * @param frequencies The frequency of every symbol of the alphabet; missing entries count as 0.
+     * @param maxCodeLength The longest code allowed, between 1 and MAX_CODE_LENGTH.
+     */
+    void buildFromFrequencies(const std::vector<uint32_t>& frequencies, int maxCodeLength = MAX_CODE_LENGTH) {
+        computeCodeLengths(frequencies, maxCodeLength);
+        assignCanonicalCodes();
+        clearDecodeTable();
+    }
+
+    /**
+     * @brief Returns the size of symbols with given frequencies, coded with a code of their own.
+     * Only the code lengths are computed, not the codes or the decode tables, and the header is
+     * counted without being written out, so this allocates nothing and is cheap enough to call many
+     * times while deciding where blocks end. The lengths replace the current ones, so the code must
+     * be built again before it codes anything.
+     * @param frequencies The frequency of every symbol of the alphabet; missing entries count as 0.
+     * @param maxCodeLength The longest code allowed, between 1 and MAX_CODE_LENGTH.
+     * @return The code-length header as writeCodeLengths() writes it plus the coded symbols, in bits.
+     */
+    uint64_t estimateCodedBits(const std::vector<uint32_t>& frequencies, int maxCodeLength = MAX_CODE_LENGTH) {
+        computeCodeLengths(frequencies, maxCodeLength);
+
+        uint64_t headerBits = 0;
+        forEachCodeLengthSymbol(codeLengths.data(), symbolCount, [&](int symbol, int) {
+            headerBits += 5 + codeLengthExtraBits(symbol);
+        });
+
+        return headerBits + limitedBits;
+    }
+
+    /**
+     * @brief Reports how much the code length limit cost in the last build from frequencies.
+     * @param unlimited Receives the coded size in bits with unlimited Huffman code lengths.
+     * @param limited Receives the coded size in bits with the codes actually used.
+     */
+    void getLengthLimitCost(uint64_t& unlimited, uint64_t& limited) const {
+        unlimited = unlimitedBits;
+        limited = limitedBits;
+    }
+
+    /**
+     * @brief Prepares encoding and decoding from known code lengths, without building a tree.
+     * @param lengths The code length of every symbol; 0 marks unused symbols.
+     * @throws std::runtime_error if the lengths do not form a valid prefix code.
+     */
+    void buildFromLengths(const std::vector<int>& lengths) {
+        if (static_cast<int>(lengths.size()) > symbolCount) {
+            throw std::runtime_error("Invalid code lengths: too many lengths");
+        }
+
+        uint64_t kraftSum = 0;
+        for (int length : lengths) {
+            if (length < 0 || length > MAX_CODE_LENGTH) {
+                throw std::runtime_error("Invalid code lengths: code too long");
+            }
+
+            if (length > 0) {
+                kraftSum += uint64_t(1) << (MAX_CODE_LENGTH - length);
+            }
+        }
+
+        if (kraftSum > (uint64_t(1) << MAX_CODE_LENGTH)) {
+            throw std::runtime_error("Invalid code lengths: over-subscribed code");
+        }
+
+        std::fill(codeLengths.begin(), codeLengths.end(), 0);
+        std::copy(lengths.begin(), lengths.end(), codeLengths.begin());
+
+        nodeCount = 0;
+        assignCanonicalCodes();
+        buildDecodeTable();
+    }
+
+    /**
+     * @brief Returns the code lengths of all symbols.
+     * @return One length per symbol; 0 for symbols without a code.
+     */
+    const std::vector<int>& getCodeLengths() const {
+        return codeLengths;
+    }
+
+    /**
+     * @brief Writes the code of one symbol.
+     * @param writer The bit stream that receives the code.
+     * @param symbol The symbol; it must have a code.
+     */
+    void encodeSymbol(BitWriter& writer, int symbol) const {
+        writer.writeBits(codeBits[symbol], codeLengths[symbol]);
+    }
+
+    /**
+     * @brief Reads one symbol through the decode tables.
+     * Each probe of the root table resolves up to ROOT_TABLE_BITS bits at once; longer codes
+     * continue through their subtables.
+     * @param reader The bit stream positioned at a code.
+     * @return The decoded symbol.
+     * @throws std::runtime_error if the bits are not a valid code.
+     */
+    int decodeSymbol(BitReader& reader) const {
+        const DecodeEntry* entry = &decodeTable[reader.peekBits(rootTableBits)];
+
+        while (entry->subBits) {
+            reader.consumeBits(entry->bits);
+            entry = &decodeTable[entry->value + reader.peekBits(entry->subBits)];
+        }
+
+        if (entry->bits == 0) {
+            throw std::runtime_error("Invalid Huffman code");
+        }
+
+        reader.consumeBits(entry->bits);
+        return static_cast<int>(entry->value);
+    }
+
+    /**
+     * @brief Run-length codes a list of code lengths with the RFC 1951 code-length alphabet.
+     * Symbols 0-15 are literal lengths, 16 repeats the previous length 3-6 times,
+     * 17 codes 3-10 zeros and 18 codes 11-138 zeros.
+     * @param lengths The code lengths to encode.
+     * @param count The number of lengths.
+     * @param visit Called with every code-length symbol and the value of its extra bits, in order.
+     */
+    template <typename Visit>
+    static void forEachCodeLengthSymbol(const int* lengths, int count, Visit&& visit) {
+        int index = 0;
+
+        while (index < count) {
+            int length = lengths[index];
+            int run = 1;
+            while (index + run < count && lengths[index + run] == length) {
+                run++;
+            }
+            index += run;
+
+            if (length == 0) {
+                while (run >= 11) {
+                    int repeat = std::min(run, 138);
+                    visit(18, repeat - 11);
+                    run -= repeat;
+                }
+
+                if (run >= 3) {
+                    visit(17, run - 3);
+                    run = 0;
+                }
+            }
+            else {
+                visit(length, 0);
+                run--;
+
+                while (run >= 3) {
+                    int repeat = std::min(run, 6);
+                    visit(16, repeat - 3);
+                    run -= repeat;
+                }
+            }
+
+            for (; run > 0; --run) {
+                visit(length, 0);
+            }
+        }
+    }
+
+    /**
+     * @brief Run-length codes a list of code lengths, as forEachCodeLengthSymbol() does, into a list.
+     * @param lengths The code lengths to encode.
+     * @param count The number of lengths.
+     * @return Pairs of code-length symbol and the value of its extra bits.
+     */
+    static std::vector<std::pair<int, int>> runLengthCodeLengths(const int* lengths, int count) {
+        std::vector<std::pair<int, int>> symbols;
+        forEachCodeLengthSymbol(lengths, count, [&](int symbol, int extra) {
+            symbols.emplace_back(symbol, extra);
+        });
+
+        return symbols;
+    }
+
+    /**
+     * @brief Returns the number of extra bits that follow a code-length symbol.
+     * @param symbol The code-length symbol.
+     * @return 2, 3 or 7 for the repeat symbols, 0 otherwise.
+     */
+    static int codeLengthExtraBits(int symbol) {
+        return (symbol == 16) ? 2 : (symbol == 17) ? 3 : (symbol == 18) ? 7 : 0;
+    }
+
+    /**
+     * @brief Encodes a given string using Huffman encoding.
+     * @param data The string to encode.
+     * @param writer The bit stream that receives the packed codes.
+     */
+    void encode(const std::string& data, BitWriter& writer) const {
+        for (char ch : data) {
+            encodeSymbol(writer, static_cast<unsigned char>(ch));
+        }
+    }
+
+    /**
+     * @brief Decodes a Huffman-encoded bit stream into a buffer the caller reuses between blocks.
+     * @param reader The bit stream positioned at the first code.
+     * @param bitLength The number of valid bits; padding after them is ignored.
+     * @param output Receives the decoded symbols; earlier contents are dropped but its capacity is kept.
+     */
+    void decode(BitReader& reader, uint64_t bitLength, std::string& output) const {
+        output.clear();
+        uint64_t endPos = reader.bitsConsumed() + bitLength;
+
+        if (rootTableBits == 0) {
+            if (bitLength > 0) {
+                throw std::runtime_error("Huffman data present without a tree");
+            }
+            return;
+        }
+
+        while (reader.bitsConsumed() < endPos) {
+            output.push_back(static_cast<char>(decodeSymbol(reader)));
+        }
+
+        if (reader.isOverrun()) {
+            throw std::runtime_error("Unexpected end of Huffman data");
+        }
+    }
+
+    /**
+     * @brief Decodes a Huffman-encoded bit stream.
+     * @param reader The bit stream positioned at the first code.
+     * @param bitLength The number of valid bits; padding after them is ignored.
+     * @return The original decoded string.
+     */
+    std::string decode(BitReader& reader, uint64_t bitLength) const {
+        std::string decodedData;
+        decode(reader, bitLength, decodedData);
+        return decodedData;
+    }
+
+    /**
+     * @brief Returns how many symbols each interleaved stream holds; the last one holds the rest.
+     * @param count The number of symbols in all streams together.
+     * @return The number of symbols of each of the first INTERLEAVED_STREAMS - 1 streams.
+     */
+    static size_t interleavedSegmentSize(size_t count) {
+        return (count + INTERLEAVED_STREAMS - 1) / INTERLEAVED_STREAMS;
+    }
+
+    /**
+     * @brief Encodes a string as independent bit streams, one per consecutive segment of it.
+     * Splitting the symbols into segments whose codes do not depend on each other lets
+     * decodeInterleaved() work on all of them at once.
+     * @param data The string to encode.
+     * @param writers INTERLEAVED_STREAMS bit streams; the i-th receives the codes of the i-th segment.
+     */
+    void encodeInterleaved(const std::string& data, BitWriter* writers) const {
+        size_t segment = interleavedSegmentSize(data.size());
+
+        for (int stream = 0; stream < INTERLEAVED_STREAMS; ++stream) {
+            size_t first = std::min(data.size(), stream * segment);
+            size_t last = (stream == INTERLEAVED_STREAMS - 1) ? data.size() : std::min(data.size(), first + segment);
+
+            for (size_t position = first; position < last; ++position) {
+                encodeSymbol(writers[stream], static_cast<unsigned char>(data[position]));
+            }
+        }
+    }
+
+    /**
+     * @brief Decodes bit streams written by encodeInterleaved().
+     * One loop takes a symbol from every stream in turn. The streams share no state, so the table
+     * lookups and bit shifts of the four symbols overlap in the pipeline instead of waiting on one
+     * another as they do in decode().
+     * @param readers INTERLEAVED_STREAMS bit streams positioned at their first code.
+     * @param output Receives count decoded symbols.
+     * @param count The number of symbols in all streams together.
+     * @throws std::runtime_error if a stream holds an invalid code or ends early.
+     */
+    void decodeInterleaved(BitReader* readers, char* output, size_t count) const {
+        static_assert(INTERLEAVED_STREAMS == 4, "The decode loop is unrolled for four streams");
+
+        if (count == 0) {
+            return;
+        }
+
+        if (rootTableBits == 0) {
+            throw std::runtime_error("Huffman data present without a tree");
+        }
+
+        size_t segment = interleavedSegmentSize(count);
+        char* output0 = output;
+        char* output1 = output + std::min(count, segment);
+        char* output2 = output + std::min(count, 2 * segment);
+        char* output3 = output + std::min(count, 3 * segment);
+        size_t lengths[INTERLEAVED_STREAMS] = {
+            static_cast<size_t>(output1 - output0),
+            static_cast<size_t>(output2 - output1),
+            static_cast<size_t>(output3 - output2),
+            static_cast<size_t>(output + count - output3)
+        };
+
+        // Local copies keep the reader state in registers; stores through char pointers could alias it otherwise.
+        BitReader reader0 = readers[0];
+        BitReader reader1 = readers[1];
+        BitReader reader2 = readers[2];
+        BitReader reader3 = readers[3];
+
+        size_t common = lengths[3];
+        for (size_t position = 0; position < common; ++position) {
+            output0[position] = static_cast<char>(decodeSymbol(reader0));
+            output1[position] = static_cast<char>(decodeSymbol(reader1));
+            output2[position] = static_cast<char>(decodeSymbol(reader2));
+            output3[position] = static_cast<char>(decodeSymbol(reader3));
+        }
+
+        for (size_t position = common; position < lengths[0]; ++position) {
+            output0[position] = static_cast<char>(decodeSymbol(reader0));
+        }
+        for (size_t position = common; position < lengths[1]; ++position) {
+            output1[position] = static_cast<char>(decodeSymbol(reader1));
+        }
+        for (size_t position = common; position < lengths[2]; ++position) {
+            output2[position] = static_cast<char>(decodeSymbol(reader2));
+        }
+
+        readers[0] = reader0;
+        readers[1] = reader1;
+        readers[2] = reader2;
+        readers[3] = reader3;
+
+        if (reader0.isOverrun() || reader1.isOverrun() || reader2.isOverrun() || reader3.isOverrun()) {
+            throw std::runtime_error("Unexpected end of Huffman data");
+        }
+    }
+
+    /**
+     * @brief Writes the code length of every symbol, run-length coded with the RFC 1951 code-length alphabet.
+     * Each code-length symbol takes 5 bits, followed by its extra bits. The codes themselves are not stored;
+     * they are rebuilt canonically from the lengths.
+     * @param writer The bit stream that receives the header.
+     */
+    void writeCodeLengths(BitWriter& writer) const {
+        forEachCodeLengthSymbol(codeLengths.data(), symbolCount, [&](int symbol, int extra) {
+            writer.writeBits(symbol, 5);
+            writer.writeBits(extra, codeLengthExtraBits(symbol));
+        });
+    }
+
+    /**
+     * @brief Reads a header written by writeCodeLengths and prepares the table-driven decoder.
+     * No tree is rebuilt; the decode tables come straight from the lengths.
+     * @param reader The bit stream positioned at the header.
+     */
+    void readCodeLengths(BitReader& reader) {
+        // Every length is written before the loop ends, so the buffer needs no clearing between headers.
+        std::vector<int>& lengths = headerLengths;
+        int count = 0;
+
+        while (count < symbolCount) {
+            int symbol = static_cast<int>(reader.readBits(5));
+            int extra = static_cast<int>(reader.readBits(codeLengthExtraBits(symbol)));
+
+            if (symbol <= MAX_CODE_LENGTH) {
+                lengths[count++] = symbol;
+                continue;
+            }
+
+            int length = 0;
+            int repeat = 0;
+
+            if (symbol == 16) {
+                if (count == 0) {
+                    throw std::runtime_error("Invalid code lengths: repeat without a previous length");
+                }
+                length = lengths[count - 1];
+                repeat = 3 + extra;
+            }
+            else if (symbol == 17) {
+                repeat = 3 + extra;
+            }
+            else if (symbol == 18) {
+                repeat = 11 + extra;
+            }
+            else {
+                throw std::runtime_error("Invalid code lengths: unknown symbol");
+            }
+
+            if (count + repeat > symbolCount) {
+                throw std::runtime_error("Invalid code lengths: too many lengths");
+            }
+
+            std::fill(lengths.begin() + count, lengths.begin() + count + repeat, length);
+            count += repeat;
+        }
+
+        if (reader.isOverrun()) {
+            throw std::runtime_error("Unexpected end of Huffman header");
+        }
+
+        buildFromLengths(lengths);
+    }
+};
+
+#endif
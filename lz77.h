@@ -0,0 +1,830 @@
+#ifndef LZ77_H
+#define LZ77_H
+
+#include "vector"
+#include "iostream"
+#include "string"
+#include "stdexcept"
+#include "algorithm"
+#include "cstring"
+#include "cmath"
+#include "cstdint"
+
+#include "bytekernels.h"
+
+class Lz77 {
+private:
+	static constexpr int WINDOW_SIZE = 32768;
+    static constexpr int WINDOW_MASK = WINDOW_SIZE - 1;
+    static constexpr int HASH_BITS = 15;
+    static constexpr int HASH_SIZE = 1 << HASH_BITS;
+    static constexpr int HASH_MASK = HASH_SIZE - 1;
+    static constexpr int HASH_SHIFT = 5;
+    static constexpr int NO_POSITION = -1;
+
+    /**
+     * Match finder limits of one compression level, in the spirit of zlib's configuration table.
+     */
+    struct LevelSettings {
+        int maxChainDepth;     ///< Earlier positions with the same hash tried per search.
+        int goodLength;        ///< After a match this long, the lazy search only walks a quarter of the chain.
+        int niceLength;        ///< A match this long ends the search early.
+        int maxLazyLength;     ///< Lazy mode: no lazy search after a match this long. Greedy mode: longer matches are not inserted into the hash chains.
+        bool lazy;             ///< Whether to look one byte ahead for a longer match before taking one.
+        int optimalPasses;     ///< Optimal parsing: how many times prices are re-estimated and the block parsed again; 0 for none.
+    };
+
+    /**
+     * A match found by the binary-tree match finder.
+     */
+    struct TreeMatch {
+        uint16_t length;
+        uint16_t offset;
+    };
+
+    static constexpr uint64_t NO_PRICE = UINT64_MAX;
+
+    LevelSettings settings;
+
+    std::vector<int> hashHead;
+    std::vector<int> hashPrev;
+    bool hashHeadCleared;
+
+    std::vector<int> treeHead;
+    std::vector<int> treeChildren;
+    std::vector<TreeMatch> treeMatches;
+    std::vector<uint32_t> treeMatchStart;
+
+    std::vector<uint64_t> parseCost;
+    std::vector<uint16_t> parseLength;
+    std::vector<uint16_t> parseOffset;
+
+    ByteKernels::MatchLengthFunction matchLength;
+
+    /**
+     * Returns the match finder limits of a compression level.
+     * @param level A level between MIN_LEVEL and MAX_LEVEL.
+     * @return The limits of that level.
+     */
+    static LevelSettings levelSettings(int level) {
+        static constexpr LevelSettings LEVELS[MAX_LEVEL + 1] = {
+            { 0, 0, 0, 0, false, 0 },
+            { 4, 4, 8, 4, false, 0 },
+            { 8, 4, 16, 5, false, 0 },
+            { 32, 4, 32, 6, false, 0 },
+            { 16, 4, 16, 4, true, 0 },
+            { 32, 8, 32, 16, true, 0 },
+            { 128, 8, 128, 16, true, 0 },
+            { 256, 8, 128, 32, true, 0 },
+            { 1024, 32, 258, 128, true, 0 },
+            { 4096, 32, 258, 258, true, 0 },
+            { 64, 32, 128, 258, true, 1 },
+            { 256, 32, 258, 258, true, 2 },
+        };
+
+        if (level < MIN_LEVEL || level > MAX_LEVEL) {
+            throw std::invalid_argument("Compression level must be between 1 and 11");
+        }
+
+        return LEVELS[level];
+    }
+
+    /**
+     * Starts the rolling hash at a position, as if the bytes before it had never been seen.
+     * @param data The input being compressed.
+     * @param position The position whose 3-byte prefix will be inserted next; position + 2 must be inside data.
+     * @param hash Receives the hash of the two bytes at position.
+     */
+    static void resetHash(const char* data, int position, int& hash) {
+        hash = ((static_cast<unsigned char>(data[position]) << HASH_SHIFT) ^ static_cast<unsigned char>(data[position + 1])) & HASH_MASK;
+    }
+
+    /**
+     * Empties the hash chains after a call, if the input was small enough that clearing the slots it
+     * may have used is cheaper than refilling the whole table at the start of the next call.
+     * @param data The input just compressed.
+     * @param dataSize The size of the input.
+     */
+    void clearHashHeads(const char* data, int dataSize) {
+        hashHeadCleared = (dataSize <= HASH_SIZE / 8);
+
+        if (!hashHeadCleared || dataSize < MIN_MATCH_LENGTH) {
+            return;
+        }
+
+        int hash = 0;
+        resetHash(data, 0, hash);
+
+        for (int position = 0; position + MIN_MATCH_LENGTH <= dataSize; ++position) {
+            hash = ((hash << HASH_SHIFT) ^ static_cast<unsigned char>(data[position + MIN_MATCH_LENGTH - 1])) & HASH_MASK;
+            hashHead[hash] = NO_POSITION;
+        }
+    }
+
+    /**
+     * Rolls the 3-byte hash forward by one position and links the position into its hash chain.
+     * @param data The input being compressed.
+     * @param position The position whose 3-byte prefix is inserted; position + 2 must be inside data.
+     * @param hash The rolling hash of the two bytes at position, updated in place.
+     * @return The previous head of the chain, i.e. the most recent earlier position with the same hash.
+     */
+    int insertPosition(const char* data, int position, int& hash) {
+        hash = ((hash << HASH_SHIFT) ^ static_cast<unsigned char>(data[position + MIN_MATCH_LENGTH - 1])) & HASH_MASK;
+
+        int chainHead = hashHead[hash];
+        hashPrev[position & WINDOW_MASK] = chainHead;
+        hashHead[hash] = position;
+
+        return chainHead;
+    }
+
+    /**
+     * Walks the hash chain starting at chainHead and finds the longest match for position.
+     * The match never covers the last byte of data, so every token keeps a real nextChar.
+     * @param data The input being compressed.
+     * @param dataSize The size of the input.
+     * @param position The position to find a match for.
+     * @param chainHead The most recent earlier position with the same hash.
+     * @param chainLength How many chain entries to try at most.
+     * @param bestOffset Receives the distance back to the best match.
+     * @return The length of the best match, or 0 if none was found.
+     */
+    int findLongestMatch(const char* data, int dataSize, int position, int chainHead, int chainLength, int& bestOffset) const {
+        int maxLength = dataSize - position - 1;
+        if (maxLength > MAX_MATCH_LENGTH) {
+            maxLength = MAX_MATCH_LENGTH;
+        }
+
+        int bestLength = 0;
+        int windowLimit = position - WINDOW_SIZE;
+        const char* current = data + position;
+
+        for (int candidate = chainHead; candidate > windowLimit && candidate != NO_POSITION && chainLength > 0; --chainLength) {
+            const char* match = data + candidate;
+
+            if (match[bestLength] == current[bestLength] && match[0] == current[0]) {
+                int length = matchLength(match, current, maxLength);
+
+                if (length > bestLength) {
+                    bestLength = length;
+                    bestOffset = position - candidate;
+
+                    if (length >= settings.niceLength || length == maxLength) {
+                        break;
+                    }
+                }
+            }
+
+            candidate = hashPrev[candidate & WINDOW_MASK];
+        }
+
+        return bestLength;
+    }
+
+    /**
+     * Hashes the 3 bytes at a position for the binary-tree match finder.
+     * @param data The bytes; three must be readable.
+     * @return The index of the tree for these bytes.
+     */
+    static int treeHash(const char* data) {
+        uint32_t bytes = static_cast<uint32_t>(static_cast<unsigned char>(data[0])) |
+            (static_cast<uint32_t>(static_cast<unsigned char>(data[1])) << 8) |
+            (static_cast<uint32_t>(static_cast<unsigned char>(data[2])) << 16);
+        return static_cast<int>((bytes * 2654435761u) >> (32 - HASH_BITS));
+    }
+
+    /**
+     * Inserts a position into the binary tree of its hash and collects the matches met on the way.
+     * Each tree orders the earlier positions of the window by the bytes that follow them, so the
+     * descent visits ever longer matches; the nodes are re-linked around the new position, which
+     * becomes the root. A search that reaches niceLength or the end of the data stops early and
+     * takes over the children of the node it stopped at.
+     * @param data The input being compressed.
+     * @param dataSize The size of the input.
+     * @param position The position to insert; position + 2 must be inside data.
+     * @param record Whether to append the matches found to treeMatches.
+     * @return The length of the longest match found.
+     */
+    int advanceTree(const char* data, int dataSize, int position, bool record) {
+        const unsigned char* current = reinterpret_cast<const unsigned char*>(data) + position;
+        int maxLength = std::min(dataSize - position - 1, MAX_MATCH_LENGTH);
+
+        int& head = treeHead[treeHash(data + position)];
+        int node = head;
+        head = position;
+
+        int* pendingLess = &treeChildren[2 * (position & WINDOW_MASK)];
+        int* pendingGreater = pendingLess + 1;
+        int windowLimit = position - WINDOW_SIZE;
+        int lessLength = 0;
+        int greaterLength = 0;
+        int length = 0;
+        int bestLength = 0;
+
+        for (int depth = settings.maxChainDepth; ; --depth) {
+            if (node == NO_POSITION || node <= windowLimit || depth == 0 || maxLength < MIN_MATCH_LENGTH) {
+                *pendingLess = NO_POSITION;
+                *pendingGreater = NO_POSITION;
+                return bestLength;
+            }
+
+            const unsigned char* match = reinterpret_cast<const unsigned char*>(data) + node;
+            int* children = &treeChildren[2 * (node & WINDOW_MASK)];
+
+            if (match[length] == current[length]) {
+                length += 1 + matchLength(reinterpret_cast<const char*>(match) + length + 1, reinterpret_cast<const char*>(current) + length + 1, maxLength - length - 1);
+
+                if (length > bestLength) {
+                    bestLength = length;
+
+                    if (record && length >= MIN_MATCH_LENGTH) {
+                        treeMatches.push_back(TreeMatch{ static_cast<uint16_t>(length), static_cast<uint16_t>(position - node) });
+                    }
+
+                    if (length >= settings.niceLength || length == maxLength) {
+                        *pendingLess = children[0];
+                        *pendingGreater = children[1];
+                        return bestLength;
+                    }
+                }
+            }
+
+            if (match[length] < current[length]) {
+                *pendingLess = node;
+                pendingLess = &children[1];
+                node = *pendingLess;
+                lessLength = length;
+                length = std::min(length, greaterLength);
+            }
+            else {
+                *pendingGreater = node;
+                pendingGreater = &children[0];
+                node = *pendingGreater;
+                greaterLength = length;
+                length = std::min(length, lessLength);
+            }
+        }
+    }
+
+    /**
+     * Collects the match candidates of every position of a block with the binary-tree match finder.
+     * After a match of niceLength or more, the positions it covers are only inserted, not searched
+     * for matches of their own, which keeps long repeats fast.
+     * @param data The history followed by the bytes to compress.
+     * @param dataSize The size of data.
+     * @param start The position of the first byte to compress.
+     */
+    void findTreeMatches(const char* data, int dataSize, int start) {
+        treeHead.assign(HASH_SIZE, NO_POSITION);
+        treeChildren.resize(2 * WINDOW_SIZE);
+        treeMatches.clear();
+        treeMatchStart.assign(static_cast<size_t>(dataSize - start) + 1, 0);
+
+        for (int position = std::max(0, start - WINDOW_SIZE); position < start && position + MIN_MATCH_LENGTH <= dataSize; ++position) {
+            advanceTree(data, dataSize, position, false);
+        }
+
+        int skipUntil = start;
+
+        for (int position = start; position < dataSize; ++position) {
+            treeMatchStart[position - start] = static_cast<uint32_t>(treeMatches.size());
+
+            if (position + MIN_MATCH_LENGTH > dataSize) {
+                continue;
+            }
+
+            int bestLength = advanceTree(data, dataSize, position, position >= skipUntil);
+
+            if (position >= skipUntil && bestLength >= settings.niceLength) {
+                skipUntil = position + bestLength;
+            }
+        }
+
+        treeMatchStart[dataSize - start] = static_cast<uint32_t>(treeMatches.size());
+    }
+
+public:
+    static constexpr int MIN_MATCH_LENGTH = 3;
+    static constexpr int MAX_MATCH_LENGTH = 258;
+
+    struct Lz77Code {
+        int offSet;
+        int length;
+        char nextChar;
+
+        Lz77Code(int offSet, int length, char nextChar) : offSet(offSet), length(length), nextChar(nextChar) {};
+    };
+
+    static constexpr int MIN_LEVEL = 1;
+    static constexpr int MAX_LEVEL = 11;
+    static constexpr int DEFAULT_LEVEL = 6;
+
+    /**
+     * Bit prices are kept in 1/PRICE_SCALE bits so that estimates from symbol frequencies stay fractional.
+     */
+    static constexpr uint32_t PRICE_SCALE = 16;
+
+    /**
+     * Prices for optimal parsing of the serialized token stream of compressedToBytes, in which
+     * lengths, offsets and literals are all bytes coded with one Huffman code.
+     * The price of every byte value is estimated from how often it occurs in a previous parse.
+     */
+    class TokenBytePrices {
+    private:
+        uint32_t bytePrices[256];
+
+    public:
+        /**
+         * Constructor starts with every byte costing 8 bits.
+         */
+        TokenBytePrices() {
+            std::fill(bytePrices, bytePrices + 256, 8 * PRICE_SCALE);
+        }
+
+        /**
+         * Re-estimates the prices from the token bytes a parse would produce.
+         * @param tokens The tokens of a parse of the block.
+         */
+        void update(const std::vector<Lz77Code>& tokens) {
+            std::string bytes = compressedToBytes(tokens);
+            uint32_t counts[256];
+            ByteKernels::histogram(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size(), counts);
+            pricesFromCounts(counts, 256, bytePrices);
+        }
+
+        uint64_t noMatchPrice() const {
+            return bytePrices[0];
+        }
+
+        uint64_t literalPrice(unsigned char literal) const {
+            return bytePrices[literal];
+        }
+
+        uint64_t lengthPrice(int length) const {
+            return (length < 0x80) ? bytePrices[length] : bytePrices[(length & 0x7F) | 0x80] + bytePrices[length >> 7];
+        }
+
+        uint64_t offsetPrice(int offset) const {
+            return bytePrices[(offset - 1) & 0xFF] + bytePrices[(offset - 1) >> 8];
+        }
+    };
+
+    /**
+     * Turns symbol counts into prices of -log2 of each symbol's probability.
+     * Every count is raised by one so that symbols the estimate has not seen still get a finite price.
+     * @param counts The count of every symbol.
+     * @param symbols The number of symbols.
+     * @param prices Receives the price of every symbol in 1/PRICE_SCALE bits.
+     */
+    static void pricesFromCounts(const uint32_t* counts, int symbols, uint32_t* prices) {
+        double total = 0;
+        for (int symbol = 0; symbol < symbols; ++symbol) {
+            total += counts[symbol] + 1.0;
+        }
+
+        for (int symbol = 0; symbol < symbols; ++symbol) {
+            prices[symbol] = static_cast<uint32_t>(std::lround(PRICE_SCALE * std::log2(total / (counts[symbol] + 1.0))));
+        }
+    }
+
+    /**
+     * Creates a compressor for a compression level.
+     * Levels 1-3 take the first match greedily and skip indexing the inside of long matches; levels 4-9
+     * use lazy matching and search ever longer hash chains. Levels 10 and 11 parse optimally for the
+     * price model passed to lz77Compress.
+     * @param level A level between MIN_LEVEL (fastest) and MAX_LEVEL (smallest output).
+     */
+    explicit Lz77(int level = DEFAULT_LEVEL)
+        : settings(levelSettings(level)), hashHead(HASH_SIZE, NO_POSITION), hashPrev(WINDOW_SIZE), hashHeadCleared(true), matchLength(ByteKernels::matchLengthFunction()) {}
+
+    /**
+     * Switches to another compression level; takes effect with the next call to lz77Compress.
+     * @param level A level between MIN_LEVEL and MAX_LEVEL.
+     */
+    void setLevel(int level) {
+        settings = levelSettings(level);
+    }
+
+    /**
+     * Compresses a given string using LZ77 algorithm.
+     * Candidate matches come from hash chains over 3-byte prefixes instead of a scan of the whole window.
+     * @param data The input string to compress.
+     * @return A vector of Lz77Code structs representing the compressed data.
+     */
+    std::vector<Lz77Code> lz77Compress(const std::string& data) {
+        return lz77Compress(data.data(), data.size(), 0);
+    }
+
+    /**
+     * Compresses the tail of a string, using the bytes before it only as match history.
+     * @param data The history followed by the bytes to compress.
+     * @param start The position of the first byte to compress; earlier bytes produce no tokens.
+     * @return A vector of Lz77Code structs representing data from start onwards.
+     */
+    std::vector<Lz77Code> lz77Compress(const std::string& data, size_t start) {
+        return lz77Compress(data.data(), data.size(), start);
+    }
+
+    /**
+     * Compresses the tail of a buffer, using the bytes before it only as match history.
+     * The buffer is read in place, so callers can compress memory they own without copying it.
+     * @param data The history followed by the bytes to compress.
+     * @param size The number of bytes in data.
+     * @param start The position of the first byte to compress; earlier bytes produce no tokens.
+     * @return A vector of Lz77Code structs representing data from start onwards.
+     */
+    std::vector<Lz77Code> lz77Compress(const char* data, size_t size, size_t start) {
+        std::vector<Lz77Code> compressedData;
+        lz77Compress(data, size, start, compressedData);
+        return compressedData;
+    }
+
+    /**
+     * Compresses the tail of a buffer into a token vector owned by the caller.
+     * Reusing one vector across calls keeps its capacity, so steady compression does not allocate.
+     * @param data The history followed by the bytes to compress.
+     * @param size The number of bytes in data.
+     * @param start The position of the first byte to compress; earlier bytes produce no tokens.
+     * @param compressedData Receives the tokens of data from start onwards; earlier contents are dropped.
+     */
+    void lz77Compress(const char* data, size_t size, size_t start, std::vector<Lz77Code>& compressedData) {
+        compressedData.clear();
+        int dataSize = static_cast<int>(size);
+        int hash = 0;
+
+        if (!hashHeadCleared) {
+            std::fill(hashHead.begin(), hashHead.end(), NO_POSITION);
+        }
+
+        if (dataSize >= MIN_MATCH_LENGTH) {
+            resetHash(data, 0, hash);
+        }
+
+        int index = static_cast<int>(start);
+
+        for (int position = 0; position < index && position + MIN_MATCH_LENGTH <= dataSize; ++position) {
+            insertPosition(data, position, hash);
+        }
+
+        int bestCopyLength = 0;
+        int currOffSet = 0;
+        bool matchPending = false;
+
+        while (index < dataSize) {
+            int insertedUpTo = index;
+
+            if (!matchPending) {
+                bestCopyLength = 0;
+                currOffSet = 0;
+
+                if (index + MIN_MATCH_LENGTH <= dataSize) {
+                    int chainHead = insertPosition(data, index, hash);
+                    bestCopyLength = findLongestMatch(data, dataSize, index, chainHead, settings.maxChainDepth, currOffSet);
+                }
+            }
+            matchPending = false;
+
+            if (bestCopyLength < MIN_MATCH_LENGTH) {
+                bestCopyLength = 0;
+                currOffSet = 0;
+            }
+
+            // Lazy matching: if the next position starts a longer match, emit this byte as a literal and take that one instead.
+            if (settings.lazy && bestCopyLength > 0 && bestCopyLength < settings.maxLazyLength && index + 1 + MIN_MATCH_LENGTH <= dataSize) {
+                int chainLength = (bestCopyLength >= settings.goodLength) ? settings.maxChainDepth >> 2 : settings.maxChainDepth;
+                int nextOffSet = 0;
+                int chainHead = insertPosition(data, index + 1, hash);
+                int nextLength = findLongestMatch(data, dataSize, index + 1, chainHead, chainLength, nextOffSet);
+                insertedUpTo = index + 1;
+
+                if (nextLength > bestCopyLength) {
+                    compressedData.emplace_back(0, 0, data[index]);
+
+                    index++;
+                    bestCopyLength = nextLength;
+                    currOffSet = nextOffSet;
+                    matchPending = true;
+                    continue;
+                }
+            }
+
+            compressedData.emplace_back(currOffSet, bestCopyLength, data[index + bestCopyLength]);
+
+            int nextIndex = index + bestCopyLength + 1;
+
+            if (!settings.lazy && bestCopyLength > settings.maxLazyLength) {
+                // Fast levels do not index the inside of long matches; the hash restarts after the match.
+                if (nextIndex + MIN_MATCH_LENGTH <= dataSize) {
+                    resetHash(data, nextIndex, hash);
+                }
+            }
+            else {
+                for (int position = insertedUpTo + 1; position < nextIndex && position + MIN_MATCH_LENGTH <= dataSize; ++position) {
+                    insertPosition(data, position, hash);
+                }
+            }
+
+            index = nextIndex;
+        }
+
+        clearHashHeads(data, dataSize);
+    }
+
+    /**
+     * Compresses the tail of a buffer, parsing it optimally at levels 10 and 11.
+     * Below that this is the greedy or lazy parse. At the optimal levels, the lazy parse only seeds
+     * the price model; then the block is parsed as a shortest path over the candidates of a
+     * binary-tree match finder, once at level 10 and, with prices re-estimated from the first
+     * result, a second time at level 11. The parse keeps about 20 bytes of state per input byte.
+     * @param data The history followed by the bytes to compress.
+     * @param size The number of bytes in data.
+     * @param start The position of the first byte to compress; earlier bytes produce no tokens.
+     * @param prices The price model of the entropy coder that will code the tokens, such as TokenBytePrices.
+     * @param tokens Receives the tokens of data from start onwards; earlier contents are dropped.
+     */
+    template <typename PriceModel>
+    void lz77Compress(const char* data, size_t size, size_t start, PriceModel& prices, std::vector<Lz77Code>& tokens) {
+        lz77Compress(data, size, start, tokens);
+
+        for (int pass = 0; pass < settings.optimalPasses && start < size; ++pass) {
+            if (pass == 0) {
+                findTreeMatches(data, static_cast<int>(size), static_cast<int>(start));
+            }
+
+            prices.update(tokens);
+            optimalParse(data, static_cast<int>(size), static_cast<int>(start), prices, tokens);
+        }
+    }
+
+    /**
+     * Decompresses a vector of Lz77Code structures back into the original string.
+     * @param codes The vector of Lz77Code structs representing compressed data.
+     * @return The decompressed string.
+     */
+    static std::string lz77Decompress(const std::vector<Lz77Code>& codes) {
+        size_t size = 0;
+        for (const Lz77Code& code : codes) {
+            size += static_cast<size_t>(code.length) + 1;
+        }
+
+        std::string decompressedText(size, '\0');
+        size_t position = 0;
+
+        for (const Lz77Code& code : codes) {
+            if (code.length > 0) {
+                if (code.offSet <= 0 || static_cast<size_t>(code.offSet) > position) {
+                    throw std::runtime_error("Invalid token: offset points before the start of data");
+                }
+
+                ByteKernels::copyMatch(&decompressedText[position], code.offSet, code.length, size - position);
+                position += code.length;
+            }
+
+            decompressedText[position++] = code.nextChar;
+        }
+        return decompressedText;
+    }
+
+    /**
+    * Serializes compressed LZ77 data into a compact binary token stream.
+    * Each token is the match length as a little-endian base-128 varint (0 for a plain literal),
+    * then, for matches only, offset - 1 as two little-endian bytes, then the raw nextChar byte.
+    * @param codes The vector of Lz77Code structs.
+    * @return A byte string holding the serialized tokens.
+    */
+    static std::string compressedToBytes(const std::vector<Lz77Code>& codes) {
+        std::string bytes;
+        bytes.reserve(codes.size() * 2);
+        appendTokenBytes(codes.data(), codes.size(), bytes);
+        return bytes;
+    }
+
+    /**
+    * Serializes a run of tokens as compressedToBytes does and appends them to a byte string.
+    * @param codes The first token.
+    * @param count The number of tokens.
+    * @param bytes The byte string to append to.
+    */
+    static void appendTokenBytes(const Lz77Code* codes, size_t count, std::string& bytes) {
+        // A token takes at most 5 bytes: two length bytes, two offset bytes and the literal.
+        size_t used = bytes.size();
+        bytes.resize(used + count * 5);
+        char* out = &bytes[0] + used;
+
+        for (const Lz77Code* token = codes; token != codes + count; ++token) {
+            unsigned int length = static_cast<unsigned int>(token->length);
+            while (length >= 0x80) {
+                *out++ = static_cast<char>((length & 0x7F) | 0x80);
+                length >>= 7;
+            }
+            *out++ = static_cast<char>(length);
+
+            if (token->length > 0) {
+                unsigned int offset = static_cast<unsigned int>(token->offSet - 1);
+                *out++ = static_cast<char>(offset & 0xFF);
+                *out++ = static_cast<char>(offset >> 8);
+            }
+
+            *out++ = token->nextChar;
+        }
+
+        bytes.resize(out - bytes.data());
+    }
+
+    /**
+     * Decompresses a binary token stream produced by compressedToBytes.
+     * @param tokenBytes The serialized tokens.
+     * @return The decompressed original string.
+     */
+    static std::string lz77DecompressFromBytes(const std::string& tokenBytes) {
+        std::string decompressedText;
+        lz77DecompressFromBytes(tokenBytes, decompressedText);
+        return decompressedText;
+    }
+
+    /**
+     * Decompresses a binary token stream and appends the result to existing output.
+     * Tokens are decoded straight into the output without building an intermediate token vector.
+     * Whatever decompressedText already holds serves as match history.
+     * @param tokenBytes The serialized tokens.
+     * @param decompressedText The output, with earlier data that matches may refer to.
+     */
+    static void lz77DecompressFromBytes(const std::string& tokenBytes, std::string& decompressedText) {
+        size_t historySize = decompressedText.size();
+        decompressedText.resize(historySize + decodedSize(tokenBytes));
+        lz77DecompressFromBytes(tokenBytes, &decompressedText[0], decompressedText.size(), historySize);
+    }
+
+    /**
+     * Returns how many bytes a binary token stream decodes to, without decoding it.
+     * @param tokenBytes The serialized tokens.
+     * @return The decoded size.
+     */
+    static size_t decodedSize(const std::string& tokenBytes) {
+        size_t decoded = 0;
+        size_t pos = 0;
+        size_t size = tokenBytes.size();
+
+        while (pos < size) {
+            size_t length = 0;
+            int shift = 0;
+            unsigned char byte;
+
+            do {
+                if (pos >= size || shift > 28) {
+                    throw std::runtime_error("Invalid token format: bad length");
+                }
+                byte = static_cast<unsigned char>(tokenBytes[pos++]);
+                length |= static_cast<size_t>(byte & 0x7F) << shift;
+                shift += 7;
+            } while (byte & 0x80);
+
+            pos += (length > 0) ? 3 : 1;
+            decoded += length + 1;
+        }
+
+        return decoded;
+    }
+
+    /**
+     * Decompresses a binary token stream into a caller-provided buffer.
+     * The bytes before position serve as match history, so consecutive blocks can be decoded into
+     * one buffer without copying. Every offset is checked against the history and the window, so
+     * corrupt tokens cannot read outside the buffer; matches are copied with wide moves.
+     * @param tokenBytes The serialized tokens.
+     * @param output The output buffer.
+     * @param capacity The size of the output buffer.
+     * @param position Where the decoded bytes start; output[0, position) is history.
+     * @param prefix Bytes that precede output[0], such as a preset dictionary; matches may reach into them.
+     * @param prefixSize The number of prefix bytes.
+     * @return The position after the last decoded byte.
+     * @throws std::runtime_error if the tokens are malformed or do not fit.
+     */
+    static size_t lz77DecompressFromBytes(const std::string& tokenBytes, char* output, size_t capacity, size_t position,
+        const char* prefix = nullptr, size_t prefixSize = 0) {
+        size_t pos = 0;
+        size_t size = tokenBytes.size();
+
+        while (pos < size) {
+            size_t length = 0;
+            int shift = 0;
+            unsigned char byte;
+
+            do {
+                if (pos >= size || shift > 28) {
+                    throw std::runtime_error("Invalid token format: bad length");
+                }
+                byte = static_cast<unsigned char>(tokenBytes[pos++]);
+                length |= static_cast<size_t>(byte & 0x7F) << shift;
+                shift += 7;
+            } while (byte & 0x80);
+
+            if (length >= capacity - position) {
+                throw std::runtime_error("Decompressed data does not fit the output buffer");
+            }
+
+            if (length > 0) {
+                if (pos + 2 > size) {
+                    throw std::runtime_error("Invalid token format: missing offset");
+                }
+
+                size_t offset = static_cast<unsigned char>(tokenBytes[pos]) | (static_cast<unsigned char>(tokenBytes[pos + 1]) << 8);
+                offset += 1;
+                pos += 2;
+
+                if (offset > position + prefixSize) {
+                    throw std::runtime_error("Invalid token format: offset points before the start of data");
+                }
+
+                if (offset > WINDOW_SIZE) {
+                    throw std::runtime_error("Invalid token format: offset is larger than the window");
+                }
+
+                if (offset > position) {
+                    // The match starts in the prefix; copy that part, then continue from the output.
+                    size_t fromPrefix = std::min(offset - position, length);
+                    std::memcpy(output + position, prefix + prefixSize - (offset - position), fromPrefix);
+                    position += fromPrefix;
+                    length -= fromPrefix;
+                }
+
+                if (length > 0) {
+                    ByteKernels::copyMatch(output + position, offset, length, capacity - position);
+                    position += length;
+                }
+            }
+
+            if (pos >= size) {
+                throw std::runtime_error("Invalid token format: missing nextChar");
+            }
+
+            output[position++] = tokenBytes[pos++];
+        }
+
+        return position;
+    }
+
+private:
+    /**
+     * Finds the cheapest sequence of tokens for a block under a price model.
+     * The block is a shortest-path problem over its positions: a token from position i either is a
+     * plain literal and reaches i + 1, or is a match of any length up to a candidate's and reaches
+     * past the match and its literal. Costs are relaxed forwards in position order, then the path is
+     * read back from the end.
+     * @param data The history followed by the bytes to compress.
+     * @param dataSize The size of data.
+     * @param start The position of the first byte to compress.
+     * @param prices The bit prices of literals, lengths and offsets.
+     * @param tokens Receives the tokens of the cheapest parse.
+     */
+    template <typename PriceModel>
+    void optimalParse(const char* data, int dataSize, int start, const PriceModel& prices, std::vector<Lz77Code>& tokens) {
+        size_t count = static_cast<size_t>(dataSize - start);
+        parseCost.assign(count + 1, NO_PRICE);
+        parseLength.resize(count + 1);
+        parseOffset.resize(count + 1);
+        parseCost[0] = 0;
+
+        uint64_t noMatchPrice = prices.noMatchPrice();
+
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t cost = parseCost[i];
+            const char* current = data + start + i;
+
+            uint64_t literalCost = cost + noMatchPrice + prices.literalPrice(static_cast<unsigned char>(current[0]));
+            if (literalCost < parseCost[i + 1]) {
+                parseCost[i + 1] = literalCost;
+                parseLength[i + 1] = 0;
+            }
+
+            int length = MIN_MATCH_LENGTH;
+
+            for (uint32_t candidate = treeMatchStart[i]; candidate < treeMatchStart[i + 1]; ++candidate) {
+                const TreeMatch& match = treeMatches[candidate];
+                uint64_t offsetCost = cost + prices.offsetPrice(match.offset);
+
+                for (; length <= match.length; ++length) {
+                    uint64_t matchCost = offsetCost + prices.lengthPrice(length) + prices.literalPrice(static_cast<unsigned char>(current[length]));
+                    size_t next = i + length + 1;
+
+                    if (matchCost < parseCost[next]) {
+                        parseCost[next] = matchCost;
+                        parseLength[next] = static_cast<uint16_t>(length);
+                        parseOffset[next] = match.offset;
+                    }
+                }
+            }
+        }
+
+        tokens.clear();
+        for (size_t i = count; i > 0; ) {
+            int length = parseLength[i];
+            tokens.emplace_back(length ? parseOffset[i] : 0, length, data[start + i - 1]);
+            i -= static_cast<size_t>(length) + 1;
+        }
+
+        std::reverse(tokens.begin(), tokens.end());
+    }
+};
+
+#endif
@@ -1,56 +1,656 @@
 #include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
 
-#include "huffman.cpp"
-#include "lz77.cpp"
-#include "filemanager.cpp"
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <tuple>
+
+#include "archivereader.h"
+#include "blockcodec.h"
+#include "codecstats.h"
+#include "deflate_dm.h"
+#include "dictionary.h"
+#include "filemanager.h"
+#include "rfc1951.h"
+#include "threadpool.h"
+
+/**
+ * @brief Writes the end block, the stream footer and the block index that close every compressed file.
+ * @param outputFile The compressed file.
+ * @param index One entry per chunk of input.
+ * @param checksum The CRC-32C of all input.
+ * @return The number of bytes written.
+ */
+static uint64_t writeStreamEnd(OutputFile& outputFile, const std::vector<BlockCodec::IndexEntry>& index, uint32_t checksum) {
+    uint64_t rawSize = 0;
+    for (const BlockCodec::IndexEntry& entry : index) {
+        rawSize += entry.rawSize;
+    }
+
+    std::vector<uint8_t> output;
+    BlockCodec::writeBlockHeader(output, BlockCodec::BlockHeader{ BlockCodec::BLOCK_END, 0, 0 });
+    BlockCodec::writeStreamFooter(output, rawSize, checksum);
+    BlockCodec::writeIndex(output, index);
+    outputFile.write(output);
+    outputFile.close();
+
+    return output.size();
+}
+
+/**
+ * @brief Loads a dictionary written by the train action.
+ * @param dictionaryPath The path of the dictionary file.
+ * @return The dictionary.
+ */
+static Dictionary loadDictionary(const std::string& dictionaryPath) {
+    InputFile dictionaryFile(dictionaryPath);
+    std::vector<uint8_t> buffer;
+    size_t size = 0;
+    const uint8_t* data = dictionaryFile.contents(buffer, size);
+
+    return Dictionary::parse(data, size);
+}
 
 /**
- * @brief Compresses a file using LZ77 followed by Huffman coding and writes the output to a compressed file.
+ * @brief Trains a preset dictionary on sample files and saves it.
+ * @param dictionaryPath The path where the dictionary will be saved.
+ * @param samplePaths Files typical of the data the dictionary will be used for.
+ * @param dictionarySize The largest dictionary content size in bytes.
+ * @param level The compression level the dictionary will be used with.
+ * @return The size of the dictionary file in bytes.
+ */
+static uint64_t trainDictionary(const std::string& dictionaryPath, const std::vector<std::string>& samplePaths, size_t dictionarySize, int level) {
+    std::vector<std::string> samples;
+    samples.reserve(samplePaths.size());
+
+    for (const std::string& samplePath : samplePaths) {
+        InputFile sampleFile(samplePath);
+        std::vector<uint8_t> buffer;
+        size_t size = 0;
+        const uint8_t* data = sampleFile.contents(buffer, size);
+        samples.emplace_back(reinterpret_cast<const char*>(data), size);
+    }
+
+    std::vector<uint8_t> serialized = Dictionary::train(samples, dictionarySize, level).serialize();
+
+    OutputFile outputFile(dictionaryPath);
+    outputFile.write(serialized);
+    outputFile.close();
+
+    return serialized.size();
+}
+
+/**
+ * @brief Compresses a file block by block using LZ77 followed by Huffman coding.
+ * Each block is written as soon as it is encoded. Mapped input is compressed in place; otherwise only
+ * the current block and the 32 KB of input before it are kept in memory, so memory use depends on the
+ * block size, not the file size.
  * @param inputFilePath The path to the input file to be compressed.
  * @param outputFilePath The path where the compressed file will be saved.
- * @param huffman A reference to a Huffman object used for encoding.
- * @return The compressed Huffman-encoded bitstring.
+ * @param blockSize The number of input bytes per block.
+ * @param level The compression level, between Lz77::MIN_LEVEL and Lz77::MAX_LEVEL.
+ * @param maxCodeLength The longest Huffman code allowed.
+ * @param huffmanStreams The number of Huffman bit streams per block, 1 or Huffman::INTERLEAVED_STREAMS.
+ * @param dictionary The preset dictionary, or nullptr.
+ * @param stats The stats to collect, or nullptr.
+ * @return The size of the compressed file in bytes.
  */
-static std::string deflateCompress(const std::string inputFilePath, const std::string outputFilePath, Huffman& huffman) {
-    std::ifstream inputFile(inputFilePath);
+static uint64_t deflateCompress(const std::string& inputFilePath, const std::string& outputFilePath, size_t blockSize, int level, int maxCodeLength, int huffmanStreams, const Dictionary* dictionary, CodecStats* stats) {
+    InputFile inputFile(inputFilePath);
+    OutputFile outputFile(outputFilePath);
+    inputFile.setStats(stats);
+    outputFile.setStats(stats);
 
-    std::string inputData((std::istreambuf_iterator<char>(inputFile)), std::istreambuf_iterator<char>());
+    std::vector<uint8_t> output;
+    uint8_t flags = BlockCodec::FLAG_BLOCK_INDEX | BlockCodec::FLAG_CHECKSUMS | (dictionary ? BlockCodec::FLAG_DICTIONARY : 0);
+    BlockCodec::writeStreamHeader(output, flags, dictionary ? dictionary->getId() : 0);
+    outputFile.write(output);
+    uint64_t compressedSize = output.size();
 
-    Lz77 lz77;
-    std::vector<Lz77::Lz77Code> lz77CompressedData = lz77.lz77Compress(inputData);
+    BlockEncoder encoder(level);
+    encoder.setMaxCodeLength(maxCodeLength);
+    encoder.setHuffmanStreams(huffmanStreams);
+    encoder.setDictionary(dictionary);
+    encoder.setChecksums(true);
+    encoder.setStats(stats);
+    InputWindow window(inputFile, blockSize, BlockCodec::HISTORY_SIZE);
+    std::vector<BlockCodec::IndexEntry> index;
+    uint32_t checksum = Checksum::CRC32C_INIT;
 
-    std::string lz77CompressedString = lz77.compressedToString(lz77CompressedData);
+    while (window.next()) {
+        size_t rawSize = window.size() - window.start();
 
-    huffman.build(lz77CompressedString);
+        output.clear();
+        encoder.encodeBlock(window.data(), window.size(), window.start(), output);
+        outputFile.write(output);
+        compressedSize += output.size();
+        index.push_back(BlockCodec::IndexEntry{ static_cast<uint32_t>(rawSize), static_cast<uint32_t>(output.size()) });
+        checksum = Checksum::crcCombine(Checksum::CRC32C_POLYNOMIAL, checksum, encoder.getChecksum(), rawSize);
+    }
 
-    std::string huffmanCompressedData = huffman.encode(lz77CompressedString);
-    huffman.saveHuffmanTreeToFile(outputFilePath);
+    return compressedSize + writeStreamEnd(outputFile, index, checksum);
+}
 
-    writeCompressedData(huffmanCompressedData, outputFilePath);
+/**
+ * @brief Compresses a file in independent blocks on a pool of worker threads.
+ * Blocks share no LZ77 history, so each one is compressed on its own; results are written in input
+ * order, which makes the output identical for every thread count. At most two blocks per worker are
+ * in flight at a time.
+ * @param inputFilePath The path to the input file to be compressed.
+ * @param outputFilePath The path where the compressed file will be saved.
+ * @param blockSize The number of input bytes per block.
+ * @param threadCount The number of worker threads; 0 uses one per hardware thread.
+ * @param level The compression level, between Lz77::MIN_LEVEL and Lz77::MAX_LEVEL.
+ * @param maxCodeLength The longest Huffman code allowed.
+ * @param huffmanStreams The number of Huffman bit streams per block, 1 or Huffman::INTERLEAVED_STREAMS.
+ * @param dictionary The preset dictionary, or nullptr; every block is primed with it.
+ * @param stats The stats to collect, or nullptr; workers collect their own and they are merged here.
+ * @return The size of the compressed file in bytes.
+ */
+static uint64_t deflateCompressParallel(const std::string& inputFilePath, const std::string& outputFilePath, size_t blockSize, size_t threadCount, int level, int maxCodeLength, int huffmanStreams, const Dictionary* dictionary, CodecStats* stats) {
+    InputFile inputFile(inputFilePath);
+    OutputFile outputFile(outputFilePath);
+    inputFile.setStats(stats);
+    outputFile.setStats(stats);
+
+    std::vector<uint8_t> output;
+    uint8_t flags = BlockCodec::FLAG_INDEPENDENT_BLOCKS | BlockCodec::FLAG_BLOCK_INDEX | BlockCodec::FLAG_CHECKSUMS | (dictionary ? BlockCodec::FLAG_DICTIONARY : 0);
+    BlockCodec::writeStreamHeader(output, flags, dictionary ? dictionary->getId() : 0);
+    outputFile.write(output);
+    uint64_t compressedSize = output.size();
+    uint64_t offset = 0;
+
+    ThreadPool pool(threadCount);
+    std::deque<std::pair<uint32_t, std::future<std::tuple<std::vector<uint8_t>, uint32_t, CodecStats>>>> pending;
+    bool collect = (stats != nullptr);
+    std::vector<BlockCodec::IndexEntry> index;
+    uint32_t checksum = Checksum::CRC32C_INIT;
+    bool endOfInput = false;
+
+    while (true) {
+        while (!endOfInput && pending.size() < 2 * pool.size()) {
+            // Mapped blocks are handed to the workers in place; otherwise each block is read into its own buffer.
+            std::string block;
+            const char* mappedBlock = nullptr;
+            size_t rawSize = 0;
+
+            if (inputFile.isMapped()) {
+                rawSize = static_cast<size_t>(std::min<uint64_t>(blockSize, inputFile.size() - offset));
+                mappedBlock = reinterpret_cast<const char*>(inputFile.data()) + offset;
+            }
+            else {
+                block.resize(blockSize);
+                block.resize(inputFile.read(offset, &block[0], blockSize));
+                rawSize = block.size();
+            }
+
+            if (rawSize == 0) {
+                endOfInput = true;
+                break;
+            }
 
-    return huffmanCompressedData;
+            offset += rawSize;
+            pending.emplace_back(static_cast<uint32_t>(rawSize), pool.submit([block = std::move(block), mappedBlock, rawSize, level, maxCodeLength, huffmanStreams, dictionary, collect]() {
+                thread_local BlockEncoder encoder;
+                CodecStats blockStats;
+                encoder.setLevel(level);
+                encoder.setMaxCodeLength(maxCodeLength);
+                encoder.setHuffmanStreams(huffmanStreams);
+                encoder.setDictionary(dictionary);
+                encoder.setChecksums(true);
+                encoder.setStats(collect ? &blockStats : nullptr);
+
+                std::vector<uint8_t> encoded;
+                encoder.encodeBlock(mappedBlock ? mappedBlock : block.data(), rawSize, 0, encoded);
+                return std::make_tuple(std::move(encoded), encoder.getChecksum(), blockStats);
+            }));
+        }
+
+        if (pending.empty()) {
+            break;
+        }
+
+        std::tuple<std::vector<uint8_t>, uint32_t, CodecStats> result = pending.front().second.get();
+        const std::vector<uint8_t>& encoded = std::get<0>(result);
+        uint32_t rawSize = pending.front().first;
+
+        if (stats) {
+            stats->merge(std::get<2>(result));
+        }
+
+        outputFile.write(encoded);
+        compressedSize += encoded.size();
+        index.push_back(BlockCodec::IndexEntry{ rawSize, static_cast<uint32_t>(encoded.size()) });
+        checksum = Checksum::crcCombine(Checksum::CRC32C_POLYNOMIAL, checksum, std::get<1>(result), rawSize);
+        pending.pop_front();
+    }
+
+    return compressedSize + writeStreamEnd(outputFile, index, checksum);
 }
 
 /**
- * @brief Decompresses a file using Huffman decoding followed by LZ77 decompression.
+ * @brief Decompresses a file block by block using Huffman decoding followed by LZ77 decompression.
+ * Each block is written out as soon as it is decoded; only the last 32 KB of output are kept as history.
+ * Block bodies of a mapped file are decoded in place.
  * @param inputFilePath The path to the compressed file.
  * @param outputFilePath The path where the decompressed file will be saved.
- * @param huffman A reference to a Huffman object used for decoding.
- * @param pos A position of data skipping header info.
- * @return The decompressed string.
+ * @param dictionary The dictionary the file was compressed with, or nullptr.
+ * @param verify Whether to check the block and stream checksums.
+ * @param stats The stats to collect, or nullptr.
+ * @return The size of the decompressed data in bytes.
  */
-static std::string deflateDecompress(const std::string inputFilePath, const std::string outputFilePath, Huffman& huffman, std::streampos pos) {
-    std::string huffmanCompressedData = readCompressedData(inputFilePath, pos);
-    
-    std::string lz77CompressedString = huffman.decode(huffmanCompressedData);
-
-    std::string decompressedData = Lz77::lz77DecompressFromString(lz77CompressedString);
-       
-    std::ofstream outputFile(outputFilePath);
-    outputFile << decompressedData;
+static uint64_t deflateDecompress(const std::string& inputFilePath, const std::string& outputFilePath, const Dictionary* dictionary, bool verify, CodecStats* stats) {
+    InputFile inputFile(inputFilePath);
+    OutputFile outputFile(outputFilePath);
+    inputFile.setStats(stats);
+    outputFile.setStats(stats);
+
+    std::vector<uint8_t> buffer;
+    uint8_t header[BlockCodec::STREAM_HEADER_SIZE + BlockCodec::DICTIONARY_ID_SIZE];
+    std::memcpy(header, inputFile.view(0, BlockCodec::STREAM_HEADER_SIZE, buffer), BlockCodec::STREAM_HEADER_SIZE);
+
+    uint8_t flags = BlockCodec::readStreamHeader(header);
+    uint64_t offset = BlockCodec::STREAM_HEADER_SIZE;
+
+    if (flags & BlockCodec::FLAG_DICTIONARY) {
+        std::memcpy(header + offset, inputFile.view(offset, BlockCodec::DICTIONARY_ID_SIZE, buffer), BlockCodec::DICTIONARY_ID_SIZE);
+        offset += BlockCodec::DICTIONARY_ID_SIZE;
+    }
+
+    BlockCodec::checkDictionary(flags, header, dictionary);
+
+    BlockDecoder decoder;
+    decoder.setDictionary(dictionary);
+    decoder.setStats(stats);
+    decoder.setStreamFlags(flags);
+    decoder.setVerify(verify);
+    std::string window;
+    uint64_t decompressedSize = 0;
+    size_t blockHeaderSize = BlockCodec::blockHeaderSize(flags);
+
+    while (true) {
+        uint8_t blockType = *inputFile.view(offset, 1, buffer);
+
+        if (blockType == BlockCodec::BLOCK_END) {
+            if (decoder.isVerifying()) {
+                decoder.checkStreamFooter(inputFile.view(offset + 1, BlockCodec::STREAM_FOOTER_SIZE, buffer));
+            }
+            break;
+        }
+
+        BlockCodec::BlockHeader header = BlockCodec::parseBlockHeader(blockType, inputFile.view(offset + 1, blockHeaderSize - 1, buffer), flags);
+        offset += blockHeaderSize;
+
+        const uint8_t* body = inputFile.view(offset, header.bodySize(), buffer);
+        offset += header.bodySize();
+
+        // Independent chunks were compressed without history, only the dictionary in front of them.
+        if ((flags & BlockCodec::FLAG_INDEPENDENT_BLOCKS) && !header.continuesChunk) {
+            window.clear();
+        }
+
+        size_t historySize = window.size();
+        decoder.decodeBlock(header, body, window);
+
+        outputFile.write(window.data() + historySize, window.size() - historySize);
+        decompressedSize += window.size() - historySize;
+
+        if (window.size() > BlockCodec::HISTORY_SIZE) {
+            window.erase(0, window.size() - BlockCodec::HISTORY_SIZE);
+        }
+    }
+
+    outputFile.close();
+    return decompressedSize;
+}
+
+/**
+ * @brief Decompresses a file through its block index, decoding independent blocks concurrently.
+ * @param inputFilePath The path to the compressed file.
+ * @param outputFilePath The path where the decompressed data will be saved.
+ * @param threadCount The number of decoding threads; 0 uses one per hardware thread.
+ * @param rangeOffset The first decompressed byte to write.
+ * @param rangeLength The number of bytes to write; the whole file from rangeOffset if 0.
+ * @param dictionary The dictionary the file was compressed with, or nullptr.
+ * @param verify Whether to check the block and stream checksums.
+ * @param stats The stats to collect, or nullptr.
+ * @return The number of bytes written.
+ */
+static uint64_t deflateDecompressIndexed(const std::string& inputFilePath, const std::string& outputFilePath, size_t threadCount, uint64_t rangeOffset, uint64_t rangeLength, const Dictionary* dictionary, bool verify, CodecStats* stats) {
+    ArchiveReader reader(inputFilePath, dictionary);
+    OutputFile outputFile(outputFilePath);
+    reader.setStats(stats);
+    reader.setVerify(verify);
+    outputFile.setStats(stats);
+
+    if (rangeOffset == 0 && rangeLength == 0) {
+        outputFile.preallocate(reader.size());
+        reader.decompressAll(outputFile, threadCount);
+        outputFile.close();
+        return reader.size();
+    }
+
+    std::string range = reader.readRange(rangeOffset, rangeLength ? rangeLength : reader.size(), threadCount);
+    outputFile.write(range.data(), range.size());
+    outputFile.close();
+
+    return range.size();
+}
+
+/**
+ * @brief Compresses a file into a standard DEFLATE stream, optionally wrapped as zlib or gzip.
+ * Input is read block by block with a 32 KB history, like the native format, so memory use depends
+ * on the block size; mapped input is compressed in place. The output can be read by zlib, gzip and any other RFC 1951 decoder.
+ * @param inputFilePath The path to the input file to be compressed.
+ * @param outputFilePath The path where the compressed file will be saved.
+ * @param blockSize The number of input bytes per block.
+ * @param framing The wrapper to put around the DEFLATE data.
+ * @param level The compression level, between Lz77::MIN_LEVEL and Lz77::MAX_LEVEL.
+ * @param maxCodeLength The longest Huffman code allowed.
+ * @param stats The stats to collect, or nullptr.
+ * @return The size of the compressed file in bytes.
+ */
+static uint64_t deflateCompressRfc1951(const std::string& inputFilePath, const std::string& outputFilePath, size_t blockSize, Rfc1951::Framing framing, int level, int maxCodeLength, CodecStats* stats) {
+    InputFile inputFile(inputFilePath);
+    OutputFile outputFile(outputFilePath);
+    inputFile.setStats(stats);
+    outputFile.setStats(stats);
+
+    std::vector<uint8_t> output;
+    Rfc1951::writeHeader(output, framing, level);
+    outputFile.write(output);
+    uint64_t compressedSize = output.size();
+
+    DeflateEncoder encoder(level);
+    encoder.setMaxCodeLength(maxCodeLength);
+    encoder.setStats(stats);
+    InputWindow window(inputFile, blockSize, BlockCodec::HISTORY_SIZE);
+    uint32_t checksum = Rfc1951::initialChecksum(framing);
+    uint64_t rawSize = 0;
+
+    while (true) {
+        bool hasData = window.next();
+        bool finalBlock = window.atEnd();
+
+        if (hasData || (finalBlock && rawSize == 0)) {
+            encoder.encodeBlock(window.data(), window.size(), window.start(), finalBlock);
+            checksum = Rfc1951::updateChecksum(framing, checksum, window.data() + window.start(), window.size() - window.start());
+            rawSize += window.size() - window.start();
+        }
+
+        output = finalBlock ? encoder.finish() : encoder.takeOutput();
+        outputFile.write(output);
+        compressedSize += output.size();
+
+        if (finalBlock) {
+            break;
+        }
+    }
+
+    output.clear();
+    Rfc1951::writeTrailer(output, framing, checksum, rawSize);
+    outputFile.write(output);
+    outputFile.close();
+
+    return compressedSize + output.size();
+}
+
+/**
+ * @brief Decompresses a DEFLATE, zlib or gzip file and checks the wrapper's checksum and size.
+ * The compressed file is mapped, or read into memory where it cannot be; the output is written in
+ * pieces as it is decoded.
+ * Concatenated gzip members are decoded one after another, as gzip does.
+ * @param inputFilePath The path to the compressed file.
+ * @param outputFilePath The path where the decompressed file will be saved.
+ * @param framing The wrapper of the compressed data.
+ * @param verify Whether to check the wrapper's checksum.
+ * @param stats The stats to collect, or nullptr. Inflating decodes Huffman codes and LZ77 matches in
+ * one pass, so its time is all reported as Huffman decoding.
+ * @return The size of the decompressed data in bytes.
+ */
+static uint64_t deflateDecompressRfc1951(const std::string& inputFilePath, const std::string& outputFilePath, Rfc1951::Framing framing, bool verify, CodecStats* stats) {
+    InputFile inputFile(inputFilePath);
+    inputFile.setStats(stats);
+    std::vector<uint8_t> buffer;
+    size_t compressedSize = 0;
+    const uint8_t* compressed = inputFile.contents(buffer, compressedSize);
+    OutputFile outputFile(outputFilePath);
+    outputFile.setStats(stats);
+
+    Inflater inflater;
+    uint64_t decompressedSize = 0;
+    size_t pos = 0;
+
+    do {
+        pos += Rfc1951::parseHeader(compressed + pos, compressedSize - pos, framing);
+
+        uint32_t checksum = Rfc1951::initialChecksum(framing);
+        uint64_t memberSize = 0;
+
+        double writeSeconds = stats ? stats->stages[CodecStats::STAGE_WRITE].seconds : 0;
+        size_t memberStart = pos;
+        {
+            CodecStats::Timer timer(stats, CodecStats::STAGE_HUFFMAN_DECODE);
+            pos += inflater.inflate(compressed + pos, compressedSize - pos, [&](const char* data, size_t size) {
+                outputFile.write(data, size);
+                if (verify) {
+                    checksum = Rfc1951::updateChecksum(framing, checksum, data, size);
+                }
+                memberSize += size;
+            });
+        }
+
+        if (stats) {
+            // Output is written from inside the inflater; that time belongs to the write stage.
+            stats->stages[CodecStats::STAGE_HUFFMAN_DECODE].seconds -= stats->stages[CodecStats::STAGE_WRITE].seconds - writeSeconds;
+            stats->addBytes(CodecStats::STAGE_HUFFMAN_DECODE, pos - memberStart, memberSize);
+        }
+
+        if (compressedSize - pos < Rfc1951::trailerSize(framing)) {
+            throw std::runtime_error("Truncated stream trailer");
+        }
+
+        Rfc1951::checkTrailer(framing, compressed + pos, checksum, memberSize, verify);
+        pos += Rfc1951::trailerSize(framing);
+
+        decompressedSize += memberSize;
+    } while (framing == Rfc1951::Framing::Gzip && pos < compressedSize);
+
     outputFile.close();
 
-    return decompressedData;
+    return decompressedSize;
+}
+
+/**
+ * @brief The largest request payload the serve action accepts.
+ */
+static constexpr uint32_t MAX_REQUEST_SIZE = static_cast<uint32_t>(BlockCodec::MAX_BLOCK_SIZE);
+
+/**
+ * @brief The largest decompressed response the serve action produces unless --max-output-size is given.
+ */
+static constexpr uint64_t DEFAULT_MAX_RESPONSE_SIZE = 256 << 20;
+
+/**
+ * @brief Reads exactly the given number of bytes of a request from standard input.
+ * @param data The buffer that receives the bytes.
+ * @param size The number of bytes.
+ * @param atFrameStart Whether the bytes start a request; input may end cleanly there.
+ * @return false if input ended at the start of a request.
+ * @throws std::runtime_error if input ends inside a request.
+ */
+static bool readRequestBytes(char* data, size_t size, bool atFrameStart) {
+    std::cin.read(data, static_cast<std::streamsize>(size));
+
+    if (static_cast<size_t>(std::cin.gcount()) == size) {
+        return true;
+    }
+
+    if (atFrameStart && std::cin.gcount() == 0) {
+        return false;
+    }
+
+    throw std::runtime_error("Truncated request");
+}
+
+/**
+ * @brief Handles one request of the serve action on a worker thread.
+ * Each worker keeps its own DeflateContext, so match finder tables, Huffman tables and the parsed
+ * dictionary are set up once per thread rather than once per request.
+ * @param type 'c' to compress the payload, 'd' to decompress it.
+ * @param payload The request payload.
+ * @param options The compression options, including the dictionary.
+ * @param formatGiven Whether decompression uses options.format instead of detecting the format.
+ * @param verify Whether decompression checks checksums.
+ * @param maxResponseSize The largest decompressed size; larger data is rejected before or while it is decoded.
+ * @return The response payload.
+ */
+static std::vector<uint8_t> serveRequest(char type, const std::vector<uint8_t>& payload, const DeflateOptions& options, bool formatGiven, bool verify,
+    uint64_t maxResponseSize) {
+    thread_local DeflateContext context;
+    context.setVerifyChecksums(verify);
+    context.setMaxOutputSize(maxResponseSize);
+    std::vector<uint8_t> output;
+
+    if (type == 'c') {
+        output.resize(DeflateDm::compressBound(payload.size(), options));
+        output.resize(context.compress(payload.data(), payload.size(), output.data(), output.size(), options));
+        return output;
+    }
+
+    if (type != 'd') {
+        throw std::runtime_error("Unknown request type");
+    }
+
+    DeflateFormat format = options.format;
+    if (!formatGiven && !DeflateDm::detectFormat(payload.data(), payload.size(), format)) {
+        throw std::runtime_error("Unknown compressed format; start the server with --format=deflate for raw DEFLATE data");
+    }
+
+    context.decompress(payload.data(), payload.size(), output, format, options.dictionary, options.dictionarySize);
+    return output;
+}
+
+/**
+ * @brief Serves compression requests framed on standard input until it ends.
+ * A request is a type byte ('c' or 'd'), a 4-byte little-endian payload size and the payload. Each
+ * response is a status byte (0 for success, 1 for an error), a 4-byte little-endian size and the
+ * result or the error message. A reader thread hands requests to the pool as they arrive, so
+ * pipelined requests run in parallel; responses are written in request order and flushed together
+ * whenever the next one is not ready yet.
+ * @param options The compression options.
+ * @param formatGiven Whether decompression uses options.format instead of detecting the format.
+ * @param verify Whether decompression checks checksums.
+ * @param maxResponseSize The largest decompressed response, at most UINT32_MAX.
+ * @param threadCount The number of worker threads; 0 uses one per hardware thread.
+ * @return The number of requests served.
+ */
+static uint64_t serveRequests(const DeflateOptions& options, bool formatGiven, bool verify, uint64_t maxResponseSize, size_t threadCount) {
+    // Standard input and output carry binary frames and are used from separate threads.
+    std::ios::sync_with_stdio(false);
+    std::cin.tie(nullptr);
+
+    ThreadPool pool(threadCount);
+    std::deque<std::future<std::vector<uint8_t>>> pending;
+    size_t maxPending = 4 * pool.size();
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool endOfInput = false;
+    std::string inputError;
+
+    std::thread reader([&] {
+        try {
+            char header[5];
+
+            while (readRequestBytes(header, sizeof(header), true)) {
+                uint32_t size = BlockCodec::readUint32(reinterpret_cast<const uint8_t*>(header + 1));
+
+                if (size > MAX_REQUEST_SIZE) {
+                    throw std::runtime_error("Request is larger than 64 MiB");
+                }
+
+                std::vector<uint8_t> payload(size);
+                readRequestBytes(reinterpret_cast<char*>(payload.data()), size, false);
+
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] { return pending.size() < maxPending; });
+                pending.push_back(pool.submit([type = header[0], payload = std::move(payload), &options, formatGiven, verify, maxResponseSize]() {
+                    return serveRequest(type, payload, options, formatGiven, verify, maxResponseSize);
+                }));
+                changed.notify_all();
+            }
+        }
+        catch (const std::exception& error) {
+            std::lock_guard<std::mutex> lock(mutex);
+            inputError = error.what();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        endOfInput = true;
+        changed.notify_all();
+    });
+
+    uint64_t served = 0;
+
+    while (true) {
+        std::future<std::vector<uint8_t>> result;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+
+            if (pending.empty() && !endOfInput) {
+                lock.unlock();
+                std::cout.flush();
+                lock.lock();
+            }
+
+            changed.wait(lock, [&] { return !pending.empty() || endOfInput; });
+
+            if (pending.empty()) {
+                break;
+            }
+
+            result = std::move(pending.front());
+            pending.pop_front();
+        }
+        changed.notify_all();
+
+        if (result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            std::cout.flush();
+        }
+
+        std::vector<uint8_t> response;
+        uint8_t status = 0;
+
+        try {
+            response = result.get();
+        }
+        catch (const std::exception& error) {
+            std::string message = error.what();
+            response.assign(message.begin(), message.end());
+            status = 1;
+        }
+
+        std::vector<uint8_t> header(1, status);
+        BlockCodec::writeUint32(header, static_cast<uint32_t>(response.size()));
+        std::cout.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+        std::cout.write(reinterpret_cast<const char*>(response.data()), static_cast<std::streamsize>(response.size()));
+        ++served;
+    }
+
+    reader.join();
+    std::cout.flush();
+
+    if (!inputError.empty()) {
+        throw std::runtime_error(inputError);
+    }
+
+    return served;
 }
 
 /**
@@ -60,42 +660,256 @@ static std::string deflateDecompress(const std::string inputFilePath, const std:
  * @return int Returns 0 on successful execution, 1 on errors.
  */
 int main(int argc, char* argv[]) {
-    if (argc < 4) {
-        std::cerr << "Usage: " << argv[0] << " <action> <inputFilePath> <compressedFilePath> <decompressedFilePath>\n";
-        std::cerr << "Action options: compress | decompress\n";
+    std::vector<std::string> arguments;
+    size_t blockSize = BlockCodec::DEFAULT_BLOCK_SIZE;
+    size_t threadCount = 0;
+    bool parallel = false;
+    uint64_t rangeOffset = 0;
+    uint64_t rangeLength = 0;
+    bool ranged = false;
+    std::string format;
+    int level = Lz77::DEFAULT_LEVEL;
+    int maxCodeLength = Huffman::MAX_CODE_LENGTH;
+    int huffmanStreams = 1;
+    std::string dictionaryPath;
+    size_t dictionarySize = Dictionary::DEFAULT_CONTENT_SIZE;
+    std::string statsFormat;
+    bool verify = true;
+    uint64_t maxResponseSize = DEFAULT_MAX_RESPONSE_SIZE;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+
+        if (argument.rfind("--block-size=", 0) == 0) {
+            blockSize = std::strtoull(argument.c_str() + 13, nullptr, 10);
+
+            if (blockSize == 0 || blockSize > BlockCodec::MAX_BLOCK_SIZE) {
+                std::cerr << "Block size must be between 1 and " << BlockCodec::MAX_BLOCK_SIZE << " bytes.\n";
+                return 1;
+            }
+        }
+        else if (argument.rfind("--threads=", 0) == 0) {
+            threadCount = std::strtoull(argument.c_str() + 10, nullptr, 10);
+            parallel = true;
+        }
+        else if (argument.rfind("--range=", 0) == 0) {
+            char* lengthStart = nullptr;
+            rangeOffset = std::strtoull(argument.c_str() + 8, &lengthStart, 10);
+            rangeLength = (*lengthStart == ':') ? std::strtoull(lengthStart + 1, nullptr, 10) : 0;
+            ranged = true;
+        }
+        else if (argument.rfind("--level=", 0) == 0) {
+            level = std::atoi(argument.c_str() + 8);
+
+            if (level < Lz77::MIN_LEVEL || level > Lz77::MAX_LEVEL) {
+                std::cerr << "Level must be between " << Lz77::MIN_LEVEL << " and " << Lz77::MAX_LEVEL << ".\n";
+                return 1;
+            }
+        }
+        else if (argument.rfind("--max-code-length=", 0) == 0) {
+            maxCodeLength = std::atoi(argument.c_str() + 18);
+
+            if (maxCodeLength < Rfc1951::MIN_CODE_LENGTH_LIMIT || maxCodeLength > Huffman::MAX_CODE_LENGTH) {
+                std::cerr << "Maximum code length must be between " << Rfc1951::MIN_CODE_LENGTH_LIMIT << " and " << Huffman::MAX_CODE_LENGTH << ".\n";
+                return 1;
+            }
+        }
+        else if (argument.rfind("--huffman-streams=", 0) == 0) {
+            huffmanStreams = std::atoi(argument.c_str() + 18);
+
+            if (huffmanStreams != 1 && huffmanStreams != Huffman::INTERLEAVED_STREAMS) {
+                std::cerr << "Huffman streams must be 1 or " << Huffman::INTERLEAVED_STREAMS << ".\n";
+                return 1;
+            }
+        }
+        else if (argument.rfind("--dictionary=", 0) == 0) {
+            dictionaryPath = argument.substr(13);
+        }
+        else if (argument.rfind("--dictionary-size=", 0) == 0) {
+            dictionarySize = std::strtoull(argument.c_str() + 18, nullptr, 10);
+
+            if (dictionarySize == 0 || dictionarySize > Dictionary::MAX_CONTENT_SIZE) {
+                std::cerr << "Dictionary size must be between 1 and " << Dictionary::MAX_CONTENT_SIZE << " bytes.\n";
+                return 1;
+            }
+        }
+        else if (argument.rfind("--max-output-size=", 0) == 0) {
+            maxResponseSize = std::strtoull(argument.c_str() + 18, nullptr, 10);
+
+            if (maxResponseSize == 0 || maxResponseSize > UINT32_MAX) {
+                std::cerr << "Maximum output size must be between 1 and " << UINT32_MAX << " bytes.\n";
+                return 1;
+            }
+        }
+        else if (argument == "--no-verify") {
+            verify = false;
+        }
+        else if (argument == "--stats" || argument.rfind("--stats=", 0) == 0) {
+            statsFormat = (argument == "--stats") ? "text" : argument.substr(8);
+
+            if (statsFormat != "text" && statsFormat != "json") {
+                std::cerr << "Stats format must be text or json.\n";
+                return 1;
+            }
+        }
+        else if (argument.rfind("--format=", 0) == 0) {
+            format = argument.substr(9);
+
+            if (format != "dfdm" && format != "deflate" && format != "zlib" && format != "gzip") {
+                std::cerr << "Format must be one of dfdm, deflate, zlib or gzip.\n";
+                return 1;
+            }
+        }
+        else {
+            arguments.push_back(argument);
+        }
+    }
+
+    if (!arguments.empty() && arguments[0] == "serve") {
+        DeflateOptions options;
+        options.format = (format == "deflate") ? DeflateFormat::Deflate
+            : (format == "zlib") ? DeflateFormat::Zlib
+            : (format == "gzip") ? DeflateFormat::Gzip
+            : DeflateFormat::Dfdm;
+        options.level = level;
+        options.blockSize = blockSize;
+        options.maxCodeLength = maxCodeLength;
+        options.huffmanStreams = huffmanStreams;
+        std::vector<uint8_t> dictionaryBytes;
+
+        try {
+            if (!dictionaryPath.empty()) {
+                InputFile dictionaryFile(dictionaryPath);
+                std::vector<uint8_t> buffer;
+                size_t size = 0;
+                const uint8_t* data = dictionaryFile.contents(buffer, size);
+                dictionaryBytes.assign(data, data + size);
+
+                options.dictionary = dictionaryBytes.data();
+                options.dictionarySize = dictionaryBytes.size();
+            }
+
+            uint64_t served = serveRequests(options, !format.empty(), verify, maxResponseSize, threadCount);
+            std::cerr << "Serving done! Requests served: " << served << "\n";
+        }
+        catch (const std::exception& error) {
+            std::cerr << error.what() << "\n";
+            return 1;
+        }
+
+        return 0;
+    }
+
+    if (arguments.size() < 3) {
+        std::cerr << "Usage: " << argv[0] << " <action> <inputFilePath> <compressedFilePath> <decompressedFilePath> [--block-size=<bytes>] [--threads=<count>] [--level=<1-11>] [--max-code-length=<9-15>] [--huffman-streams=1|4] [--range=<offset>:<length>] [--format=dfdm|deflate|zlib|gzip] [--dictionary=<path>] [--no-verify] [--stats[=text|json]]\n";
+        std::cerr << "       " << argv[0] << " train <dictionaryPath> <sampleFilePath>... [--dictionary-size=<bytes>] [--level=<1-11>]\n";
+        std::cerr << "       " << argv[0] << " serve [--threads=<count>] [--level=<1-11>] [--format=dfdm|deflate|zlib|gzip] [--dictionary=<path>] [--block-size=<bytes>] [--max-output-size=<bytes>] [--no-verify]\n";
+        std::cerr << "Action options: compress | decompress | train | serve\n";
         return 1;
     }
 
-    std::string action = argv[1];
-    std::string inputFilePath = argv[2];
-    std::string compressedFilePath = argv[3];
-    std::string decompressedFilePath = (argc > 4) ? argv[4] : "";;
+    std::string action = arguments[0];
+    std::string inputFilePath = arguments[1];
+    std::string compressedFilePath = arguments[2];
+    std::string decompressedFilePath = (arguments.size() > 3) ? arguments[3] : "";
 
-    Huffman huffman;
+    Rfc1951::Framing framing = (format == "gzip") ? Rfc1951::Framing::Gzip
+        : (format == "zlib") ? Rfc1951::Framing::Zlib
+        : Rfc1951::Framing::Raw;
 
-    if (action == "compress") {
-        std::cout << "Compressing...\n";
+    try {
+        if (action == "train") {
+            std::vector<std::string> samplePaths(arguments.begin() + 2, arguments.end());
+            uint64_t size = trainDictionary(inputFilePath, samplePaths, dictionarySize, level);
 
-        std::string compressResult = deflateCompress(inputFilePath, compressedFilePath, huffman);
+            std::cout << "Training done! Dictionary size: " << size << " bytes.\n";
+            return 0;
+        }
 
-        std::cout << "Compression done! Compressed data size: " << compressResult.size() << " bytes.\n";
-    } 
-    else if (action == "decompress") {
-        if (decompressedFilePath.empty()) {
-            std::cerr << "For decompression, provide the decompressed file path.\n";
-            return 1;
+        Dictionary dictionary;
+        const Dictionary* preset = nullptr;
+        CodecStats collected;
+        CodecStats* stats = statsFormat.empty() ? nullptr : &collected;
+        AllocationCounter::setEnabled(stats != nullptr);
+        uint64_t allocationsBefore = AllocationCounter::allocations().load();
+        uint64_t allocatedBytesBefore = AllocationCounter::allocatedBytes().load();
+
+        if (!dictionaryPath.empty()) {
+            dictionary = loadDictionary(dictionaryPath);
+            preset = &dictionary;
         }
 
-        std::streampos pos = huffman.loadTreeFromFile(compressedFilePath);
+        if (action == "compress") {
+            if (preset && !format.empty() && format != "dfdm") {
+                std::cerr << "Dictionaries are only supported by the dfdm format.\n";
+                return 1;
+            }
+
+            std::cout << "Compressing...\n";
+
+            uint64_t compressedSize = (!format.empty() && format != "dfdm")
+                ? deflateCompressRfc1951(inputFilePath, compressedFilePath, blockSize, framing, level, maxCodeLength, stats)
+                : parallel
+                ? deflateCompressParallel(inputFilePath, compressedFilePath, blockSize, threadCount, level, maxCodeLength, huffmanStreams, preset, stats)
+                : deflateCompress(inputFilePath, compressedFilePath, blockSize, level, maxCodeLength, huffmanStreams, preset, stats);
+
+            std::cout << "Compression done! Compressed data size: " << compressedSize << " bytes.\n";
+        }
+        else if (action == "decompress") {
+            if (decompressedFilePath.empty()) {
+                std::cerr << "For decompression, provide the decompressed file path.\n";
+                return 1;
+            }
+
+            std::cout << "Decompressing...\n";
+
+            if (format.empty()) {
+                InputFile compressedFile(compressedFilePath);
+                uint8_t magic[4] = {};
+                size_t magicSize = compressedFile.read(0, reinterpret_cast<char*>(magic), sizeof(magic));
 
-        std::cout << "Decompressing...\n";
+                if (std::memcmp(magic, "DFDM", 4) == 0) {
+                    format = "dfdm";
+                }
+                else if (Rfc1951::detectFraming(magic, magicSize, framing)) {
+                    format = (framing == Rfc1951::Framing::Gzip) ? "gzip" : "zlib";
+                }
+                else {
+                    throw std::runtime_error("Unknown compressed format; use --format=deflate for raw DEFLATE data");
+                }
+            }
 
-        std::string decompressResult = deflateDecompress(compressedFilePath, decompressedFilePath, huffman, pos);
+            if (format != "dfdm") {
+                deflateDecompressRfc1951(compressedFilePath, decompressedFilePath, framing, verify, stats);
+            }
+            else if (parallel || ranged) {
+                deflateDecompressIndexed(compressedFilePath, decompressedFilePath, threadCount, rangeOffset, rangeLength, preset, verify, stats);
+            }
+            else {
+                deflateDecompress(compressedFilePath, decompressedFilePath, preset, verify, stats);
+            }
 
-        std::cout << "Decompression done! Output saved to: " << decompressedFilePath << "\n";
+            std::cout << "Decompression done! Output saved to: " << decompressedFilePath << "\n";
+        }
+        else {
+            std::cerr << "Invalid action. Use 'compress', 'decompress', 'train' or 'serve'.\n";
+            return 1;
+        }
+
+        if (stats) {
+            stats->allocations = AllocationCounter::allocations().load() - allocationsBefore;
+            stats->allocatedBytes = AllocationCounter::allocatedBytes().load() - allocatedBytesBefore;
+
+            if (statsFormat == "json") {
+                stats->writeJson(std::cerr);
+            }
+            else {
+                stats->writeText(std::cerr);
+            }
+        }
     }
-    else {
-        std::cerr << "Invalid action. Use 'compress' or 'decompress'.\n";
+    catch (const std::exception& error) {
+        std::cerr << error.what() << "\n";
         return 1;
     }
 
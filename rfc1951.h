@@ -0,0 +1,981 @@
+#ifndef RFC1951_H
+#define RFC1951_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bitstream.h"
+#include "checksum.h"
+#include "codecstats.h"
+#include "huffman.h"
+#include "lz77.h"
+
+/**
+ * @brief Constants and helpers of the DEFLATE format (RFC 1951) and its zlib (RFC 1950) and gzip (RFC 1952) wrappers.
+ */
+class Rfc1951 {
+private:
+    /**
+     * @brief Maps every match length and distance to its DEFLATE symbol.
+     * Distances above 256 are looked up by their high bits, as in zlib.
+     */
+    struct SymbolTables {
+        uint16_t lengthSymbol[Lz77::MAX_MATCH_LENGTH + 1];
+        uint8_t distanceSymbol[512];
+
+        SymbolTables() : lengthSymbol(), distanceSymbol() {
+            for (int symbol = 0; symbol < 29; ++symbol) {
+                int last = (symbol == 28) ? LENGTH_BASE[symbol] : LENGTH_BASE[symbol] + (1 << LENGTH_EXTRA[symbol]) - 1;
+                for (int length = LENGTH_BASE[symbol]; length <= last && length <= Lz77::MAX_MATCH_LENGTH; ++length) {
+                    lengthSymbol[length] = static_cast<uint16_t>(257 + symbol);
+                }
+            }
+
+            for (int symbol = 0; symbol < DISTANCE_SYMBOLS; ++symbol) {
+                int first = DISTANCE_BASE[symbol] - 1;
+                int last = first + (1 << DISTANCE_EXTRA[symbol]) - 1;
+
+                for (int distance = first; distance <= last; ++distance) {
+                    if (distance < 256) {
+                        distanceSymbol[distance] = static_cast<uint8_t>(symbol);
+                    }
+                    else {
+                        distanceSymbol[256 + (distance >> 7)] = static_cast<uint8_t>(symbol);
+                    }
+                }
+            }
+        }
+    };
+
+    /**
+     * @brief Returns the shared symbol lookup tables.
+     * @return The tables, built on first use.
+     */
+    static const SymbolTables& symbolTables() {
+        static const SymbolTables tables;
+        return tables;
+    }
+
+public:
+    enum class Framing { Raw, Zlib, Gzip };
+
+    static constexpr int LITERAL_LENGTH_SYMBOLS = 288;
+    static constexpr int DISTANCE_SYMBOLS = 30;
+    static constexpr int CODE_LENGTH_SYMBOLS = 19;
+    static constexpr int END_OF_BLOCK = 256;
+    static constexpr int MAX_CODE_LENGTH_CODE_LENGTH = 7;
+    static constexpr int MIN_CODE_LENGTH_LIMIT = 9;  ///< The shortest limit that still codes all 286 literal/length symbols.
+    static constexpr size_t MAX_STORED_LENGTH = 65535;
+
+    static constexpr int BLOCK_STORED = 0;
+    static constexpr int BLOCK_FIXED = 1;
+    static constexpr int BLOCK_DYNAMIC = 2;
+
+    static constexpr int CODE_LENGTH_ORDER[CODE_LENGTH_SYMBOLS] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    static constexpr uint16_t LENGTH_BASE[29] = {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+    };
+    static constexpr uint8_t LENGTH_EXTRA[29] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+    };
+    static constexpr uint16_t DISTANCE_BASE[DISTANCE_SYMBOLS] = {
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+    };
+    static constexpr uint8_t DISTANCE_EXTRA[DISTANCE_SYMBOLS] = {
+        0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+    };
+
+    /**
+     * @brief Returns the literal/length symbol of a match length.
+     * @param length A match length between 3 and 258.
+     * @return A symbol between 257 and 285.
+     */
+    static int lengthSymbol(int length) {
+        return symbolTables().lengthSymbol[length];
+    }
+
+    /**
+     * @brief Returns the distance symbol of a match distance.
+     * @param distance A distance between 1 and 32768.
+     * @return A symbol between 0 and 29.
+     */
+    static int distanceSymbol(int distance) {
+        const SymbolTables& tables = symbolTables();
+        return (distance <= 256) ? tables.distanceSymbol[distance - 1] : tables.distanceSymbol[256 + ((distance - 1) >> 7)];
+    }
+
+    /**
+     * @brief Returns the code lengths of the fixed literal/length code.
+     * @return 288 lengths as defined in RFC 1951, section 3.2.6.
+     */
+    static std::vector<int> fixedLiteralLengths() {
+        std::vector<int> lengths(LITERAL_LENGTH_SYMBOLS, 8);
+        std::fill(lengths.begin() + 144, lengths.begin() + 256, 9);
+        std::fill(lengths.begin() + 256, lengths.begin() + 280, 7);
+        return lengths;
+    }
+
+    /**
+     * @brief Returns the code lengths of the fixed distance code.
+     * @return 30 lengths of 5 bits.
+     */
+    static std::vector<int> fixedDistanceLengths() {
+        return std::vector<int>(DISTANCE_SYMBOLS, 5);
+    }
+
+    /**
+     * @brief Appends the wrapper header that precedes the DEFLATE data.
+     * The header also records whether a fast or a strong compression level was used, as zlib does.
+     * @param out The buffer to append to.
+     * @param framing The wrapper; nothing is written for raw DEFLATE.
+     * @param level The compression level of the data.
+     */
+    static void writeHeader(std::vector<uint8_t>& out, Framing framing, int level) {
+        if (framing == Framing::Gzip) {
+            uint8_t extraFlags = (level >= 9) ? 2 : (level == Lz77::MIN_LEVEL) ? 4 : 0;
+            const uint8_t header[10] = { 0x1F, 0x8B, 8, 0, 0, 0, 0, 0, extraFlags, 255 };
+            out.insert(out.end(), header, header + 10);
+        }
+        else if (framing == Framing::Zlib) {
+            int levelFlags = (level < 2) ? 0 : (level < 6) ? 1 : (level == 6) ? 2 : 3;
+            int header = (0x78 << 8) | (levelFlags << 6);
+            header += 31 - header % 31;
+
+            out.push_back(static_cast<uint8_t>(header >> 8));
+            out.push_back(static_cast<uint8_t>(header));
+        }
+    }
+
+    /**
+     * @brief Appends the wrapper trailer that follows the DEFLATE data.
+     * @param out The buffer to append to.
+     * @param framing The wrapper; nothing is written for raw DEFLATE.
+     * @param checksum The CRC-32 (gzip) or Adler-32 (zlib) of the uncompressed data.
+     * @param rawSize The uncompressed size; gzip stores it modulo 2^32.
+     */
+    static void writeTrailer(std::vector<uint8_t>& out, Framing framing, uint32_t checksum, uint64_t rawSize) {
+        if (framing == Framing::Gzip) {
+            for (int i = 0; i < 4; ++i) {
+                out.push_back(static_cast<uint8_t>(checksum >> (8 * i)));
+            }
+            for (int i = 0; i < 4; ++i) {
+                out.push_back(static_cast<uint8_t>(rawSize >> (8 * i)));
+            }
+        }
+        else if (framing == Framing::Zlib) {
+            for (int i = 3; i >= 0; --i) {
+                out.push_back(static_cast<uint8_t>(checksum >> (8 * i)));
+            }
+        }
+    }
+
+    /**
+     * @brief Returns the size of the wrapper trailer.
+     * @param framing The wrapper.
+     * @return 8 for gzip, 4 for zlib, 0 for raw DEFLATE.
+     */
+    static size_t trailerSize(Framing framing) {
+        return (framing == Framing::Gzip) ? 8 : (framing == Framing::Zlib) ? 4 : 0;
+    }
+
+    /**
+     * @brief Checks a wrapper header and skips its optional fields.
+     * @param data The start of the compressed data.
+     * @param size The number of bytes available.
+     * @param framing The expected wrapper.
+     * @return The header size, i.e. the offset of the DEFLATE data.
+     * @throws std::runtime_error if the header is invalid or uses unsupported features.
+     */
+    static size_t parseHeader(const uint8_t* data, size_t size, Framing framing) {
+        if (framing == Framing::Zlib) {
+            if (size < 2 || (data[0] & 0x0F) != 8 || (data[0] >> 4) > 7 || ((data[0] << 8) | data[1]) % 31 != 0) {
+                throw std::runtime_error("Invalid zlib header");
+            }
+
+            if (data[1] & 0x20) {
+                throw std::runtime_error("zlib streams with a preset dictionary are not supported");
+            }
+
+            return 2;
+        }
+
+        if (framing != Framing::Gzip) {
+            return 0;
+        }
+
+        if (size < 10 || data[0] != 0x1F || data[1] != 0x8B || data[2] != 8) {
+            throw std::runtime_error("Invalid gzip header");
+        }
+
+        uint8_t flags = data[3];
+        size_t pos = 10;
+
+        if (flags & 0x04) {
+            if (size < pos + 2) {
+                throw std::runtime_error("Truncated gzip header");
+            }
+            pos += 2 + (data[pos] | (data[pos + 1] << 8));
+        }
+
+        for (uint8_t stringFlag : { uint8_t(0x08), uint8_t(0x10) }) {
+            if (flags & stringFlag) {
+                while (pos < size && data[pos] != 0) {
+                    pos++;
+                }
+                pos++;
+            }
+        }
+
+        if (flags & 0x02) {
+            pos += 2;
+        }
+
+        if (pos > size) {
+            throw std::runtime_error("Truncated gzip header");
+        }
+
+        return pos;
+    }
+
+    /**
+     * @brief Guesses the wrapper of compressed data from its first bytes.
+     * @param data The start of the compressed data.
+     * @param size The number of bytes available.
+     * @param framing Receives the detected wrapper.
+     * @return false if the data starts with neither a gzip nor a zlib header.
+     */
+    static bool detectFraming(const uint8_t* data, size_t size, Framing& framing) {
+        if (size >= 2 && data[0] == 0x1F && data[1] == 0x8B) {
+            framing = Framing::Gzip;
+            return true;
+        }
+
+        if (size >= 2 && (data[0] & 0x0F) == 8 && (data[0] >> 4) <= 7 && ((data[0] << 8) | data[1]) % 31 == 0) {
+            framing = Framing::Zlib;
+            return true;
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Returns the checksum value a wrapper trailer starts from.
+     * @param framing The wrapper.
+     * @return The Adler-32 start value for zlib, the CRC-32 start value otherwise.
+     */
+    static uint32_t initialChecksum(Framing framing) {
+        return (framing == Framing::Zlib) ? Checksum::ADLER32_INIT : Checksum::CRC32_INIT;
+    }
+
+    /**
+     * @brief Updates the checksum that a gzip or zlib trailer carries.
+     * @param framing The wrapper; raw DEFLATE has no checksum.
+     * @param checksum The checksum of the preceding data.
+     * @param data The next bytes.
+     * @param size The number of bytes.
+     * @return The updated checksum.
+     */
+    static uint32_t updateChecksum(Framing framing, uint32_t checksum, const char* data, size_t size) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+
+        if (framing == Framing::Gzip) {
+            return Checksum::crc32(checksum, bytes, size);
+        }
+
+        if (framing == Framing::Zlib) {
+            return Checksum::adler32(checksum, bytes, size);
+        }
+
+        return checksum;
+    }
+
+    /**
+     * @brief Compares a wrapper trailer with the checksum and size of the decoded data.
+     * @param framing The wrapper.
+     * @param trailer Points at trailerSize(framing) bytes.
+     * @param checksum The checksum of the decoded data.
+     * @param rawSize The size of the decoded data.
+     * @param verifyChecksum Whether to compare the checksum; false skips it for trusted data, leaving the gzip size check.
+     * @throws std::runtime_error if they do not match.
+     */
+    static void checkTrailer(Framing framing, const uint8_t* trailer, uint32_t checksum, uint64_t rawSize, bool verifyChecksum = true) {
+        if (framing == Framing::Gzip) {
+            uint32_t expectedChecksum = 0;
+            uint32_t expectedSize = 0;
+            for (int i = 3; i >= 0; --i) {
+                expectedChecksum = (expectedChecksum << 8) | trailer[i];
+                expectedSize = (expectedSize << 8) | trailer[4 + i];
+            }
+
+            if ((verifyChecksum && expectedChecksum != checksum) || expectedSize != static_cast<uint32_t>(rawSize)) {
+                throw std::runtime_error("gzip checksum mismatch: the data is corrupt");
+            }
+        }
+        else if (framing == Framing::Zlib) {
+            uint32_t expectedChecksum = 0;
+            for (int i = 0; i < 4; ++i) {
+                expectedChecksum = (expectedChecksum << 8) | trailer[i];
+            }
+
+            if (verifyChecksum && expectedChecksum != checksum) {
+                throw std::runtime_error("zlib checksum mismatch: the data is corrupt");
+            }
+        }
+    }
+};
+
+/**
+ * @brief Prices of LZ77 tokens in a dynamic-Huffman DEFLATE block, for optimal parsing.
+ * Symbol prices are estimated from the symbol frequencies of a previous parse; extra bits cost what
+ * they are.
+ */
+class DeflatePrices {
+private:
+    uint32_t literalPrices[Rfc1951::LITERAL_LENGTH_SYMBOLS];
+    uint32_t distancePrices[Rfc1951::DISTANCE_SYMBOLS];
+
+public:
+    /**
+     * @brief Constructor starts from the code lengths of the fixed Huffman code.
+     */
+    DeflatePrices() {
+        std::vector<int> literalLengths = Rfc1951::fixedLiteralLengths();
+        for (int symbol = 0; symbol < Rfc1951::LITERAL_LENGTH_SYMBOLS; ++symbol) {
+            literalPrices[symbol] = literalLengths[symbol] * Lz77::PRICE_SCALE;
+        }
+        std::fill(distancePrices, distancePrices + Rfc1951::DISTANCE_SYMBOLS, 5 * Lz77::PRICE_SCALE);
+    }
+
+    /**
+     * @brief Re-estimates the symbol prices from the symbols a parse would produce.
+     * @param tokens The tokens of a parse of the block.
+     */
+    void update(const std::vector<Lz77::Lz77Code>& tokens) {
+        uint32_t literalCounts[Rfc1951::LITERAL_LENGTH_SYMBOLS] = {};
+        uint32_t distanceCounts[Rfc1951::DISTANCE_SYMBOLS] = {};
+
+        for (const Lz77::Lz77Code& token : tokens) {
+            if (token.length > 0) {
+                literalCounts[Rfc1951::lengthSymbol(token.length)]++;
+                distanceCounts[Rfc1951::distanceSymbol(token.offSet)]++;
+            }
+            literalCounts[static_cast<unsigned char>(token.nextChar)]++;
+        }
+
+        Lz77::pricesFromCounts(literalCounts, Rfc1951::LITERAL_LENGTH_SYMBOLS - 2, literalPrices);
+        Lz77::pricesFromCounts(distanceCounts, Rfc1951::DISTANCE_SYMBOLS, distancePrices);
+    }
+
+    uint64_t noMatchPrice() const {
+        return 0;
+    }
+
+    uint64_t literalPrice(unsigned char literal) const {
+        return literalPrices[literal];
+    }
+
+    uint64_t lengthPrice(int length) const {
+        int symbol = Rfc1951::lengthSymbol(length);
+        return literalPrices[symbol] + Rfc1951::LENGTH_EXTRA[symbol - 257] * Lz77::PRICE_SCALE;
+    }
+
+    uint64_t offsetPrice(int offset) const {
+        int symbol = Rfc1951::distanceSymbol(offset);
+        return distancePrices[symbol] + Rfc1951::DISTANCE_EXTRA[symbol] * Lz77::PRICE_SCALE;
+    }
+};
+
+/**
+ * @brief Produces an RFC 1951 bit stream from LZ77 tokens.
+ *
+ * Every call to encodeBlock turns one piece of input into DEFLATE blocks. The block type is whichever
+ * is smallest for that piece: a dynamic-Huffman block with its own codes, a fixed-Huffman block, or
+ * stored blocks of at most 65535 bytes.
+ */
+class DeflateEncoder {
+private:
+    Lz77 lz77;
+    DeflatePrices prices;
+    std::vector<Lz77::Lz77Code> tokens;
+    Huffman literalCode;
+    Huffman distanceCode;
+    Huffman codeLengthCode;
+    Huffman fixedLiteralCode;
+    Huffman fixedDistanceCode;
+    BitWriter writer;
+    CodecStats* stats;
+    int maxCodeLength;
+    uint64_t unlimitedBits;
+    uint64_t limitedBits;
+
+    /**
+     * @brief Counts the extra bits that follow length and distance symbols.
+     * @param literalFrequencies Literal/length symbol counts.
+     * @param distanceFrequencies Distance symbol counts.
+     * @return The number of extra bits.
+     */
+    static uint64_t extraBits(const std::vector<uint32_t>& literalFrequencies, const std::vector<uint32_t>& distanceFrequencies) {
+        uint64_t bits = 0;
+
+        for (int symbol = 0; symbol < 29; ++symbol) {
+            bits += static_cast<uint64_t>(literalFrequencies[257 + symbol]) * Rfc1951::LENGTH_EXTRA[symbol];
+        }
+
+        for (int symbol = 0; symbol < Rfc1951::DISTANCE_SYMBOLS; ++symbol) {
+            bits += static_cast<uint64_t>(distanceFrequencies[symbol]) * Rfc1951::DISTANCE_EXTRA[symbol];
+        }
+
+        return bits;
+    }
+
+    /**
+     * @brief Computes the size of the Huffman-coded symbols for given codes.
+     * @param frequencies Symbol counts.
+     * @param lengths Code lengths for the same symbols.
+     * @return The number of bits.
+     */
+    static uint64_t codedBits(const std::vector<uint32_t>& frequencies, const std::vector<int>& lengths) {
+        uint64_t bits = 0;
+
+        for (size_t symbol = 0; symbol < frequencies.size(); ++symbol) {
+            bits += static_cast<uint64_t>(frequencies[symbol]) * lengths[symbol];
+        }
+
+        return bits;
+    }
+
+    /**
+     * @brief Writes the code definitions of a dynamic block (HLIT, HDIST, HCLEN and the coded lengths).
+     * @param out The bit stream that receives the header.
+     */
+    void writeDynamicHeader(BitWriter& out) {
+        const std::vector<int>& literalLengths = literalCode.getCodeLengths();
+        const std::vector<int>& distanceLengths = distanceCode.getCodeLengths();
+
+        int literalCount = 286;
+        while (literalCount > 257 && literalLengths[literalCount - 1] == 0) {
+            literalCount--;
+        }
+
+        int distanceCount = Rfc1951::DISTANCE_SYMBOLS;
+        while (distanceCount > 1 && distanceLengths[distanceCount - 1] == 0) {
+            distanceCount--;
+        }
+
+        std::vector<int> lengths(literalLengths.begin(), literalLengths.begin() + literalCount);
+        lengths.insert(lengths.end(), distanceLengths.begin(), distanceLengths.begin() + distanceCount);
+
+        std::vector<std::pair<int, int>> symbols = Huffman::runLengthCodeLengths(lengths.data(), static_cast<int>(lengths.size()));
+        std::vector<uint32_t> codeLengthFrequencies(Rfc1951::CODE_LENGTH_SYMBOLS, 0);
+        for (const auto& symbol : symbols) {
+            codeLengthFrequencies[symbol.first]++;
+        }
+
+        codeLengthCode.buildFromFrequencies(codeLengthFrequencies, Rfc1951::MAX_CODE_LENGTH_CODE_LENGTH);
+        const std::vector<int>& codeLengthLengths = codeLengthCode.getCodeLengths();
+
+        int codeLengthCount = Rfc1951::CODE_LENGTH_SYMBOLS;
+        while (codeLengthCount > 4 && codeLengthLengths[Rfc1951::CODE_LENGTH_ORDER[codeLengthCount - 1]] == 0) {
+            codeLengthCount--;
+        }
+
+        out.writeBits(literalCount - 257, 5);
+        out.writeBits(distanceCount - 1, 5);
+        out.writeBits(codeLengthCount - 4, 4);
+
+        for (int i = 0; i < codeLengthCount; ++i) {
+            out.writeBits(codeLengthLengths[Rfc1951::CODE_LENGTH_ORDER[i]], 3);
+        }
+
+        for (const auto& symbol : symbols) {
+            codeLengthCode.encodeSymbol(out, symbol.first);
+            out.writeBits(symbol.second, Huffman::codeLengthExtraBits(symbol.first));
+        }
+    }
+
+    /**
+     * @brief Writes the tokens of a block followed by the end-of-block symbol.
+     * @param tokens The LZ77 tokens.
+     * @param literals The literal/length code.
+     * @param distances The distance code.
+     */
+    void writeTokens(const std::vector<Lz77::Lz77Code>& tokens, const Huffman& literals, const Huffman& distances) {
+        for (const Lz77::Lz77Code& token : tokens) {
+            if (token.length > 0) {
+                int lengthSymbol = Rfc1951::lengthSymbol(token.length);
+                literals.encodeSymbol(writer, lengthSymbol);
+                writer.writeBits(token.length - Rfc1951::LENGTH_BASE[lengthSymbol - 257], Rfc1951::LENGTH_EXTRA[lengthSymbol - 257]);
+
+                int distanceSymbol = Rfc1951::distanceSymbol(token.offSet);
+                distances.encodeSymbol(writer, distanceSymbol);
+                writer.writeBits(token.offSet - Rfc1951::DISTANCE_BASE[distanceSymbol], Rfc1951::DISTANCE_EXTRA[distanceSymbol]);
+            }
+
+            literals.encodeSymbol(writer, static_cast<unsigned char>(token.nextChar));
+        }
+
+        literals.encodeSymbol(writer, Rfc1951::END_OF_BLOCK);
+    }
+
+    /**
+     * @brief Writes raw bytes as stored blocks of at most 65535 bytes.
+     * @param data The bytes to store.
+     * @param size The number of bytes.
+     * @param finalBlock Whether the last stored block ends the stream.
+     */
+    void writeStored(const uint8_t* data, size_t size, bool finalBlock) {
+        do {
+            size_t length = std::min(size, Rfc1951::MAX_STORED_LENGTH);
+            size -= length;
+
+            writer.writeBits((finalBlock && size == 0) ? 1 : 0, 1);
+            writer.writeBits(Rfc1951::BLOCK_STORED, 2);
+            writer.alignToByte();
+            writer.writeBits(length, 16);
+            writer.writeBits(~length & 0xFFFF, 16);
+            writer.writeAlignedBytes(data, length);
+
+            data += length;
+        } while (size > 0);
+    }
+
+public:
+    /**
+     * @brief Constructor prepares the fixed codes.
+     * @param level The compression level, between Lz77::MIN_LEVEL and Lz77::MAX_LEVEL.
+     */
+    explicit DeflateEncoder(int level = Lz77::DEFAULT_LEVEL)
+        : lz77(level), literalCode(Rfc1951::LITERAL_LENGTH_SYMBOLS), distanceCode(Rfc1951::DISTANCE_SYMBOLS),
+        codeLengthCode(Rfc1951::CODE_LENGTH_SYMBOLS), fixedLiteralCode(Rfc1951::LITERAL_LENGTH_SYMBOLS),
+        fixedDistanceCode(Rfc1951::DISTANCE_SYMBOLS), stats(nullptr), maxCodeLength(Huffman::MAX_CODE_LENGTH),
+        unlimitedBits(0), limitedBits(0) {
+        fixedLiteralCode.buildFromLengths(Rfc1951::fixedLiteralLengths());
+        fixedDistanceCode.buildFromLengths(Rfc1951::fixedDistanceLengths());
+    }
+
+    /**
+     * @brief Switches to another compression level for the following blocks.
+     * @param level The compression level, between Lz77::MIN_LEVEL and Lz77::MAX_LEVEL.
+     */
+    void setLevel(int level) {
+        lz77.setLevel(level);
+    }
+
+    /**
+     * @brief Limits the literal/length and distance code lengths of the following dynamic blocks.
+     * Shorter limits keep every code inside a decoder's first table lookup, at some cost in ratio.
+     * @param length The longest code allowed, between Rfc1951::MIN_CODE_LENGTH_LIMIT and Huffman::MAX_CODE_LENGTH.
+     */
+    void setMaxCodeLength(int length) {
+        maxCodeLength = length;
+    }
+
+    /**
+     * @brief Collects timings and counters of the following blocks.
+     * @param target The stats to add to, or nullptr to stop collecting.
+     */
+    void setStats(CodecStats* target) {
+        stats = target;
+    }
+
+    /**
+     * @brief Reports how much the code length limit has cost over all blocks encoded so far.
+     * @param unlimited Receives the size in bits of the literal/length and distance codes with unlimited lengths.
+     * @param limited Receives their size in bits with the limited codes.
+     */
+    void getLengthLimitCost(uint64_t& unlimited, uint64_t& limited) const {
+        unlimited = unlimitedBits;
+        limited = limitedBits;
+    }
+
+    /**
+     * @brief Compresses the tail of a window into DEFLATE blocks.
+     * @param window Earlier data used as history, followed by the bytes to compress.
+     * @param windowSize The number of bytes in window.
+     * @param start The position of the first byte to compress.
+     * @param finalBlock Whether these are the last blocks of the stream.
+     */
+    void encodeBlock(const char* window, size_t windowSize, size_t start, bool finalBlock) {
+        {
+            CodecStats::Timer timer(stats, CodecStats::STAGE_LZ77);
+            lz77.lz77Compress(window, windowSize, start, prices, tokens);
+        }
+
+        CodecStats::Timer buildTimer(stats, CodecStats::STAGE_HUFFMAN_BUILD);
+        std::vector<uint32_t> literalFrequencies(Rfc1951::LITERAL_LENGTH_SYMBOLS, 0);
+        std::vector<uint32_t> distanceFrequencies(Rfc1951::DISTANCE_SYMBOLS, 0);
+
+        for (const Lz77::Lz77Code& token : tokens) {
+            if (token.length > 0) {
+                literalFrequencies[Rfc1951::lengthSymbol(token.length)]++;
+                distanceFrequencies[Rfc1951::distanceSymbol(token.offSet)]++;
+            }
+            literalFrequencies[static_cast<unsigned char>(token.nextChar)]++;
+        }
+        literalFrequencies[Rfc1951::END_OF_BLOCK]++;
+
+        uint64_t extra = extraBits(literalFrequencies, distanceFrequencies);
+        uint64_t fixedBits = 3 + codedBits(literalFrequencies, Rfc1951::fixedLiteralLengths()) +
+            codedBits(distanceFrequencies, Rfc1951::fixedDistanceLengths()) + extra;
+
+        size_t rawSize = windowSize - start;
+        uint64_t storedBits = 8 * (static_cast<uint64_t>(rawSize) + 5 * std::max<uint64_t>(1, (rawSize + Rfc1951::MAX_STORED_LENGTH - 1) / Rfc1951::MAX_STORED_LENGTH)) + 7;
+
+        // Decoders expect at least two codes in each tree, as zlib always writes them.
+        for (std::vector<uint32_t>* frequencies : { &literalFrequencies, &distanceFrequencies }) {
+            int used = 0;
+            for (uint32_t frequency : *frequencies) {
+                used += (frequency > 0) ? 1 : 0;
+            }
+            for (size_t symbol = 0; used < 2; ++symbol) {
+                if ((*frequencies)[symbol] == 0) {
+                    (*frequencies)[symbol] = 1;
+                    used++;
+                }
+            }
+        }
+
+        literalCode.buildFromFrequencies(literalFrequencies, maxCodeLength);
+        distanceCode.buildFromFrequencies(distanceFrequencies, maxCodeLength);
+
+        for (const Huffman* code : { &literalCode, &distanceCode }) {
+            uint64_t codeUnlimited = 0;
+            uint64_t codeLimited = 0;
+            code->getLengthLimitCost(codeUnlimited, codeLimited);
+            unlimitedBits += codeUnlimited;
+            limitedBits += codeLimited;
+        }
+
+        BitWriter header;
+        writeDynamicHeader(header);
+        uint64_t dynamicBits = 3 + header.bitsWritten() + codedBits(literalFrequencies, literalCode.getCodeLengths()) +
+            codedBits(distanceFrequencies, distanceCode.getCodeLengths()) + extra;
+
+        buildTimer.stop();
+        CodecStats::Timer encodeTimer(stats, CodecStats::STAGE_HUFFMAN_ENCODE);
+        uint64_t bitsBefore = writer.bitsWritten();
+
+        if (storedBits <= dynamicBits && storedBits <= fixedBits) {
+            writeStored(reinterpret_cast<const uint8_t*>(window) + start, rawSize, finalBlock);
+        }
+        else if (fixedBits <= dynamicBits) {
+            writer.writeBits(finalBlock ? 1 : 0, 1);
+            writer.writeBits(Rfc1951::BLOCK_FIXED, 2);
+            writeTokens(tokens, fixedLiteralCode, fixedDistanceCode);
+        }
+        else {
+            writer.writeBits(finalBlock ? 1 : 0, 1);
+            writer.writeBits(Rfc1951::BLOCK_DYNAMIC, 2);
+            writeDynamicHeader(writer);
+            writeTokens(tokens, literalCode, distanceCode);
+        }
+
+        if (stats) {
+            stats->blocks++;
+            stats->addTokens(tokens);
+            stats->addCodeLengths(literalCode.getCodeLengths());
+            stats->addCodeLengths(distanceCode.getCodeLengths());
+            stats->addBytes(CodecStats::STAGE_LZ77, rawSize, 0);
+            stats->addBytes(CodecStats::STAGE_HUFFMAN_ENCODE, rawSize, (writer.bitsWritten() - bitsBefore) / 8);
+        }
+    }
+
+    /**
+     * @brief Hands over the complete bytes of the stream produced so far.
+     * @return The bytes; a partial last byte stays in the encoder.
+     */
+    std::vector<uint8_t> takeOutput() {
+        return writer.takeCompleteBytes();
+    }
+
+    /**
+     * @brief Pads the stream to a byte boundary after the final block and hands over the rest.
+     * @return The remaining bytes of the stream.
+     */
+    std::vector<uint8_t> finish() {
+        return writer.take();
+    }
+
+    /**
+     * @brief Drops the output of an unfinished stream so that the next block starts a new one.
+     */
+    void reset() {
+        writer = BitWriter();
+    }
+};
+
+/**
+ * @brief Decodes an RFC 1951 bit stream with stored, fixed and dynamic blocks.
+ * Output goes either straight into a caller-provided buffer or, for streaming, through a 1 MB window
+ * that is handed to a sink whenever it fills, keeping the last 32 KB as match history.
+ */
+class Inflater {
+private:
+    static constexpr size_t HISTORY_SIZE = 32768;
+    static constexpr size_t FLUSH_SIZE = 1 << 20;
+
+    /**
+     * @brief Where decoded bytes go. Bytes before position are match history.
+     * blockDecoded, if set, is handed the bytes of every block as it ends, while they are still in cache.
+     */
+    struct Output {
+        char* data;
+        size_t capacity;
+        size_t position;
+        std::function<void(Output&)> makeRoom;
+        std::function<void(const char*, size_t)> blockDecoded;
+
+        /**
+         * @brief Makes sure that the next bytes fit, flushing or failing if they do not.
+         * @param count The number of bytes about to be written.
+         */
+        void reserve(size_t count) {
+            if (count > capacity - position) {
+                makeRoom(*this);
+            }
+        }
+    };
+
+    Huffman literalCode;
+    Huffman distanceCode;
+    Huffman codeLengthCode;
+    Huffman fixedLiteralCode;
+    Huffman fixedDistanceCode;
+    /**
+     * @brief Reads the code definitions of a dynamic block.
+     * @param reader The bit stream positioned after the block type.
+     */
+    void readDynamicHeader(BitReader& reader) {
+        int literalCount = static_cast<int>(reader.readBits(5)) + 257;
+        int distanceCount = static_cast<int>(reader.readBits(5)) + 1;
+        int codeLengthCount = static_cast<int>(reader.readBits(4)) + 4;
+
+        if (literalCount > 286 || distanceCount > Rfc1951::DISTANCE_SYMBOLS) {
+            throw std::runtime_error("Invalid DEFLATE block: too many codes");
+        }
+
+        std::vector<int> codeLengthLengths(Rfc1951::CODE_LENGTH_SYMBOLS, 0);
+        for (int i = 0; i < codeLengthCount; ++i) {
+            codeLengthLengths[Rfc1951::CODE_LENGTH_ORDER[i]] = static_cast<int>(reader.readBits(3));
+        }
+        codeLengthCode.buildFromLengths(codeLengthLengths);
+
+        std::vector<int> lengths(literalCount + distanceCount, 0);
+        int count = 0;
+
+        while (count < literalCount + distanceCount) {
+            int symbol = codeLengthCode.decodeSymbol(reader);
+
+            if (symbol < 16) {
+                lengths[count++] = symbol;
+                continue;
+            }
+
+            int repeat = 0;
+            int length = 0;
+
+            if (symbol == 16) {
+                if (count == 0) {
+                    throw std::runtime_error("Invalid DEFLATE block: repeat without a previous length");
+                }
+                length = lengths[count - 1];
+                repeat = 3 + static_cast<int>(reader.readBits(2));
+            }
+            else if (symbol == 17) {
+                repeat = 3 + static_cast<int>(reader.readBits(3));
+            }
+            else {
+                repeat = 11 + static_cast<int>(reader.readBits(7));
+            }
+
+            if (count + repeat > literalCount + distanceCount) {
+                throw std::runtime_error("Invalid DEFLATE block: too many code lengths");
+            }
+
+            std::fill(lengths.begin() + count, lengths.begin() + count + repeat, length);
+            count += repeat;
+        }
+
+        if (lengths[Rfc1951::END_OF_BLOCK] == 0) {
+            throw std::runtime_error("Invalid DEFLATE block: no end-of-block code");
+        }
+
+        literalCode.buildFromLengths(std::vector<int>(lengths.begin(), lengths.begin() + literalCount));
+        distanceCode.buildFromLengths(std::vector<int>(lengths.begin() + literalCount, lengths.end()));
+    }
+
+    /**
+     * @brief Decodes the symbols of one Huffman block.
+     * @param reader The bit stream positioned at the first symbol.
+     * @param literals The literal/length code.
+     * @param distances The distance code.
+     * @param output Receives the decoded bytes.
+     */
+    static void inflateCodes(BitReader& reader, const Huffman& literals, const Huffman& distances, Output& output) {
+        while (true) {
+            int symbol = literals.decodeSymbol(reader);
+
+            if (symbol < 256) {
+                output.reserve(1);
+                output.data[output.position++] = static_cast<char>(symbol);
+            }
+            else if (symbol == Rfc1951::END_OF_BLOCK) {
+                return;
+            }
+            else {
+                symbol -= 257;
+                if (symbol >= 29) {
+                    throw std::runtime_error("Invalid DEFLATE block: bad length symbol");
+                }
+
+                size_t length = Rfc1951::LENGTH_BASE[symbol] + reader.readBits(Rfc1951::LENGTH_EXTRA[symbol]);
+
+                int distanceSymbol = distances.decodeSymbol(reader);
+                if (distanceSymbol >= Rfc1951::DISTANCE_SYMBOLS) {
+                    throw std::runtime_error("Invalid DEFLATE block: bad distance symbol");
+                }
+
+                size_t distance = Rfc1951::DISTANCE_BASE[distanceSymbol] + reader.readBits(Rfc1951::DISTANCE_EXTRA[distanceSymbol]);
+
+                output.reserve(length);
+
+                if (distance > output.position) {
+                    throw std::runtime_error("Invalid DEFLATE block: distance too far back");
+                }
+
+                ByteKernels::copyMatch(output.data + output.position, distance, length, output.capacity - output.position);
+                output.position += length;
+            }
+
+            if (reader.isOverrun()) {
+                throw std::runtime_error("Unexpected end of DEFLATE data");
+            }
+        }
+    }
+
+    /**
+     * @brief Decodes blocks up to and including the final one.
+     * @param data The compressed bytes.
+     * @param size The number of bytes available.
+     * @param output Receives the decoded bytes.
+     * @return The number of bytes the stream occupies.
+     */
+    size_t inflateBlocks(const uint8_t* data, size_t size, Output& output) {
+        BitReader reader(data, size);
+        bool finalBlock = false;
+
+        while (!finalBlock) {
+            size_t blockStart = output.position;
+            finalBlock = reader.readBits(1) != 0;
+            int type = static_cast<int>(reader.readBits(2));
+
+            if (type == Rfc1951::BLOCK_STORED) {
+                reader.alignToByte();
+                size_t length = static_cast<size_t>(reader.readBits(16));
+                size_t lengthComplement = static_cast<size_t>(reader.readBits(16));
+
+                if (length != (~lengthComplement & 0xFFFF)) {
+                    throw std::runtime_error("Invalid DEFLATE block: stored length mismatch");
+                }
+
+                output.reserve(length);
+
+                if (!reader.readAlignedBytes(reinterpret_cast<uint8_t*>(output.data + output.position), length)) {
+                    throw std::runtime_error("Unexpected end of DEFLATE data");
+                }
+                output.position += length;
+            }
+            else if (type == Rfc1951::BLOCK_FIXED) {
+                inflateCodes(reader, fixedLiteralCode, fixedDistanceCode, output);
+            }
+            else if (type == Rfc1951::BLOCK_DYNAMIC) {
+                readDynamicHeader(reader);
+                inflateCodes(reader, literalCode, distanceCode, output);
+            }
+            else {
+                throw std::runtime_error("Invalid DEFLATE block type");
+            }
+
+            if (reader.isOverrun()) {
+                throw std::runtime_error("Unexpected end of DEFLATE data");
+            }
+
+            if (output.blockDecoded) {
+                output.blockDecoded(output.data + blockStart, output.position - blockStart);
+            }
+        }
+
+        reader.alignToByte();
+        return static_cast<size_t>(reader.bitsConsumed() / 8);
+    }
+
+public:
+    /**
+     * @brief Constructor prepares the fixed codes.
+     */
+    Inflater()
+        : literalCode(Rfc1951::LITERAL_LENGTH_SYMBOLS), distanceCode(Rfc1951::DISTANCE_SYMBOLS),
+        codeLengthCode(Rfc1951::CODE_LENGTH_SYMBOLS), fixedLiteralCode(Rfc1951::LITERAL_LENGTH_SYMBOLS),
+        fixedDistanceCode(Rfc1951::DISTANCE_SYMBOLS) {
+        fixedLiteralCode.buildFromLengths(Rfc1951::fixedLiteralLengths());
+        fixedDistanceCode.buildFromLengths(Rfc1951::fixedDistanceLengths());
+    }
+
+    /**
+     * @brief Decodes one DEFLATE stream, up to and including its final block.
+     * @param data The compressed bytes.
+     * @param size The number of bytes available; data after the stream is left alone.
+     * @param sink Receives the decompressed data in order, in pieces of about 1 MB.
+     * @return The number of bytes the stream occupies, so a wrapper trailer can be read after it.
+     */
+    size_t inflate(const uint8_t* data, size_t size, const std::function<void(const char*, size_t)>& sink) {
+        std::vector<char> window(HISTORY_SIZE + FLUSH_SIZE);
+        size_t flushed = 0;
+
+        Output output{ window.data(), window.size(), 0, [&](Output& full) {
+            sink(full.data + flushed, full.position - flushed);
+
+            size_t keep = std::min(full.position, HISTORY_SIZE);
+            std::memmove(full.data, full.data + full.position - keep, keep);
+            full.position = keep;
+            flushed = keep;
+        }, nullptr };
+
+        size_t consumed = inflateBlocks(data, size, output);
+        sink(output.data + flushed, output.position - flushed);
+
+        return consumed;
+    }
+
+    /**
+     * @brief Decodes one DEFLATE stream straight into a caller-provided buffer.
+     * @param data The compressed bytes.
+     * @param size The number of bytes available; data after the stream is left alone.
+     * @param output The output buffer.
+     * @param capacity The size of the output buffer.
+     * @param decodedSize Receives the number of decompressed bytes.
+     * @param blockDecoded Called with the decoded bytes of every block as it ends, e.g. to checksum
+     * them while they are in cache; may be empty.
+     * @return The number of bytes the stream occupies, so a wrapper trailer can be read after it.
+     * @throws std::runtime_error if the data is invalid or does not fit.
+     */
+    size_t inflate(const uint8_t* data, size_t size, char* output, size_t capacity, size_t& decodedSize,
+        const std::function<void(const char*, size_t)>& blockDecoded = nullptr) {
+        Output span{ output, capacity, 0, [](Output&) {
+            throw std::runtime_error("Decompressed data does not fit the output buffer");
+        }, blockDecoded };
+
+        size_t consumed = inflateBlocks(data, size, span);
+        decodedSize = span.position;
+
+        return consumed;
+    }
+};
+
+#endif
@@ -0,0 +1,895 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/wait.h>
+#endif
+
+#include "archivereader.h"
+#include "bitstream.h"
+#include "checksum.h"
+#include "corpus.h"
+#include "deflate_dm.h"
+#include "dictionary.h"
+#include "filemanager.h"
+#include "huffman.h"
+#include "lz77.h"
+
+/**
+ * @brief Block size of the round trips; small enough that most inputs span several chunks.
+ */
+static constexpr size_t TEST_BLOCK_SIZE = 64 << 10;
+
+/**
+ * @brief Threads of the parallel compressor and the indexed decoder.
+ */
+static constexpr size_t TEST_THREADS = 4;
+
+/**
+ * @brief One compressor configuration checked by the round trips.
+ */
+struct RoundTripCase {
+    DeflateFormat format;
+    const char* formatName;
+    int level;
+    int huffmanStreams;
+    bool useDictionary;
+};
+
+/**
+ * @brief One named test.
+ */
+struct TestCase {
+    std::string name;
+    std::function<void()> run;
+};
+
+/**
+ * @brief Fails the current test.
+ * @param condition What must hold.
+ * @param what What went wrong if it does not.
+ * @throws std::runtime_error with what if the condition is false.
+ */
+static void expect(bool condition, const std::string& what) {
+    if (!condition) {
+        throw std::runtime_error(what);
+    }
+}
+
+/**
+ * @brief Fails the current test unless work throws; decoders must reject bad data with an exception.
+ * @param work The call that must throw.
+ * @param what What went wrong if it does not.
+ */
+template <typename Work>
+static void expectThrow(Work&& work, const std::string& what) {
+    try {
+        work();
+    }
+    catch (const std::exception&) {
+        return;
+    }
+
+    throw std::runtime_error(what);
+}
+
+/**
+ * @brief Describes a configuration for failure messages.
+ * @param roundTrip The configuration.
+ * @return E.g. "dfdm level=6 streams=4 dictionary".
+ */
+static std::string describe(const RoundTripCase& roundTrip) {
+    return std::string(roundTrip.formatName) + " level=" + std::to_string(roundTrip.level) + " streams=" + std::to_string(roundTrip.huffmanStreams)
+        + (roundTrip.useDictionary ? " dictionary" : "");
+}
+
+/**
+ * @brief Lists every format and level, DFDM with one and four Huffman streams and, if given, the dictionary.
+ * @param withDictionary Whether to add the DFDM configurations with a preset dictionary.
+ * @return The configurations.
+ */
+static std::vector<RoundTripCase> allRoundTripCases(bool withDictionary) {
+    std::vector<RoundTripCase> cases;
+
+    for (int level = Lz77::MIN_LEVEL; level <= Lz77::MAX_LEVEL; ++level) {
+        cases.push_back(RoundTripCase{ DeflateFormat::Dfdm, "dfdm", level, 1, false });
+        cases.push_back(RoundTripCase{ DeflateFormat::Dfdm, "dfdm", level, Huffman::INTERLEAVED_STREAMS, false });
+
+        if (withDictionary) {
+            cases.push_back(RoundTripCase{ DeflateFormat::Dfdm, "dfdm", level, 1, true });
+            cases.push_back(RoundTripCase{ DeflateFormat::Dfdm, "dfdm", level, Huffman::INTERLEAVED_STREAMS, true });
+        }
+
+        cases.push_back(RoundTripCase{ DeflateFormat::Deflate, "deflate", level, 1, false });
+        cases.push_back(RoundTripCase{ DeflateFormat::Zlib, "zlib", level, 1, false });
+        cases.push_back(RoundTripCase{ DeflateFormat::Gzip, "gzip", level, 1, false });
+    }
+
+    return cases;
+}
+
+/**
+ * @brief The generated inputs: the edge cases, text with the '+' bytes the old tree codec mistook
+ * for internal nodes, structured binary data, long runs and incompressible data.
+ * @return The corpus.
+ */
+static std::vector<CorpusEntry> generatedCorpus() {
+    std::vector<CorpusEntry> corpus;
+    corpus.push_back(CorpusEntry{ "empty", "" });
+    corpus.push_back(CorpusEntry{ "one-byte", "+" });
+    corpus.push_back(CorpusEntry{ "small", "a+b+c++d+++a+b+c++d+++" });
+
+    std::string text = generateText(100000, 1);
+    for (size_t i = 0; i < text.size(); i += 97) {
+        text[i] = '+';
+    }
+    corpus.push_back(CorpusEntry{ "text", text });
+
+    corpus.push_back(CorpusEntry{ "binary", generateBinary(80000, 2) });
+    corpus.push_back(CorpusEntry{ "random", generateRandom(40000, 3) });
+
+    std::string runs;
+    std::mt19937 random(4);
+    while (runs.size() < 70000) {
+        runs.append(1 + random() % 3000, static_cast<char>('a' + random() % 3));
+    }
+    corpus.push_back(CorpusEntry{ "runs", runs });
+
+    return corpus;
+}
+
+/**
+ * @brief Trains the dictionary of the round trips on text like the text corpus.
+ * @return The serialized dictionary.
+ */
+static std::vector<uint8_t> trainTestDictionary() {
+    std::vector<std::string> samples;
+
+    for (uint32_t seed = 10; seed < 18; ++seed) {
+        samples.push_back(generateText(4096, seed));
+    }
+
+    return Dictionary::train(samples, 8192).serialize();
+}
+
+/**
+ * @brief A directory of its own under the system's temporary directory (TMPDIR on POSIX), removed
+ * with everything in it when the object goes, also when a test throws. Its name is random and
+ * creating it fails if it exists, so concurrent runs never share files.
+ */
+class TempDirectory {
+private:
+    std::filesystem::path path;
+
+public:
+    /**
+     * @brief Constructor creates the directory.
+     * @throws std::runtime_error if no new directory can be created.
+     */
+    TempDirectory() {
+        std::random_device entropy;
+        std::filesystem::path parent = std::filesystem::temp_directory_path();
+
+        for (int attempt = 0; attempt < 100; ++attempt) {
+            std::filesystem::path candidate = parent / ("deflate_tests_" + std::to_string(entropy()));
+
+            if (std::filesystem::create_directory(candidate)) {
+                path = candidate;
+                return;
+            }
+        }
+
+        throw std::runtime_error("Cannot create a temporary directory in " + parent.string());
+    }
+
+    ~TempDirectory() {
+        std::error_code ignored;
+        std::filesystem::remove_all(path, ignored);
+    }
+
+    TempDirectory(const TempDirectory&) = delete;
+    TempDirectory& operator=(const TempDirectory&) = delete;
+
+    /**
+     * @brief Returns the path of a file in the directory.
+     * @param name The file name.
+     * @return The path.
+     */
+    std::string file(const std::string& name) const {
+        return (path / name).string();
+    }
+};
+
+/**
+ * @brief Reads a whole file into memory.
+ * @param path The path of the file.
+ * @return The contents of the file.
+ */
+static std::string readFileBytes(const std::string& path) {
+    InputFile file(path);
+    std::vector<uint8_t> buffer;
+    size_t size = 0;
+    const uint8_t* data = file.contents(buffer, size);
+
+    return std::string(reinterpret_cast<const char*>(data), size);
+}
+
+/**
+ * @brief Writes a buffer to a file, replacing its contents.
+ * @param path The path of the file.
+ * @param data The bytes to write.
+ * @param size The number of bytes.
+ */
+static void writeFileBytes(const std::string& path, const void* data, size_t size) {
+    std::ofstream file = openOutputFile(path);
+    file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+
+    if (!file) {
+        throw std::runtime_error("Cannot write " + path);
+    }
+}
+
+/**
+ * @brief Runs the deflate executable, with its output going to a log file in the scratch directory.
+ */
+class CommandLine {
+private:
+    std::string executable;
+    std::string logPath;
+
+    /**
+     * @brief Quotes a path or option for the shell.
+     * @param argument The argument.
+     * @return The quoted argument.
+     */
+    static std::string quote(const std::string& argument) {
+        return "\"" + argument + "\"";
+    }
+
+public:
+    /**
+     * @brief Constructor remembers the executable.
+     * @param executable The path of the deflate executable.
+     * @param directory The scratch directory that holds the log.
+     */
+    CommandLine(const std::string& executable, const TempDirectory& directory)
+        : executable(executable), logPath(directory.file("deflate.log")) {}
+
+    /**
+     * @brief Runs one command.
+     * @param arguments The arguments.
+     * @return true if the command succeeded, false if it reported an error and exited with status 1.
+     * @throws std::runtime_error if the command crashed, tripped a sanitizer or exited with another status.
+     */
+    bool run(const std::vector<std::string>& arguments) const {
+        std::string command = quote(executable);
+        std::string shown = "deflate";
+
+        for (const std::string& argument : arguments) {
+            command += " " + quote(argument);
+            shown += " " + argument;
+        }
+        command += " > " + quote(logPath) + " 2>&1";
+
+        int status = std::system(command.c_str());
+#if defined(__unix__) || defined(__APPLE__)
+        status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+        std::string log = readFileBytes(logPath);
+
+        if (status == 0) {
+            return true;
+        }
+
+        if (status != 1 || log.find("Sanitizer") != std::string::npos) {
+            throw std::runtime_error("`" + shown + "` crashed (status " + std::to_string(status) + "): " + log);
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Runs one command that must succeed.
+     * @param arguments The arguments.
+     * @throws std::runtime_error if it does not.
+     */
+    void check(const std::vector<std::string>& arguments) const {
+        if (!run(arguments)) {
+            std::string shown = "deflate";
+            for (const std::string& argument : arguments) {
+                shown += " " + argument;
+            }
+
+            throw std::runtime_error("`" + shown + "` failed: " + readFileBytes(logPath));
+        }
+    }
+};
+
+/**
+ * @brief Compresses an input with one configuration through the library and decodes it back every way the library offers.
+ *
+ * The stream of a DeflateContext reused across all configurations must match the one-shot
+ * DeflateDm::compress byte for byte, and must decode to the input through the context, with and
+ * without checksum verification, and through DeflateDm::decompress.
+ * @param roundTrip The configuration.
+ * @param data The input.
+ * @param dictionaryBytes The serialized dictionary.
+ * @param context The shared context.
+ * @return The compressed stream.
+ * @throws std::runtime_error describing the first check that failed.
+ */
+static std::vector<uint8_t> checkLibraryRoundTrip(const RoundTripCase& roundTrip, const std::string& data, const std::vector<uint8_t>& dictionaryBytes, DeflateContext& context) {
+    DeflateOptions options;
+    options.format = roundTrip.format;
+    options.level = roundTrip.level;
+    options.blockSize = TEST_BLOCK_SIZE;
+    options.huffmanStreams = roundTrip.huffmanStreams;
+
+    if (roundTrip.useDictionary) {
+        options.dictionary = dictionaryBytes.data();
+        options.dictionarySize = dictionaryBytes.size();
+    }
+
+    std::vector<uint8_t> compressed(DeflateDm::compressBound(data.size(), options));
+    compressed.resize(context.compress(data.data(), data.size(), compressed.data(), compressed.size(), options));
+
+    std::vector<uint8_t> oneShot(DeflateDm::compressBound(data.size(), options));
+    oneShot.resize(DeflateDm::compress(data.data(), data.size(), oneShot.data(), oneShot.size(), options));
+    expect(oneShot == compressed, "a reused DeflateContext and DeflateDm::compress wrote different streams");
+
+    std::vector<uint8_t> decoded;
+    context.decompress(compressed.data(), compressed.size(), decoded, roundTrip.format, options.dictionary, options.dictionarySize);
+    expect(std::string(decoded.begin(), decoded.end()) == data, "DeflateContext decoded different data");
+
+    context.setVerifyChecksums(false);
+    context.decompress(compressed.data(), compressed.size(), decoded, roundTrip.format, options.dictionary, options.dictionarySize);
+    context.setVerifyChecksums(true);
+    expect(std::string(decoded.begin(), decoded.end()) == data, "DeflateContext decoded different data without verification");
+
+    decoded.assign(data.size() + 16, 0);
+    decoded.resize(roundTrip.useDictionary
+        ? DeflateDm::decompress(compressed.data(), compressed.size(), decoded.data(), decoded.size(), options.dictionary, options.dictionarySize)
+        : DeflateDm::decompress(compressed.data(), compressed.size(), decoded.data(), decoded.size(), roundTrip.format));
+    expect(std::string(decoded.begin(), decoded.end()) == data, "DeflateDm::decompress decoded different data");
+
+    // Without room past the end, the last matches are copied byte by byte instead.
+    decoded.assign(data.size(), 0);
+    decoded.resize(context.decompress(compressed.data(), compressed.size(), decoded.data(), decoded.size(), roundTrip.format, options.dictionary, options.dictionarySize));
+    expect(std::string(decoded.begin(), decoded.end()) == data, "DeflateContext decoded different data into an exact-size buffer");
+
+    if (roundTrip.format == DeflateFormat::Dfdm) {
+        expect(DeflateDm::decompressedSize(compressed.data(), compressed.size()) == data.size(), "DeflateDm::decompressedSize is wrong");
+    }
+
+    if (roundTrip.format != DeflateFormat::Deflate) {
+        DeflateFormat detected = DeflateFormat::Deflate;
+        expect(DeflateDm::detectFormat(compressed.data(), compressed.size(), detected) && detected == roundTrip.format, "DeflateDm::detectFormat is wrong");
+    }
+
+    return compressed;
+}
+
+/**
+ * @brief Damages a stream by a bit flip or a truncation.
+ * @param compressed The intact stream; not empty.
+ * @param random The source of the damage.
+ * @return The damaged copy.
+ */
+static std::vector<uint8_t> damage(const std::vector<uint8_t>& compressed, std::mt19937& random) {
+    std::vector<uint8_t> damaged = compressed;
+
+    if (random() % 4 == 0) {
+        damaged.resize(random() % damaged.size());
+    }
+    else {
+        damaged[random() % damaged.size()] ^= static_cast<uint8_t>(1u << (random() % 8));
+    }
+
+    return damaged;
+}
+
+/**
+ * @brief Decodes damaged copies of a stream through the library.
+ * Each attempt must fail with an exception or, for formats with a checksum, decode to the input;
+ * memory errors are left for the sanitizer build to catch.
+ * @param roundTrip The configuration the stream was made with.
+ * @param compressed The intact stream.
+ * @param data The input.
+ * @param dictionaryBytes The serialized dictionary.
+ * @param mutations The number of damaged copies.
+ * @param seed The seed of the damage.
+ * @param context The shared context.
+ */
+static void checkDamagedLibraryStreams(const RoundTripCase& roundTrip, const std::vector<uint8_t>& compressed, const std::string& data,
+    const std::vector<uint8_t>& dictionaryBytes, int mutations, uint32_t seed, DeflateContext& context) {
+    const void* dictionary = roundTrip.useDictionary ? dictionaryBytes.data() : nullptr;
+    size_t dictionarySize = roundTrip.useDictionary ? dictionaryBytes.size() : 0;
+    bool checksummed = (roundTrip.format != DeflateFormat::Deflate);
+    std::mt19937 random(seed);
+
+    for (int i = 0; i < mutations && !compressed.empty(); ++i) {
+        std::vector<uint8_t> damaged = damage(compressed, random);
+        std::vector<uint8_t> decoded;
+
+        try {
+            context.decompress(damaged.data(), damaged.size(), decoded, roundTrip.format, dictionary, dictionarySize);
+        }
+        catch (const std::exception&) {
+            continue;
+        }
+
+        expect(!checksummed || std::string(decoded.begin(), decoded.end()) == data, "damaged data decoded without an error (mutation " + std::to_string(i) + ")");
+    }
+}
+
+/**
+ * @brief Checks one configuration on one input against the command-line tool, throwing at the first difference.
+ * The dictionary configurations read it from directory.file("dictionary").
+ *
+ * The input is compressed through the tool, and the library's and the tool's streams are decoded
+ * by each other and by every tool decoder that reads the format: the streaming and indexed
+ * decoders and a random range. For DFDM, the serial file compressor must write the library's
+ * stream byte for byte, and the parallel compressor must write the same stream at 1 and
+ * TEST_THREADS threads. A few damaged copies then go through the tool, which must reject them
+ * with an error or, for formats with a checksum, decode them to the input.
+ * @param roundTrip The configuration.
+ * @param data The input, already written to directory.file("input").
+ * @param compressed The library's stream.
+ * @param tool The command-line tool.
+ * @param directory The scratch directory.
+ * @param mutations The number of damaged copies.
+ * @param seed The seed of the random range and damage.
+ * @param context The shared context.
+ */
+static void checkCommandLineRoundTrip(const RoundTripCase& roundTrip, const std::string& data, const std::vector<uint8_t>& compressed,
+    const CommandLine& tool, const TempDirectory& directory, int mutations, uint32_t seed, DeflateContext& context) {
+    const std::string inputPath = directory.file("input");
+    const std::string libraryPath = directory.file("library");
+    const std::string toolPath = directory.file("tool");
+    const std::string parallelPath = directory.file("parallel");
+    const std::string outputPath = directory.file("output");
+    writeFileBytes(libraryPath, compressed.data(), compressed.size());
+
+    std::vector<std::string> options = {
+        "--level=" + std::to_string(roundTrip.level),
+        "--block-size=" + std::to_string(TEST_BLOCK_SIZE),
+        "--format=" + std::string(roundTrip.formatName)
+    };
+
+    if (roundTrip.format == DeflateFormat::Dfdm) {
+        options.push_back("--huffman-streams=" + std::to_string(roundTrip.huffmanStreams));
+    }
+    if (roundTrip.useDictionary) {
+        options.push_back("--dictionary=" + directory.file("dictionary"));
+    }
+
+    auto withOptions = [&](std::vector<std::string> arguments, std::vector<std::string> extra = {}) {
+        arguments.insert(arguments.end(), options.begin(), options.end());
+        arguments.insert(arguments.end(), extra.begin(), extra.end());
+        return arguments;
+    };
+
+    tool.check(withOptions({ "compress", inputPath, toolPath }));
+
+    if (roundTrip.format == DeflateFormat::Dfdm) {
+        std::string toolStream = readFileBytes(toolPath);
+        expect(toolStream == std::string(compressed.begin(), compressed.end()), "the file compressor and the library wrote different streams");
+    }
+    else {
+        std::string toolStream = readFileBytes(toolPath);
+        std::vector<uint8_t> decoded;
+        context.decompress(toolStream.data(), toolStream.size(), decoded, roundTrip.format);
+        expect(std::string(decoded.begin(), decoded.end()) == data, "the library decoded the file compressor's stream to different data");
+    }
+
+    tool.check(withOptions({ "decompress", inputPath, libraryPath, outputPath }));
+    expect(readFileBytes(outputPath) == data, "the file decompressor decoded different data");
+
+    std::mt19937 random(seed);
+
+    if (roundTrip.format == DeflateFormat::Dfdm) {
+        tool.check(withOptions({ "decompress", inputPath, libraryPath, outputPath }, { "--threads=" + std::to_string(TEST_THREADS) }));
+        expect(readFileBytes(outputPath) == data, "the indexed decompressor decoded different data");
+
+        tool.check(withOptions({ "compress", inputPath, parallelPath }, { "--threads=1" }));
+        std::string serial = readFileBytes(parallelPath);
+        tool.check(withOptions({ "compress", inputPath, parallelPath }, { "--threads=" + std::to_string(TEST_THREADS) }));
+        expect(readFileBytes(parallelPath) == serial, "the parallel compressor's output depends on the thread count");
+
+        tool.check(withOptions({ "decompress", inputPath, parallelPath, outputPath }, { "--threads=" + std::to_string(TEST_THREADS) }));
+        expect(readFileBytes(outputPath) == data, "the indexed decompressor decoded independent blocks to different data");
+
+        if (!data.empty()) {
+            uint64_t rangeOffset = random() % data.size();
+            uint64_t rangeLength = 1 + random() % (data.size() - rangeOffset);
+            tool.check(withOptions({ "decompress", inputPath, parallelPath, outputPath },
+                { "--threads=" + std::to_string(TEST_THREADS), "--range=" + std::to_string(rangeOffset) + ":" + std::to_string(rangeLength) }));
+
+            expect(readFileBytes(outputPath) == data.substr(rangeOffset, rangeLength),
+                "the range " + std::to_string(rangeOffset) + ":" + std::to_string(rangeLength) + " decoded to different data");
+        }
+    }
+
+    bool checksummed = (roundTrip.format != DeflateFormat::Deflate);
+
+    for (int i = 0; i < mutations && !compressed.empty(); ++i) {
+        std::vector<uint8_t> damaged = damage(compressed, random);
+        writeFileBytes(toolPath, damaged.data(), damaged.size());
+
+        std::vector<std::string> extra;
+        if (i % 2 == 1) {
+            extra.push_back("--threads=" + std::to_string(TEST_THREADS));
+        }
+
+        if (tool.run(withOptions({ "decompress", inputPath, toolPath, outputPath }, extra))) {
+            expect(!checksummed || readFileBytes(outputPath) == data, "damaged data decoded without an error (mutation " + std::to_string(i) + ")");
+        }
+    }
+}
+
+/**
+ * @brief Checks the CRC-32, CRC-32C and Adler-32 check values and CRC combination.
+ */
+static void testChecksums() {
+    const std::string check = "123456789";
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(check.data());
+
+    expect(Checksum::crc32(Checksum::CRC32_INIT, bytes, check.size()) == 0xCBF43926u, "CRC-32 check value");
+    expect(Checksum::crc32c(Checksum::CRC32C_INIT, bytes, check.size()) == 0xE3069283u, "CRC-32C check value");
+    expect(Checksum::adler32(Checksum::ADLER32_INIT, bytes, check.size()) == 0x091E01DEu, "Adler-32 check value");
+
+    std::string data = generateBinary(100000, 5);
+    const uint8_t* dataBytes = reinterpret_cast<const uint8_t*>(data.data());
+    uint32_t whole = Checksum::crc32c(Checksum::CRC32C_INIT, dataBytes, data.size());
+
+    for (size_t split : { size_t(0), size_t(1), size_t(4095), size_t(65536), data.size() }) {
+        uint32_t first = Checksum::crc32c(Checksum::CRC32C_INIT, dataBytes, split);
+        uint32_t second = Checksum::crc32c(Checksum::CRC32C_INIT, dataBytes + split, data.size() - split);
+        expect(Checksum::crcCombine(Checksum::CRC32C_POLYNOMIAL, first, second, data.size() - split) == whole, "CRC-32C combination at " + std::to_string(split));
+    }
+}
+
+/**
+ * @brief Round-trips each input through the byte-oriented Huffman coder at every code length limit,
+ * in one stream and in interleaved streams, and checks that over-subscribed lengths are rejected.
+ * @param corpus The inputs.
+ */
+static void testHuffman(const std::vector<CorpusEntry>& corpus) {
+    for (int maxCodeLength = 9; maxCodeLength <= Huffman::MAX_CODE_LENGTH; ++maxCodeLength) {
+        for (const CorpusEntry& entry : corpus) {
+            const std::string where = entry.name + " max-code-length=" + std::to_string(maxCodeLength) + ": ";
+            Huffman encoder;
+            encoder.build(entry.data, maxCodeLength);
+
+            const std::vector<int>& lengths = encoder.getCodeLengths();
+            expect(*std::max_element(lengths.begin(), lengths.end()) <= maxCodeLength, where + "a code is longer than the limit");
+
+            BitWriter writer;
+            encoder.writeCodeLengths(writer);
+            uint64_t headerBits = writer.bitsWritten();
+            encoder.encode(entry.data, writer);
+            uint64_t bodyBits = writer.bitsWritten() - headerBits;
+            std::vector<uint8_t> bytes = writer.take();
+
+            BitReader reader(bytes.data(), bytes.size());
+            Huffman decoder;
+            decoder.readCodeLengths(reader);
+            expect(reader.bitsConsumed() == headerBits, where + "readCodeLengths read a different header size");
+            expect(decoder.decode(reader, bodyBits) == entry.data, where + "decode returned different data");
+
+            BitWriter writers[Huffman::INTERLEAVED_STREAMS];
+            encoder.encodeInterleaved(entry.data, writers);
+
+            std::vector<uint8_t> streams[Huffman::INTERLEAVED_STREAMS];
+            for (int stream = 0; stream < Huffman::INTERLEAVED_STREAMS; ++stream) {
+                streams[stream] = writers[stream].take();
+            }
+
+            BitReader readers[Huffman::INTERLEAVED_STREAMS] = {
+                BitReader(streams[0].data(), streams[0].size()),
+                BitReader(streams[1].data(), streams[1].size()),
+                BitReader(streams[2].data(), streams[2].size()),
+                BitReader(streams[3].data(), streams[3].size())
+            };
+
+            std::string decoded(entry.data.size(), '\0');
+            decoder.decodeInterleaved(readers, &decoded[0], decoded.size());
+            expect(decoded == entry.data, where + "decodeInterleaved returned different data");
+        }
+    }
+
+    std::vector<int> oversubscribed(256, 0);
+    oversubscribed['a'] = 1;
+    oversubscribed['b'] = 1;
+    oversubscribed['c'] = 1;
+    expectThrow([&]() { Huffman().buildFromLengths(oversubscribed); }, "over-subscribed code lengths were accepted");
+}
+
+/**
+ * @brief Round-trips each input through the LZ77 tokenizer and its byte serialization at every
+ * level, and checks that malformed token streams are rejected.
+ * @param corpus The inputs.
+ */
+static void testLz77(const std::vector<CorpusEntry>& corpus) {
+    for (int level = Lz77::MIN_LEVEL; level <= Lz77::MAX_LEVEL; ++level) {
+        Lz77 lz77(level);
+
+        for (const CorpusEntry& entry : corpus) {
+            const std::string where = entry.name + " level=" + std::to_string(level) + ": ";
+            std::vector<Lz77::Lz77Code> tokens = lz77.lz77Compress(entry.data);
+
+            expect(Lz77::lz77Decompress(tokens) == entry.data, where + "tokens decoded to different data");
+            expect(Lz77::lz77DecompressFromBytes(Lz77::compressedToBytes(tokens)) == entry.data, where + "token bytes decoded to different data");
+        }
+    }
+
+    // A match of length 3 at offset 6 with nothing before it, and a length varint that never ends.
+    const std::string outOfRange("\x03\x05\x00x", 4);
+    const std::string unterminated("\x80", 1);
+    expectThrow([&]() { Lz77::lz77DecompressFromBytes(outOfRange); }, "a match before the start of the data was accepted");
+    expectThrow([&]() { Lz77::lz77DecompressFromBytes(unterminated); }, "an unterminated length was accepted");
+}
+
+/**
+ * @brief Checks that a serialized dictionary parses back to itself and that damaged ones are rejected.
+ * @param dictionaryBytes The serialized dictionary.
+ */
+static void testDictionary(const std::vector<uint8_t>& dictionaryBytes) {
+    Dictionary dictionary = Dictionary::parse(dictionaryBytes.data(), dictionaryBytes.size());
+    expect(dictionary.serialize() == dictionaryBytes, "a parsed dictionary serializes differently");
+    expect(!dictionary.getContent().empty(), "the trained dictionary has no content");
+
+    std::vector<uint8_t> damaged = dictionaryBytes;
+    damaged[damaged.size() / 2] ^= 1;
+    expectThrow([&]() { Dictionary::parse(damaged.data(), damaged.size()); }, "a damaged dictionary was accepted");
+    expectThrow([&]() { Dictionary::parse(dictionaryBytes.data(), dictionaryBytes.size() - 1); }, "a truncated dictionary was accepted");
+}
+
+/**
+ * @brief Round-trips every input through every configuration of the library and decodes damaged copies.
+ * @param corpus The inputs.
+ * @param dictionaryBytes The serialized dictionary.
+ * @param mutations The number of damaged copies per configuration and input.
+ */
+static void testLibraryRoundTrips(const std::vector<CorpusEntry>& corpus, const std::vector<uint8_t>& dictionaryBytes, int mutations) {
+    std::vector<RoundTripCase> cases = allRoundTripCases(true);
+    DeflateContext context;
+
+    for (const CorpusEntry& entry : corpus) {
+        for (size_t i = 0; i < cases.size(); ++i) {
+            try {
+                std::vector<uint8_t> compressed = checkLibraryRoundTrip(cases[i], entry.data, dictionaryBytes, context);
+                checkDamagedLibraryStreams(cases[i], compressed, entry.data, dictionaryBytes, mutations, static_cast<uint32_t>(i + 1), context);
+            }
+            catch (const std::exception& error) {
+                throw std::runtime_error(entry.name + " " + describe(cases[i]) + ": " + error.what());
+            }
+        }
+    }
+}
+
+/**
+ * @brief Round-trips the text through DFDM and DEFLATE at every code length limit.
+ * @param corpus The inputs.
+ */
+static void testCodeLengthLimits(const std::vector<CorpusEntry>& corpus) {
+    for (const CorpusEntry& entry : corpus) {
+        for (int maxCodeLength = 9; maxCodeLength <= Huffman::MAX_CODE_LENGTH; ++maxCodeLength) {
+            for (DeflateFormat format : { DeflateFormat::Dfdm, DeflateFormat::Deflate }) {
+                DeflateOptions options;
+                options.format = format;
+                options.blockSize = TEST_BLOCK_SIZE;
+                options.maxCodeLength = maxCodeLength;
+
+                std::vector<uint8_t> compressed(DeflateDm::compressBound(entry.data.size(), options));
+                compressed.resize(DeflateDm::compress(entry.data.data(), entry.data.size(), compressed.data(), compressed.size(), options));
+
+                std::string decoded(entry.data.size() + 16, '\0');
+                decoded.resize(DeflateDm::decompress(compressed.data(), compressed.size(), &decoded[0], decoded.size(), format));
+                expect(decoded == entry.data, entry.name + " max-code-length=" + std::to_string(maxCodeLength) + ": decoded different data");
+            }
+        }
+    }
+}
+
+/**
+ * @brief Decodes the text under an output limit one byte short of it and exactly at it, in every format.
+ * @param corpus The inputs.
+ */
+static void testOutputLimit(const std::vector<CorpusEntry>& corpus) {
+    for (const CorpusEntry& entry : corpus) {
+        if (entry.data.empty()) {
+            continue;
+        }
+
+        for (const RoundTripCase& roundTrip : allRoundTripCases(false)) {
+            if (roundTrip.level != 6) {
+                continue;
+            }
+
+            DeflateOptions options;
+            options.format = roundTrip.format;
+            options.blockSize = TEST_BLOCK_SIZE;
+
+            std::vector<uint8_t> compressed(DeflateDm::compressBound(entry.data.size(), options));
+            compressed.resize(DeflateDm::compress(entry.data.data(), entry.data.size(), compressed.data(), compressed.size(), options));
+
+            DeflateContext context;
+            std::vector<uint8_t> decoded;
+            context.setMaxOutputSize(entry.data.size() - 1);
+            expectThrow([&]() { context.decompress(compressed.data(), compressed.size(), decoded, roundTrip.format); },
+                entry.name + " " + describe(roundTrip) + ": data past the output limit was accepted");
+
+            context.setMaxOutputSize(entry.data.size());
+            context.decompress(compressed.data(), compressed.size(), decoded, roundTrip.format);
+            expect(std::string(decoded.begin(), decoded.end()) == entry.data, entry.name + " " + describe(roundTrip) + ": decoded different data at the output limit");
+        }
+    }
+}
+
+/**
+ * @brief Reads random ranges of a library stream through ArchiveReader.
+ * @param corpus The inputs.
+ * @param directory The scratch directory.
+ */
+static void testArchiveReader(const std::vector<CorpusEntry>& corpus, const TempDirectory& directory) {
+    const std::string path = directory.file("archive");
+    std::mt19937 random(7);
+
+    for (const CorpusEntry& entry : corpus) {
+        DeflateOptions options;
+        options.blockSize = TEST_BLOCK_SIZE;
+
+        std::vector<uint8_t> compressed(DeflateDm::compressBound(entry.data.size(), options));
+        compressed.resize(DeflateDm::compress(entry.data.data(), entry.data.size(), compressed.data(), compressed.size(), options));
+        writeFileBytes(path, compressed.data(), compressed.size());
+
+        ArchiveReader reader(path);
+        expect(reader.size() == entry.data.size(), entry.name + ": the index has the wrong size");
+        expect(reader.readRange(0, entry.data.size(), TEST_THREADS) == entry.data, entry.name + ": the whole range decoded to different data");
+
+        for (int i = 0; i < 8 && !entry.data.empty(); ++i) {
+            uint64_t offset = random() % entry.data.size();
+            uint64_t length = 1 + random() % (entry.data.size() - offset);
+            expect(reader.readRange(offset, length) == entry.data.substr(offset, length),
+                entry.name + ": the range " + std::to_string(offset) + ":" + std::to_string(length) + " decoded to different data");
+        }
+
+        if (entry.data.empty()) {
+            continue;
+        }
+
+        // Flips a bit of the last index entry's compressed size.
+        std::vector<uint8_t> damaged = compressed;
+        damaged[damaged.size() - BlockCodec::TRAILER_SIZE - 1] ^= 0x40;
+        writeFileBytes(path, damaged.data(), damaged.size());
+        expectThrow([&]() { ArchiveReader(path).readRange(0, entry.data.size()); }, entry.name + ": a damaged index was accepted");
+    }
+}
+
+/**
+ * @brief Runs every configuration on every input through the command-line tool.
+ * @param corpus The inputs.
+ * @param dictionaryBytes The serialized dictionary.
+ * @param tool The command-line tool.
+ * @param directory The scratch directory.
+ * @param mutations The number of damaged copies per configuration and input.
+ */
+static void testCommandLine(const std::vector<CorpusEntry>& corpus, const std::vector<uint8_t>& dictionaryBytes, const CommandLine& tool,
+    const TempDirectory& directory, int mutations) {
+    std::vector<RoundTripCase> cases = allRoundTripCases(true);
+    DeflateContext context;
+    writeFileBytes(directory.file("dictionary"), dictionaryBytes.data(), dictionaryBytes.size());
+
+    for (const CorpusEntry& entry : corpus) {
+        writeFileBytes(directory.file("input"), entry.data.data(), entry.data.size());
+
+        for (size_t i = 0; i < cases.size(); ++i) {
+            try {
+                std::vector<uint8_t> compressed = checkLibraryRoundTrip(cases[i], entry.data, dictionaryBytes, context);
+                checkCommandLineRoundTrip(cases[i], entry.data, compressed, tool, directory, mutations, static_cast<uint32_t>(i + 1), context);
+            }
+            catch (const std::exception& error) {
+                throw std::runtime_error(entry.name + " " + describe(cases[i]) + ": " + error.what());
+            }
+        }
+    }
+}
+
+/**
+ * @brief Entry point of the test suite.
+ *
+ * Usage: deflate_tests [--tool=<deflate executable>] [--mutations=<n>] [inputFilePath...]
+ * Without --tool the command-line round trips are skipped. Input files are checked in addition to
+ * the generated corpus.
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line argument strings.
+ * @return 0 if every test passed, 1 otherwise.
+ */
+int main(int argc, char* argv[]) {
+    std::string toolPath;
+    int mutations = 16;
+    std::vector<CorpusEntry> files;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string argument = argv[i];
+
+            if (argument.rfind("--tool=", 0) == 0) {
+                toolPath = argument.substr(7);
+            }
+            else if (argument.rfind("--mutations=", 0) == 0) {
+                mutations = std::max(0, std::atoi(argument.c_str() + 12));
+            }
+            else if (argument.rfind("--", 0) == 0) {
+                std::cerr << "Usage: " << argv[0] << " [--tool=<deflate executable>] [--mutations=<n>] [inputFilePath...]\n";
+                return 1;
+            }
+            else {
+                files.push_back(CorpusEntry{ argument, readFileBytes(argument) });
+            }
+        }
+    }
+    catch (const std::exception& error) {
+        std::cerr << error.what() << "\n";
+        return 1;
+    }
+
+    std::vector<CorpusEntry> corpus = generatedCorpus();
+    corpus.insert(corpus.end(), files.begin(), files.end());
+
+    // The command-line round trips take a process per call, so they run on the text and the given files only.
+    std::vector<CorpusEntry> toolCorpus;
+    std::copy_if(corpus.begin(), corpus.end(), std::back_inserter(toolCorpus), [&](const CorpusEntry& entry) {
+        return entry.name == "text" || entry.name == "empty" || std::any_of(files.begin(), files.end(), [&](const CorpusEntry& file) { return file.name == entry.name; });
+    });
+
+    std::vector<uint8_t> dictionaryBytes = trainTestDictionary();
+    TempDirectory directory;
+
+    std::vector<TestCase> tests = {
+        { "checksums", [&]() { testChecksums(); } },
+        { "huffman", [&]() { testHuffman(corpus); } },
+        { "lz77", [&]() { testLz77(corpus); } },
+        { "dictionary", [&]() { testDictionary(dictionaryBytes); } },
+        { "library round trips", [&]() { testLibraryRoundTrips(corpus, dictionaryBytes, mutations); } },
+        { "code length limits", [&]() { testCodeLengthLimits(corpus); } },
+        { "output limit", [&]() { testOutputLimit(corpus); } },
+        { "archive reader", [&]() { testArchiveReader(corpus, directory); } }
+    };
+
+    if (!toolPath.empty()) {
+        tests.push_back({ "command line", [&]() { testCommandLine(toolCorpus, dictionaryBytes, CommandLine(toolPath, directory), directory, mutations / 4); } });
+    }
+
+    size_t failures = 0;
+
+    for (const TestCase& test : tests) {
+        auto start = std::chrono::steady_clock::now();
+        std::cout << test.name << ": " << std::flush;
+
+        try {
+            test.run();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "ok (" << elapsed.count() << " s)\n";
+        }
+        catch (const std::exception& error) {
+            std::cout << "FAILED: " << error.what() << "\n";
+            ++failures;
+        }
+    }
+
+    std::cout << (failures == 0 ? "All tests passed.\n" : std::to_string(failures) + " tests failed.\n");
+    return (failures == 0) ? 0 : 1;
+}